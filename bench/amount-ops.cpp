@@ -0,0 +1,120 @@
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "libcma/types.h"
+}
+
+#include "utils.h"
+
+#define N_AMOUNTS (1UL << 12) //< Distinct operand pairs
+#define N_ROUNDS 256UL        //< Passes over the operands per measurement
+
+// Compares the limb based amount kernel against the byte at a time loops it replaced, after checking both agree on
+// every operand pair, including carries and borrows across the limb boundaries.
+
+namespace {
+
+auto now_ns() -> uint64_t {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+auto bytewise_checked_add(cma_amount_t &res, const cma_amount_t &amount_a, const cma_amount_t &amount_b) -> bool {
+    uint16_t carry = 0;
+    for (size_t i = sizeof(res.data); i-- > 0;) {
+        const uint16_t tmp = carry + amount_a.data[i] + amount_b.data[i];
+        res.data[i] = static_cast<uint8_t>(tmp);
+        carry = tmp >> 8U;
+    }
+    return carry == 0;
+}
+
+auto bytewise_checked_sub(cma_amount_t &res, const cma_amount_t &amount_a, const cma_amount_t &amount_b) -> bool {
+    uint16_t borrow = 0;
+    for (size_t i = sizeof(res.data); i-- > 0;) {
+        const uint16_t subtrahend = borrow + amount_b.data[i];
+        borrow = subtrahend > amount_a.data[i] ? 1 : 0;
+        res.data[i] = static_cast<uint8_t>(amount_a.data[i] + (borrow << 8U) - subtrahend);
+    }
+    return borrow == 0;
+}
+
+auto bytewise_is_zero(const cma_amount_t &amount) -> bool {
+    static const cma_amount_t zero = {};
+    return std::memcmp(amount.data, zero.data, sizeof(amount.data)) == 0;
+}
+
+// Mixes full width values with ones that only fill some limbs, so both short and long carry chains show up
+auto make_amounts() -> std::vector<cma_amount_t> {
+    std::vector<cma_amount_t> amounts(N_AMOUNTS);
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < amounts.size(); ++i) {
+        const size_t skip = (i % 5) * 8;
+        for (size_t j = 0; j < sizeof(amounts[i].data); ++j) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            const auto byte = static_cast<uint8_t>(state >> 56);
+            amounts[i].data[j] = j < skip ? 0 : (i % 3 == 0 ? 0xff : byte);
+        }
+    }
+    return amounts;
+}
+
+void check_equivalence(const std::vector<cma_amount_t> &amounts) {
+    for (size_t i = 0; i < amounts.size(); ++i) {
+        for (size_t k = 0; k < 64; ++k) {
+            const cma_amount_t &a = amounts[i];
+            const cma_amount_t &b = amounts[(i * 31 + k) % amounts.size()];
+            cma_amount_t expected = {};
+            cma_amount_t got = {};
+            assert(bytewise_checked_add(expected, a, b) == amount_checked_add(got, a, b));
+            assert(std::memcmp(expected.data, got.data, sizeof(got.data)) == 0);
+            assert(bytewise_checked_sub(expected, a, b) == amount_checked_sub(got, a, b));
+            assert(std::memcmp(expected.data, got.data, sizeof(got.data)) == 0);
+            assert((std::memcmp(a.data, b.data, sizeof(a.data)) < 0) == (amount_compare(a, b) < 0));
+            assert(bytewise_is_zero(expected) == is_zero(got));
+        }
+    }
+}
+
+template <typename Op>
+void bench_op(const char *name, const std::vector<cma_amount_t> &amounts, Op op) {
+    cma_amount_t acc = {};
+    size_t sink = 0;
+    const uint64_t start = now_ns();
+    for (size_t round = 0; round < N_ROUNDS; ++round) {
+        for (const auto &amount : amounts) {
+            sink += op(acc, amount) ? 1 : 0;
+        }
+    }
+    const uint64_t elapsed = now_ns() - start;
+    const size_t n_ops = N_ROUNDS * amounts.size();
+    std::printf("%-24s %10zu ops %10.1f ns/op (%zx %02x)\n", name, n_ops, static_cast<double>(elapsed) / n_ops, sink,
+        acc.data[sizeof(acc.data) - 1]);
+}
+
+} // namespace
+
+auto main() -> int {
+    const auto amounts = make_amounts();
+    check_equivalence(amounts);
+
+    bench_op("add bytewise", amounts,
+        [](cma_amount_t &acc, const cma_amount_t &amount) { return bytewise_checked_add(acc, acc, amount); });
+    bench_op("add limbs", amounts,
+        [](cma_amount_t &acc, const cma_amount_t &amount) { return amount_checked_add(acc, acc, amount); });
+    bench_op("sub bytewise", amounts,
+        [](cma_amount_t &acc, const cma_amount_t &amount) { return bytewise_checked_sub(acc, acc, amount); });
+    bench_op("sub limbs", amounts,
+        [](cma_amount_t &acc, const cma_amount_t &amount) { return amount_checked_sub(acc, acc, amount); });
+    bench_op("is_zero memcmp", amounts,
+        [](cma_amount_t &acc, const cma_amount_t &amount) { return bytewise_is_zero(amount) || acc.data[0] != 0; });
+    bench_op("is_zero limbs", amounts,
+        [](cma_amount_t &acc, const cma_amount_t &amount) { return is_zero(amount) || acc.data[0] != 0; });
+    return 0;
+}
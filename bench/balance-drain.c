@@ -0,0 +1,68 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libcma/ledger.h"
+
+#define N_ACCOUNTS 100000UL            //< Accounts (one balance each)
+#define MAX_ACCOUNTS N_ACCOUNTS        //< Maximum number of accounts.
+#define MAX_BALANCES N_ACCOUNTS        //< Max balances
+#define MAX_ASSETS 1UL                 //< Maximum number of assets.
+#define MEM_LENGTH 128UL * 1024 * 1024 //< State length
+#define N_CHUNKS 10UL                  //< Latency is reported per chunk of removals
+#define DRAIN_STRIDE 7919UL            //< Coprime with N_ACCOUNTS, spreads removals across the balance list
+
+// Drains every balance to zero and reports the removal latency per chunk: with an O(1) removal the figures
+// stay flat as the balance list shrinks instead of tracking its length.
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    assert(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+    return (uint64_t) ts.tv_sec * 1000000000UL + (uint64_t) ts.tv_nsec;
+}
+
+int main(void) {
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_token_address_t token_address = {.data = {0x01}};
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address, NULL, NULL, &asset_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_account_id_t *account_ids = malloc(N_ACCOUNTS * sizeof(cma_ledger_account_id_t));
+    assert(account_ids != NULL);
+    cma_amount_t amount = {};
+    amount.data[sizeof(amount.data) - 1] = 1;
+    for (size_t i = 0; i < N_ACCOUNTS; ++i) {
+        cma_ledger_account_t account = {};
+        memcpy(account.address.data, &i, sizeof(i));
+        cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+        assert(cma_ledger_retrieve_account(&ledger, &account_ids[i], &account, NULL, NULL, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+        assert(cma_ledger_deposit(&ledger, asset_id, account_ids[i], &amount) == CMA_LEDGER_SUCCESS);
+    }
+
+    const size_t chunk = N_ACCOUNTS / N_CHUNKS;
+    for (size_t c = 0; c < N_CHUNKS; ++c) {
+        const uint64_t start = now_ns();
+        for (size_t i = c * chunk; i < (c + 1) * chunk; ++i) {
+            const size_t idx = (i * DRAIN_STRIDE) % N_ACCOUNTS;
+            assert(cma_ledger_withdraw(&ledger, asset_id, account_ids[idx], &amount) == CMA_LEDGER_SUCCESS);
+        }
+        const uint64_t elapsed = now_ns() - start;
+        printf("drain %6zu..%6zu balances left %10.1f ns/op\n", N_ACCOUNTS - (c * chunk),
+            N_ACCOUNTS - ((c + 1) * chunk), (double) elapsed / (double) chunk);
+    }
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(account_ids);
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libcma/ledger.h"
+
+#define ASSETS_PER_ACCOUNT 8UL //< Balances per account, the wallet app limits
+#define MAX_MEM_LENGTH 256UL * 1024 * 1024
+
+// Reports the smallest memory accepted for a number of balances (what the drive has to hold) in bytes per balance,
+// then fills a ledger of that size to all its maximums to check the figure holds.
+
+static size_t min_mem_length(uint8_t *buffer, size_t n_accounts, size_t n_assets, size_t n_balances) {
+    size_t low = CMA_LEDGER_MIN_MEM_LENGTH;
+    size_t high = MAX_MEM_LENGTH;
+    while (low < high) {
+        size_t mid = low + ((high - low) / 2);
+        cma_ledger_t ledger;
+        if (cma_ledger_init_buffer(&ledger, buffer, mid, n_accounts, n_assets, n_balances) == CMA_LEDGER_SUCCESS) {
+            assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+static void fill(uint8_t *buffer, size_t mem_length, size_t n_accounts, size_t n_assets, size_t n_balances) {
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, mem_length, n_accounts, n_assets, n_balances) ==
+        CMA_LEDGER_SUCCESS);
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+    for (size_t i = 0; i < n_assets; i++) {
+        cma_token_address_t token_address = {.data = {(uint8_t) (i + 1)}};
+        cma_ledger_asset_id_t asset_id;
+        assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address, NULL, NULL, &asset_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    }
+    cma_amount_t amount = {.data = {[sizeof(amount.data) - 1] = 1}};
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+    for (size_t i = 0; i < n_accounts; i++) {
+        cma_ledger_account_t account = {.address = {.data = {(uint8_t) i, (uint8_t) (i >> 8), (uint8_t) (i >> 16)}}};
+        cma_ledger_account_id_t account_id;
+        assert(cma_ledger_retrieve_account(&ledger, &account_id, &account, NULL, NULL, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+        for (size_t j = 0; j < n_assets; j++) {
+            assert(cma_ledger_deposit(&ledger, j, account_id, &amount) == CMA_LEDGER_SUCCESS);
+        }
+    }
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+}
+
+int main(void) {
+    uint8_t *buffer = malloc(MAX_MEM_LENGTH);
+    assert(buffer != NULL);
+    static const size_t n_balances_list[] = {16UL * 1024, 128UL * 1024, 512UL * 1024};
+    for (size_t i = 0; i < sizeof(n_balances_list) / sizeof(n_balances_list[0]); i++) {
+        const size_t n_balances = n_balances_list[i];
+        const size_t n_accounts = n_balances / ASSETS_PER_ACCOUNT;
+        const size_t mem_length = min_mem_length(buffer, n_accounts, ASSETS_PER_ACCOUNT, n_balances);
+        fill(buffer, mem_length, n_accounts, ASSETS_PER_ACCOUNT, n_balances);
+        printf("%8zu balances %12zu bytes %8.1f bytes/balance\n", n_balances, mem_length,
+            (double) mem_length / (double) n_balances);
+    }
+    free(buffer);
+    return 0;
+}
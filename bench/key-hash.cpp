@@ -0,0 +1,100 @@
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "ledger_impl.h"
+
+#define N_KEYS (1UL << 17) //< Distinct keys hashed and looked up
+#define N_ROUNDS 16UL      //< Passes over the key set per measurement
+
+// Compares the keyed SipHash-1-3 hashers of the memory ledger against boost::hash, both as raw hashing throughput
+// and as find latency in the table that stores the account and asset keys.
+
+namespace {
+
+constexpr cma_hash_seed_t BENCH_SEED = {.k0 = 0x0123456789abcdefULL, .k1 = 0xfedcba9876543210ULL};
+
+using account_key_t = std::array<uint8_t, CMA_ABI_ID_LENGTH>;
+using asset_key_t = std::array<uint8_t, CMA_LEDGER_ASSET_MAP_KEY_SIZE>;
+
+auto now_ns() -> uint64_t {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+template <typename Key>
+auto make_keys() -> std::vector<Key> {
+    std::vector<Key> keys(N_KEYS);
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (auto &key : keys) {
+        for (auto &byte : key) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            byte = static_cast<uint8_t>(state >> 56);
+        }
+    }
+    return keys;
+}
+
+template <typename Key, typename Hash>
+void bench_hash(const char *name, const std::vector<Key> &keys, const Hash &hasher = Hash{}) {
+    size_t sink = 0;
+    const uint64_t start = now_ns();
+    for (size_t round = 0; round < N_ROUNDS; ++round) {
+        for (const auto &key : keys) {
+            sink += hasher(key);
+        }
+    }
+    const uint64_t elapsed = now_ns() - start;
+    const size_t n_ops = N_ROUNDS * keys.size();
+    std::printf("%-24s %10zu ops %10.1f ns/op (%zx)\n", name, n_ops, static_cast<double>(elapsed) / n_ops, sink);
+}
+
+template <typename Key, typename Hash>
+void bench_find(const char *name, const std::vector<Key> &keys, const Hash &hasher = Hash{}) {
+    using map_t = libcma::swar_flat_map<Key, uint64_t, Hash, std::equal_to<>,
+        std::allocator<libcma::swar_flat_map_entry<Key, uint64_t>>>;
+    map_t map(keys.size(), hasher, typename map_t::allocator_type{});
+    for (size_t i = 0; i < keys.size(); ++i) {
+        map.try_emplace(keys[i], i);
+    }
+    uint64_t sink = 0;
+    const uint64_t start = now_ns();
+    for (size_t round = 0; round < N_ROUNDS; ++round) {
+        for (const auto &key : keys) {
+            auto it = map.find(key);
+            assert(it != map.end());
+            sink += it->second;
+        }
+    }
+    const uint64_t elapsed = now_ns() - start;
+    const size_t n_ops = N_ROUNDS * keys.size();
+    std::printf("%-24s %10zu ops %10.1f ns/op (%llx)\n", name, n_ops, static_cast<double>(elapsed) / n_ops,
+        static_cast<unsigned long long>(sink));
+}
+
+} // namespace
+
+auto main() -> int {
+    const auto account_keys = make_keys<account_key_t>();
+    const auto asset_keys = make_keys<asset_key_t>();
+
+    const hash_key_bytes<CMA_ABI_ID_LENGTH> account_hash{BENCH_SEED};
+    const hash_key_bytes<CMA_LEDGER_ASSET_MAP_KEY_SIZE> asset_hash{BENCH_SEED};
+
+    bench_hash<account_key_t, boost::hash<account_key_t>>("hash account boost", account_keys);
+    bench_hash("hash account siphash13", account_keys, account_hash);
+    bench_hash<asset_key_t, boost::hash<asset_key_t>>("hash asset boost", asset_keys);
+    bench_hash("hash asset siphash13", asset_keys, asset_hash);
+
+    bench_find<account_key_t, boost::hash<account_key_t>>("find account boost", account_keys);
+    bench_find("find account siphash13", account_keys, account_hash);
+    bench_find<asset_key_t, boost::hash<asset_key_t>>("find asset boost", asset_keys);
+    bench_find("find asset siphash13", asset_keys, asset_hash);
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libcma/ledger.h"
+
+#define N_ACCOUNTS (16UL * 1024)      //< Accounts (one balance each)
+#define MAX_ACCOUNTS N_ACCOUNTS       //< Maximum number of accounts.
+#define MAX_BALANCES 8 * MAX_ACCOUNTS //< Max balances
+#define MAX_ASSETS 8UL                //< Maximum number of assets.
+#define MEM_LENGTH 64UL * 1024 * 1024 //< State length
+
+// Lookups per operation on the memory ledger (asset, account and balance probes):
+//   deposit 3, withdraw 3, transfer 5, whether balances are created or removed: a new balance takes the slot its
+//   lookup reserved and a removed one is erased where it was found (the account and holder links of either still
+//   look up their neighbours, as moving the last withdrawable balance into a removed one's place does)
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    assert(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+    return (uint64_t) ts.tv_sec * 1000000000UL + (uint64_t) ts.tv_nsec;
+}
+
+static void report(const char *name, uint64_t start, size_t n_ops) {
+    const uint64_t elapsed = now_ns() - start;
+    printf("%-24s %10zu ops %10.1f ns/op\n", name, n_ops, (double) elapsed / (double) n_ops);
+}
+
+static void set_amount(cma_amount_t *amount, uint8_t value) {
+    memset(amount->data, 0, sizeof(amount->data));
+    amount->data[sizeof(amount->data) - 1] = value;
+}
+
+int main(void) {
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_token_address_t token_address = {.data = {0x01}};
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address, NULL, NULL, &asset_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_account_id_t *account_ids = malloc(N_ACCOUNTS * sizeof(cma_ledger_account_id_t));
+    assert(account_ids != NULL);
+    for (size_t i = 0; i < N_ACCOUNTS; ++i) {
+        cma_ledger_account_t account = {};
+        memcpy(account.address.data, &i, sizeof(i));
+        cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+        assert(cma_ledger_retrieve_account(&ledger, &account_ids[i], &account, NULL, NULL, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    }
+
+    cma_amount_t amount;
+    set_amount(&amount, 2);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < N_ACCOUNTS; ++i) {
+        assert(cma_ledger_deposit(&ledger, asset_id, account_ids[i], &amount) == CMA_LEDGER_SUCCESS);
+    }
+    report("deposit (new balance)", start, N_ACCOUNTS);
+
+    start = now_ns();
+    for (size_t i = 0; i < N_ACCOUNTS; ++i) {
+        assert(cma_ledger_deposit(&ledger, asset_id, account_ids[i], &amount) == CMA_LEDGER_SUCCESS);
+    }
+    report("deposit", start, N_ACCOUNTS);
+
+    set_amount(&amount, 1);
+    start = now_ns();
+    for (size_t i = 0; i < N_ACCOUNTS; ++i) {
+        assert(cma_ledger_transfer(&ledger, asset_id, account_ids[i], account_ids[(i + 1) % N_ACCOUNTS], &amount) ==
+            CMA_LEDGER_SUCCESS);
+    }
+    report("transfer", start, N_ACCOUNTS);
+
+    set_amount(&amount, 4);
+    start = now_ns();
+    for (size_t i = 0; i < N_ACCOUNTS; ++i) {
+        assert(cma_ledger_withdraw(&ledger, asset_id, account_ids[i], &amount) == CMA_LEDGER_SUCCESS);
+    }
+    report("withdraw (to zero)", start, N_ACCOUNTS);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(account_ids);
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,198 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libcma/u256.h"
+
+#define N_AMOUNTS 4096UL //< Distinct operands
+#define N_ROUNDS 64UL    //< Passes over the operands per measurement
+#define FEE_BPS 30UL     //< Fee in basis points for the mul_div measurements
+#define BPS 10000UL      //< Basis points in a whole
+
+// Times the u256 api against the byte at a time loops applications would otherwise write (schoolbook byte
+// multiplication and shift and subtract division), after checking both agree on every operand.
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    assert(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+    return (uint64_t) ts.tv_sec * 1000000000UL + (uint64_t) ts.tv_nsec;
+}
+
+static int bytewise_add(cma_amount_t *res, const cma_amount_t *a, const cma_amount_t *b) {
+    unsigned carry = 0;
+    for (size_t i = CMA_ABI_U256_LENGTH; i-- > 0;) {
+        const unsigned tmp = carry + a->data[i] + b->data[i];
+        res->data[i] = (uint8_t) tmp;
+        carry = tmp >> 8;
+    }
+    return carry == 0 ? CMA_U256_SUCCESS : CMA_U256_ERROR_OVERFLOW;
+}
+
+static int bytewise_mul(cma_amount_t *res, const cma_amount_t *a, const cma_amount_t *b) {
+    uint8_t prod[2 * CMA_ABI_U256_LENGTH] = {0};
+    for (size_t i = CMA_ABI_U256_LENGTH; i-- > 0;) {
+        unsigned carry = 0;
+        for (size_t j = CMA_ABI_U256_LENGTH; j-- > 0;) {
+            const unsigned tmp = ((unsigned) a->data[i] * b->data[j]) + prod[i + j + 1] + carry;
+            prod[i + j + 1] = (uint8_t) tmp;
+            carry = tmp >> 8;
+        }
+        prod[i] = (uint8_t) carry;
+    }
+    for (size_t i = 0; i < CMA_ABI_U256_LENGTH; i++) {
+        if (prod[i] != 0) {
+            return CMA_U256_ERROR_OVERFLOW;
+        }
+    }
+    memcpy(res->data, prod + CMA_ABI_U256_LENGTH, CMA_ABI_U256_LENGTH);
+    return CMA_U256_SUCCESS;
+}
+
+// Restoring division, one bit of the quotient per step
+static int bitwise_divmod(cma_amount_t *quot, cma_amount_t *rem, const cma_amount_t *a, const cma_amount_t *b) {
+    cma_amount_t q = {0};
+    cma_amount_t r = {0};
+    for (size_t bit = 0; bit < 8 * CMA_ABI_U256_LENGTH; bit++) {
+        for (size_t i = 0; i < CMA_ABI_U256_LENGTH - 1; i++) {
+            r.data[i] = (uint8_t) ((r.data[i] << 1) | (r.data[i + 1] >> 7));
+        }
+        r.data[CMA_ABI_U256_LENGTH - 1] =
+            (uint8_t) ((r.data[CMA_ABI_U256_LENGTH - 1] << 1) | ((a->data[bit / 8] >> (7 - (bit % 8))) & 1));
+        if (memcmp(r.data, b->data, CMA_ABI_U256_LENGTH) >= 0) {
+            unsigned borrow = 0;
+            for (size_t i = CMA_ABI_U256_LENGTH; i-- > 0;) {
+                const unsigned sub = borrow + b->data[i];
+                const unsigned tmp = r.data[i] + 256U - sub;
+                borrow = r.data[i] < sub ? 1 : 0;
+                r.data[i] = (uint8_t) tmp;
+            }
+            q.data[bit / 8] |= (uint8_t) (1U << (7 - (bit % 8)));
+        }
+    }
+    *quot = q;
+    *rem = r;
+    return CMA_U256_SUCCESS;
+}
+
+// Operands up to 120 bits, so their products and fee computations fit the byte loops
+static void make_amounts(cma_amount_t *amounts) {
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < N_AMOUNTS; i++) {
+        memset(amounts[i].data, 0, CMA_ABI_U256_LENGTH);
+        const size_t width = 1 + (i % 15);
+        for (size_t j = CMA_ABI_U256_LENGTH - width; j < CMA_ABI_U256_LENGTH; j++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            amounts[i].data[j] = (uint8_t) (state >> 56);
+        }
+        amounts[i].data[CMA_ABI_U256_LENGTH - 1] |= 1;
+    }
+}
+
+typedef int (*binary_op_t)(cma_amount_t *res, const cma_amount_t *a, const cma_amount_t *b);
+
+static int api_div(cma_amount_t *res, const cma_amount_t *a, const cma_amount_t *b) {
+    cma_amount_t rem;
+    return cma_u256_divmod(res, &rem, a, b);
+}
+
+static int bitwise_div(cma_amount_t *res, const cma_amount_t *a, const cma_amount_t *b) {
+    cma_amount_t rem;
+    return bitwise_divmod(res, &rem, a, b);
+}
+
+static void bench_binary(const char *name, const cma_amount_t *amounts, binary_op_t op, size_t n_rounds) {
+    cma_amount_t res = {0};
+    size_t sink = 0;
+    const uint64_t start = now_ns();
+    for (size_t round = 0; round < n_rounds; round++) {
+        for (size_t i = 0; i < N_AMOUNTS; i++) {
+            sink += (size_t) op(&res, &amounts[i], &amounts[(i + round + 1) % N_AMOUNTS]);
+            sink += res.data[CMA_ABI_U256_LENGTH - 1];
+        }
+    }
+    const uint64_t elapsed = now_ns() - start;
+    const size_t n_ops = n_rounds * N_AMOUNTS;
+    printf("%-24s %10zu ops %10.1f ns/op (%zx)\n", name, n_ops, (double) elapsed / (double) n_ops, sink);
+}
+
+// amount * FEE_BPS / BPS
+static void bench_fee(const char *name, const cma_amount_t *amounts, int use_api) {
+    cma_amount_t fee_bps;
+    cma_amount_t bps;
+    assert(cma_u256_from_u64(&fee_bps, FEE_BPS) == CMA_U256_SUCCESS);
+    assert(cma_u256_from_u64(&bps, BPS) == CMA_U256_SUCCESS);
+    cma_amount_t res = {0};
+    cma_amount_t rem = {0};
+    size_t sink = 0;
+    const uint64_t start = now_ns();
+    for (size_t round = 0; round < N_ROUNDS; round++) {
+        for (size_t i = 0; i < N_AMOUNTS; i++) {
+            if (use_api) {
+                assert(cma_u256_mul_div(&res, &rem, &amounts[i], &fee_bps, &bps) == CMA_U256_SUCCESS);
+            } else {
+                cma_amount_t prod;
+                assert(bytewise_mul(&prod, &amounts[i], &fee_bps) == CMA_U256_SUCCESS);
+                assert(bitwise_divmod(&res, &rem, &prod, &bps) == CMA_U256_SUCCESS);
+            }
+            sink += res.data[CMA_ABI_U256_LENGTH - 1];
+        }
+    }
+    const uint64_t elapsed = now_ns() - start;
+    const size_t n_ops = N_ROUNDS * N_AMOUNTS;
+    printf("%-24s %10zu ops %10.1f ns/op (%zx)\n", name, n_ops, (double) elapsed / (double) n_ops, sink);
+}
+
+static void check_equivalence(const cma_amount_t *amounts) {
+    for (size_t i = 0; i < N_AMOUNTS; i++) {
+        const cma_amount_t *a = &amounts[i];
+        const cma_amount_t *b = &amounts[(i * 31 + 7) % N_AMOUNTS];
+        cma_amount_t expected;
+        cma_amount_t got;
+        cma_amount_t expected_rem;
+        cma_amount_t got_rem;
+        assert(bytewise_add(&expected, a, b) == cma_u256_add(&got, a, b));
+        assert(memcmp(expected.data, got.data, CMA_ABI_U256_LENGTH) == 0);
+        assert(bytewise_mul(&expected, a, b) == cma_u256_mul(&got, a, b));
+        assert(memcmp(expected.data, got.data, CMA_ABI_U256_LENGTH) == 0);
+        assert(bitwise_divmod(&expected, &expected_rem, a, b) == cma_u256_divmod(&got, &got_rem, a, b));
+        assert(memcmp(expected.data, got.data, CMA_ABI_U256_LENGTH) == 0);
+        assert(memcmp(expected_rem.data, got_rem.data, CMA_ABI_U256_LENGTH) == 0);
+    }
+}
+
+static void bench_to_dec(const cma_amount_t *amounts) {
+    char out[CMA_U256_DEC_STRING_LENGTH];
+    size_t sink = 0;
+    const uint64_t start = now_ns();
+    for (size_t round = 0; round < N_ROUNDS; round++) {
+        for (size_t i = 0; i < N_AMOUNTS; i++) {
+            assert(cma_u256_to_dec(&amounts[i], out, sizeof(out)) == CMA_U256_SUCCESS);
+            sink += (size_t) out[0];
+        }
+    }
+    const uint64_t elapsed = now_ns() - start;
+    const size_t n_ops = N_ROUNDS * N_AMOUNTS;
+    printf("%-24s %10zu ops %10.1f ns/op (%zx)\n", "to_dec api", n_ops, (double) elapsed / (double) n_ops, sink);
+}
+
+int main(void) {
+    cma_amount_t *amounts = malloc(N_AMOUNTS * sizeof(cma_amount_t));
+    assert(amounts != NULL);
+    make_amounts(amounts);
+    check_equivalence(amounts);
+
+    bench_binary("add bytewise", amounts, bytewise_add, N_ROUNDS);
+    bench_binary("add api", amounts, cma_u256_add, N_ROUNDS);
+    bench_binary("mul bytewise", amounts, bytewise_mul, N_ROUNDS);
+    bench_binary("mul api", amounts, cma_u256_mul, N_ROUNDS);
+    bench_binary("div bitwise", amounts, bitwise_div, N_ROUNDS / 16);
+    bench_binary("div api", amounts, api_div, N_ROUNDS);
+    bench_fee("fee bytewise", amounts, 0);
+    bench_fee("fee mul_div api", amounts, 1);
+    bench_to_dec(amounts);
+
+    free(amounts);
+    return 0;
+}
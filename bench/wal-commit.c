@@ -0,0 +1,101 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libcma/ledger.h"
+
+#define N_ACCOUNTS (16UL * 1024)      //< Accounts (one balance each)
+#define MAX_ACCOUNTS N_ACCOUNTS       //< Maximum number of accounts.
+#define MAX_BALANCES 8 * MAX_ACCOUNTS //< Max balances
+#define MAX_ASSETS 8UL                //< Maximum number of assets.
+#define MEM_LENGTH 64UL * 1024 * 1024 //< State length
+#define WAL_LENGTH 16UL * 1024 * 1024 //< Write-ahead log length (the setup fits, no checkpoint while timing)
+#define N_COMMITS 256UL               //< Transactions committed per run
+#define N_TRANSFERS 8UL               //< Transfers between random accounts per transaction
+#define TMPFILE_PATH_SIZE 24
+
+// Commit latency of a file ledger under the per commit flush policy: without a log the pages each transaction dirtied
+// are flushed (asynchronously, so nothing is durable yet), with a log only the log file is synced. The ledger file is
+// created in the working directory, run it on the drive the ledger is meant for (a tmpfs makes every sync free).
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    assert(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+    return (uint64_t) ts.tv_sec * 1000000000UL + (uint64_t) ts.tv_nsec;
+}
+
+static void set_amount(cma_amount_t *amount, uint8_t value) {
+    memset(amount->data, 0, sizeof(amount->data));
+    amount->data[sizeof(amount->data) - 1] = value;
+}
+
+static void bench_commit(const char *name, size_t wal_length) {
+    char temp_filepath[TMPFILE_PATH_SIZE] = "./wal-commitXXXXXX";
+    const int fd = mkstemp(temp_filepath);
+    assert(fd != -1 && ftruncate(fd, MEM_LENGTH) == 0 && close(fd) == 0);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_file_wal(&ledger, temp_filepath, CMA_LEDGER_CREATE_ONLY, 0, MEM_LENGTH, wal_length,
+               MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+
+    // accounts and balances are set up unsynced, then written out at once
+    assert(cma_ledger_set_flush_policy(&ledger, CMA_LEDGER_FLUSH_NONE) == CMA_LEDGER_SUCCESS);
+    cma_token_address_t token_address = {.data = {0x01}};
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address, NULL, NULL, &asset_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    cma_ledger_account_id_t *account_ids = malloc(N_ACCOUNTS * sizeof(cma_ledger_account_id_t));
+    assert(account_ids != NULL);
+    cma_amount_t amount;
+    set_amount(&amount, 0xff);
+    for (size_t i = 0; i < N_ACCOUNTS; ++i) {
+        cma_ledger_account_t account = {};
+        memcpy(account.address.data, &i, sizeof(i));
+        cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+        assert(cma_ledger_retrieve_account(&ledger, &account_ids[i], &account, NULL, NULL, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+        assert(cma_ledger_deposit(&ledger, asset_id, account_ids[i], &amount) == CMA_LEDGER_SUCCESS);
+    }
+    assert(cma_ledger_set_flush_policy(&ledger, CMA_LEDGER_FLUSH_PER_COMMIT) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_checkpoint(&ledger) == CMA_LEDGER_SUCCESS);
+
+    // transfers scattered over the whole ledger, so every transaction dirties pages of its own
+    set_amount(&amount, 1);
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    uint64_t max_ns = 0;
+    const uint64_t start = now_ns();
+    for (size_t i = 0; i < N_COMMITS; ++i) {
+        const uint64_t commit_start = now_ns();
+        assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+        for (size_t j = 0; j < N_TRANSFERS; ++j) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            const size_t from = (state >> 33) % N_ACCOUNTS;
+            const size_t to = (from + 1 + (state >> 13) % (N_ACCOUNTS - 1)) % N_ACCOUNTS;
+            assert(cma_ledger_transfer(&ledger, asset_id, account_ids[from], account_ids[to], &amount) ==
+                CMA_LEDGER_SUCCESS);
+        }
+        assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+        const uint64_t commit_ns = now_ns() - commit_start;
+        max_ns = commit_ns > max_ns ? commit_ns : max_ns;
+    }
+    const uint64_t elapsed = now_ns() - start;
+    printf("%-24s %10zu commits %10.1f us/commit (max %.1f us)\n", name, N_COMMITS,
+        (double) elapsed / (double) N_COMMITS / 1000.0, (double) max_ns / 1000.0);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(account_ids);
+    char wal_filepath[TMPFILE_PATH_SIZE + sizeof("-wal")];
+    snprintf(wal_filepath, sizeof(wal_filepath), "%s-wal", temp_filepath);
+    unlink(wal_filepath);
+    assert(unlink(temp_filepath) == 0);
+}
+
+int main(void) {
+    bench_commit("commit (flush pages)", 0);
+    bench_commit("commit (sync log)", WAL_LENGTH);
+    return 0;
+}
@@ -17,6 +17,7 @@ extern "C" {
 enum {
     CMA_LEDGER_T_SIZE = 512, // / 8,
     CMA_LEDGER_MIN_MEM_LENGTH = 262144,
+    CMA_LEDGER_HASH_SEED_LENGTH = 16,
 };
 
 typedef struct cma_ledger_struct {
@@ -44,6 +45,7 @@ enum {
     CMA_LEDGER_ERROR_ASSET_SUPPLY = -1014,
     CMA_LEDGER_ERROR_ACCOUNT_BALANCE = -1015,
     CMA_LEDGER_ERROR_REMOVE = -1016,
+    CMA_LEDGER_ERROR_TRANSACTION = -1017,
 };
 
 typedef enum {
@@ -72,6 +74,23 @@ typedef enum {
     CMA_LEDGER_CREATE_ONLY,
 } cma_ledger_memory_mode_t;
 
+typedef enum {
+    CMA_LEDGER_FLUSH_PER_OP,     // flush after every operation (postponed to commit inside transactions)
+    CMA_LEDGER_FLUSH_PER_COMMIT, // flush only on transaction commit
+    CMA_LEDGER_FLUSH_NONE,       // never flush (pmem/DAX drives, persistence comes from the machine snapshot)
+} cma_ledger_flush_policy_t;
+
+typedef enum {
+    CMA_LEDGER_OP_TYPE_DEPOSIT,
+    CMA_LEDGER_OP_TYPE_WITHDRAW,
+    CMA_LEDGER_OP_TYPE_TRANSFER,
+} cma_ledger_op_type_t;
+
+typedef enum {
+    CMA_LEDGER_BATCH_BEST_EFFORT,     // apply every operation that succeeds
+    CMA_LEDGER_BATCH_ALL_OR_NOTHING,  // apply all operations or none of them
+} cma_ledger_batch_mode_t;
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpedantic"
 typedef struct cma_ledger_account {
@@ -95,6 +114,35 @@ typedef struct cma_ledger_account_balance {
     uint8_t padding[20]; // Align to 4*32 bytes
 } cma_ledger_account_balance_t;
 
+typedef struct cma_ledger_asset_balance {
+    cma_ledger_asset_id_t asset_id;
+    cma_amount_t amount;
+} cma_ledger_asset_balance_t;
+
+typedef struct cma_ledger_holder_balance {
+    cma_ledger_account_id_t account_id;
+    cma_amount_t amount;
+} cma_ledger_holder_balance_t;
+
+typedef struct cma_ledger_op {
+    cma_ledger_op_type_t type;
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_account_id_t from_account_id; // withdraw and transfer
+    cma_ledger_account_id_t to_account_id;   // deposit and transfer
+    cma_amount_t amount;
+} cma_ledger_op_t;
+
+typedef struct cma_ledger_op_result {
+    int status; // CMA_LEDGER_SUCCESS, the operation error or -ECANCELED when undone by an all or nothing batch
+} cma_ledger_op_result_t;
+
+typedef struct cma_ledger_transfer_leg {
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_account_id_t from_account_id;
+    cma_ledger_account_id_t to_account_id;
+    cma_amount_t amount;
+} cma_ledger_transfer_leg_t;
+
 typedef struct cma_ledger_account_balance_info {
     ptrdiff_t offset;
     size_t index;
@@ -105,10 +153,23 @@ CMA_LEDGER_API int cma_ledger_init(cma_ledger_t *ledger);
 CMA_LEDGER_API int cma_ledger_fini(cma_ledger_t *ledger);
 CMA_LEDGER_API int cma_ledger_reset(cma_ledger_t *ledger);
 
+// Opening a file created with another layout of the ledger memory fails with -EINVAL
 CMA_LEDGER_API int cma_ledger_init_file(cma_ledger_t *ledger, const char *memory_file_name,
     cma_ledger_memory_mode_t mode, size_t offset, size_t mem_length, size_t n_accounts, size_t n_assets,
     size_t n_balances);
 
+// Initialize a file ledger with a write-ahead log of wal_length bytes, kept in its own file (memory_file_name + "-wal")
+// Every change is appended to the log and synced on commit (or per operation, following the flush policy). The
+// ledger file is mapped privately and only written by checkpoints, which are atomic (staged in the log file first),
+// so after a crash the ledger holds exactly the committed transactions. Other mappings of the file only see the state
+// of the last checkpoint, and a file holds a single ledger with a log.
+// A checkpoint runs when the log is full between transactions, on cma_ledger_checkpoint and when opening the ledger
+// (also with cma_ledger_init_file), which replays the log tail. A transaction must fit in half of the log, otherwise
+// the operation fails with -ENOBUFS
+CMA_LEDGER_API int cma_ledger_init_file_wal(cma_ledger_t *ledger, const char *memory_file_name,
+    cma_ledger_memory_mode_t mode, size_t offset, size_t mem_length, size_t wal_length, size_t n_accounts,
+    size_t n_assets, size_t n_balances);
+
 CMA_LEDGER_API int cma_ledger_init_buffer(cma_ledger_t *ledger, void *buffer, size_t mem_length, size_t n_accounts,
     size_t n_assets, size_t n_balances);
 
@@ -145,6 +206,76 @@ CMA_LEDGER_API int cma_ledger_get_balance(cma_ledger_t *ledger, cma_ledger_asset
     cma_ledger_account_id_t account_id, cma_amount_t *out_balance,
     cma_ledger_account_balance_info_t *account_balance_info);
 
+// List the balances of an account (the assets it holds a non zero amount of), in no particular order
+// n_balances receives the number of balances of the account, at most cap of them are written to out
+// The cost is proportional to the number of balances of the account, not to the size of the ledger
+CMA_LEDGER_API int cma_ledger_list_account_balances(cma_ledger_t *ledger, cma_ledger_account_id_t account_id,
+    cma_ledger_asset_balance_t *out, size_t cap, size_t *n_balances);
+
+// List the holders of an asset (the accounts with a non zero balance of it) a page at a time, in no particular order
+// n_holders receives the number of holders of the asset, at most cap of them are written to out, starting with the
+// first holder when after_account_id is NULL and otherwise with the one following it (the last account of the
+// previous page, which fails with CMA_LEDGER_ERROR_BALANCE_NOT_FOUND once it no longer holds the asset)
+// Pages are consistent while the ledger is unchanged, the cost of a page is proportional to cap, not to the number of
+// holders before it nor to the size of the ledger
+CMA_LEDGER_API int cma_ledger_list_asset_holders(cma_ledger_t *ledger, cma_ledger_asset_id_t asset_id,
+    const cma_ledger_account_id_t *after_account_id, cma_ledger_holder_balance_t *out, size_t cap,
+    size_t *n_holders);
+
+// Get the account holding a token address and id asset (single supply, like an ERC-721 token) in constant time
+// Fails with CMA_LEDGER_ERROR_BALANCE_NOT_FOUND when no account holds it and -EINVAL for other asset types
+CMA_LEDGER_API int cma_ledger_get_owner(cma_ledger_t *ledger, cma_ledger_asset_id_t asset_id,
+    cma_ledger_account_id_t *owner_account_id);
+
+// Apply a batch of deposits, withdrawals and transfers in order, flushing once
+// results (optional) receive the status of each operation, the first error is returned
+// Inside an open transaction the flush is left to the commit
+CMA_LEDGER_API int cma_ledger_apply_batch(cma_ledger_t *ledger, const cma_ledger_op_t *ops, size_t n_ops,
+    cma_ledger_op_result_t *results, cma_ledger_batch_mode_t mode);
+
+// Transfer several legs (possibly of different assets) atomically, either all legs are applied or none is
+// Legs are netted per account and asset, so an account may spend in one leg what it receives in another
+// The final balances are checked once and written with a single flush
+CMA_LEDGER_API int cma_ledger_transfer_multi(cma_ledger_t *ledger, const cma_ledger_transfer_leg_t *legs,
+    size_t n_legs);
+
+// Begin a transaction
+// Operations inside the transaction only touch memory, the ledger memory is flushed once on commit
+CMA_LEDGER_API int cma_ledger_begin(cma_ledger_t *ledger);
+
+// Commit the transaction and flush the ledger memory
+// Note: if the flush fails the transaction stays open, so it can still be rolled back
+CMA_LEDGER_API int cma_ledger_commit(cma_ledger_t *ledger);
+
+// Abort the transaction, discarding its changes as cma_ledger_rollback does
+// Note: ledgers that can't undo changes (cma_ledger_init) fail with -ENOTSUP and keep the transaction open
+CMA_LEDGER_API int cma_ledger_abort(cma_ledger_t *ledger);
+// Roll back the changes made inside the transaction (balances, supplies, accounts and assets) and close it
+// Note: withdrawable balances may end up in a different order than before the transaction
+CMA_LEDGER_API int cma_ledger_rollback(cma_ledger_t *ledger);
+
+// Set the flush policy of the ledger memory (default is CMA_LEDGER_FLUSH_PER_OP)
+// The policy doesn't change the ledger layout, so it can be switched at any time
+// Note: changes made under CMA_LEDGER_FLUSH_NONE aren't tracked, the first flush after leaving it writes the whole
+// ledger memory (with a write-ahead log they are, the policy only decides when the log is synced)
+CMA_LEDGER_API int cma_ledger_set_flush_policy(cma_ledger_t *ledger, cma_ledger_flush_policy_t policy);
+
+// Flush the ledger memory, or with a write-ahead log write the changes to the ledger file and discard the log records
+// (can't be called inside a transaction)
+CMA_LEDGER_API int cma_ledger_checkpoint(cma_ledger_t *ledger);
+
+// Size every table and list of the ledger memory for the maximums given at init (call it right after init)
+// Afterwards no operation grows a table or reallocates, erased slots are purged in place. The capacity is kept in the
+// ledger memory, so it also holds when the ledger is reopened. Can't be called inside a transaction
+CMA_LEDGER_API int cma_ledger_presize(cma_ledger_t *ledger);
+
+// Key the hashes of account and asset keys with a seed of CMA_LEDGER_HASH_SEED_LENGTH bytes, kept in the ledger
+// memory (call it right after init, it fails with -EBUSY once an account or asset with a key was created)
+// A ledger given no seed hashes with an all zero one. Either way the image only depends on the seed and the operations
+// applied, so it is reproducible, but only a seed kept secret stops colliding keys from being precomputed
+// Not supported by the RAM ledger (cma_ledger_init), which fails with -ENOTSUP
+CMA_LEDGER_API int cma_ledger_set_hash_seed(cma_ledger_t *ledger, const uint8_t *seed);
+
 // get error message
 CMA_LEDGER_API const char *cma_ledger_get_last_error_message();
 
@@ -0,0 +1,80 @@
+#ifndef CMA_U256_H
+#define CMA_U256_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Compiler visibility definition
+#ifndef CMA_U256_API
+#define CMA_U256_API __attribute__((visibility("default")))
+#endif
+
+#include "types.h"
+
+enum {
+    CMA_U256_DEC_STRING_LENGTH = 79, // 78 digits of 2^256 - 1 and the terminating null
+    CMA_U256_HEX_STRING_LENGTH = 67, // 0x, 64 digits and the terminating null
+};
+
+enum {
+    CMA_U256_SUCCESS = 0,
+    CMA_U256_ERROR_OVERFLOW = -3001,
+    CMA_U256_ERROR_DIVISION_BY_ZERO = -3002,
+    CMA_U256_ERROR_INVALID_STRING = -3003,
+    CMA_U256_ERROR_BUFFER_TOO_SMALL = -3004,
+};
+
+// Amounts are the big-endian 256-bit ABI values, the results may alias the operands
+// On error the results are left untouched, null operands return -EINVAL
+
+// res = a + b, fails with CMA_U256_ERROR_OVERFLOW on a carry out
+CMA_U256_API int cma_u256_add(cma_amount_t *res, const cma_amount_t *a, const cma_amount_t *b);
+
+// res = a - b, fails with CMA_U256_ERROR_OVERFLOW when b > a
+CMA_U256_API int cma_u256_sub(cma_amount_t *res, const cma_amount_t *a, const cma_amount_t *b);
+
+// res = a * b, fails with CMA_U256_ERROR_OVERFLOW when the product needs more than 256 bits
+CMA_U256_API int cma_u256_mul(cma_amount_t *res, const cma_amount_t *a, const cma_amount_t *b);
+
+// quot = a / b and rem = a % b, either may be null
+CMA_U256_API int cma_u256_divmod(cma_amount_t *quot, cma_amount_t *rem, const cma_amount_t *a, const cma_amount_t *b);
+
+// res = a * b / c with the product kept at 512 bits, so it can't overflow halfway (fees, pro-rata splits, prices)
+// rem (optional) receives a * b % c, a non zero remainder tells callers rounding up to add one
+// Fails with CMA_U256_ERROR_OVERFLOW only when the quotient itself needs more than 256 bits
+CMA_U256_API int cma_u256_mul_div(cma_amount_t *res, cma_amount_t *rem, const cma_amount_t *a, const cma_amount_t *b,
+    const cma_amount_t *c);
+
+// res = a << shift and res = a >> shift, shifts of 256 bits or more give zero
+CMA_U256_API int cma_u256_shl(cma_amount_t *res, const cma_amount_t *a, unsigned int shift);
+CMA_U256_API int cma_u256_shr(cma_amount_t *res, const cma_amount_t *a, unsigned int shift);
+
+// Returns -1, 0 or 1 as a is less than, equal to or greater than b (both must be valid)
+CMA_U256_API int cma_u256_compare(const cma_amount_t *a, const cma_amount_t *b);
+
+// Returns 1 when a is zero, otherwise 0 (a must be valid)
+CMA_U256_API int cma_u256_is_zero(const cma_amount_t *a);
+
+// Conversions from and to 64-bit integers, to_u64 fails with CMA_U256_ERROR_OVERFLOW when a doesn't fit
+CMA_U256_API int cma_u256_from_u64(cma_amount_t *res, uint64_t value);
+CMA_U256_API int cma_u256_to_u64(const cma_amount_t *a, uint64_t *out_value);
+
+// Parse len characters of decimal digits, or of hex digits with an optional 0x prefix
+// Fails with CMA_U256_ERROR_INVALID_STRING on an empty string or another character
+CMA_U256_API int cma_u256_from_dec(cma_amount_t *res, const char *str, size_t len);
+CMA_U256_API int cma_u256_from_hex(cma_amount_t *res, const char *str, size_t len);
+
+// Write a null terminated decimal or 0x prefixed lowercase hex string without leading zeros
+// out_len must hold at least CMA_U256_DEC_STRING_LENGTH or CMA_U256_HEX_STRING_LENGTH bytes for any value, otherwise
+// it fails with CMA_U256_ERROR_BUFFER_TOO_SMALL when the string doesn't fit
+CMA_U256_API int cma_u256_to_dec(const cma_amount_t *a, char *out, size_t out_len);
+CMA_U256_API int cma_u256_to_hex(const cma_amount_t *a, char *out, size_t out_len);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // CMA_U256_H
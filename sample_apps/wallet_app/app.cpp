@@ -1144,6 +1144,41 @@ auto process_advance(cmt_rollup_t *rollup, cma_ledger_t *ledger, cmt_rollup_adva
     // throw AppException("invalid advance state request", -EINVAL);
 }
 
+// Dispatch an advance input to its handler
+auto process_input(cmt_rollup_t *rollup, cma_ledger_t *ledger, cmt_rollup_advance_t *input) -> void {
+    // Ether Deposit?
+    if (input->msg_sender == ETHER_PORTAL_ADDRESS) {
+        process_ether_deposit(ledger, input);
+        return;
+    }
+
+    // Erc20 Deposit?
+    if (input->msg_sender == ERC20_PORTAL_ADDRESS) {
+        process_erc20_deposit(ledger, input);
+        return;
+    }
+
+    // Erc721 Deposit?
+    if (input->msg_sender == ERC721_PORTAL_ADDRESS) {
+        process_erc721_deposit(ledger, input);
+        return;
+    }
+
+    // Erc1155Single Deposit?
+    if (input->msg_sender == ERC1155_SINGLE_PORTAL_ADDRESS) {
+        process_erc1155_single_deposit(ledger, input);
+        return;
+    }
+
+    // Erc1155Batch Deposit?
+    if (input->msg_sender == ERC1155_BATCH_PORTAL_ADDRESS) {
+        process_erc1155_batch_deposit(ledger, input);
+        return;
+    }
+
+    process_advance(rollup, ledger, input);
+}
+
 // Process advance state requests
 auto advance_state(cmt_rollup_t *rollup, cma_ledger_t *ledger) -> bool try {
     // Read the input.
@@ -1173,50 +1208,36 @@ auto advance_state(cmt_rollup_t *rollup, cma_ledger_t *ledger) -> bool try {
     }
     std::ignore = std::fprintf(stdout,"\n");
 
-    // Ether Deposit?
-    if (input.msg_sender == ETHER_PORTAL_ADDRESS) {
-        process_ether_deposit(ledger, &input);
-        return true;
-    }
-
-    // Erc20 Deposit?
-    if (input.msg_sender == ERC20_PORTAL_ADDRESS) {
-        process_erc20_deposit(ledger, &input);
-        return true;
-    }
-
-    // Erc721 Deposit?
-    if (input.msg_sender == ERC721_PORTAL_ADDRESS) {
-        process_erc721_deposit(ledger, &input);
-        return true;
+    // Flush the ledger only once per advance
+    err = cma_ledger_begin(ledger);
+    if (err != CMA_LEDGER_SUCCESS) {
+        throw AppException(std::string("unable to begin ledger transaction: ")
+            .append(cma_ledger_get_last_error_message()).c_str(), err);
     }
 
-    // Erc1155Single Deposit?
-    if (input.msg_sender == ERC1155_SINGLE_PORTAL_ADDRESS) {
-        process_erc1155_single_deposit(ledger, &input);
-        return true;
-    }
+    process_input(rollup, ledger, &input);
 
-    // Erc1155Batch Deposit?
-    if (input.msg_sender == ERC1155_BATCH_PORTAL_ADDRESS) {
-        process_erc1155_batch_deposit(ledger, &input);
-        return true;
+    err = cma_ledger_commit(ledger);
+    if (err != CMA_LEDGER_SUCCESS) {
+        throw AppException(std::string("unable to commit ledger transaction: ")
+            .append(cma_ledger_get_last_error_message()).c_str(), err);
     }
-
-    process_advance(rollup, ledger, &input);
     return true;
 } catch (const AppException &e) {
+    std::ignore = cma_ledger_rollback(ledger);
   std::ignore =
       std::fprintf(stderr, "[app] app exception caught: (%d) %s\n",
                    e.code(), e.what());
     std::ignore = rollup_emit_report(rollup, error_report{-e.code()});
     return false;
 } catch (const std::exception &e) {
+    std::ignore = cma_ledger_rollback(ledger);
     std::ignore =
         std::fprintf(stderr, "[app] exception caught: %s\n", e.what());
     std::ignore = rollup_emit_report(rollup, error_report{-EPERM});
     return false;
 } catch (...) {
+    std::ignore = cma_ledger_rollback(ledger);
     std::ignore =
         std::fprintf(stderr, "[app] unknown exception caught\n");
     std::ignore = rollup_emit_report(rollup, error_report{-EPERM});
@@ -1247,6 +1268,12 @@ auto main(int argc, char* argv[]) -> int {
         return -1;
     }
     if (argc > 2) {
+        // Size the tables for the maximums once, so no input pays for a rehash inside the machine
+        err = cma_ledger_presize(&ledger);
+        if (err != CMA_LEDGER_SUCCESS) {
+            std::ignore = std::fprintf(stderr, "[app] unable to presize ledger: (%d) %s\n", err, cma_ledger_get_last_error_message());
+            return -1;
+        }
         err = cma_ledger_fini(&ledger);
         if (err != CMA_LEDGER_SUCCESS) {
             std::ignore = std::fprintf(stderr, "[app] unable to finalize ledger: (%d) %s\n", err, cma_ledger_get_last_error_message());
@@ -1256,6 +1283,14 @@ auto main(int argc, char* argv[]) -> int {
         return 0;
     }
 
+    // The ledger lives in a pmem drive and the main loop syncs before accepting each request,
+    // so there is no need to flush the mapped memory on every operation
+    err = cma_ledger_set_flush_policy(&ledger, CMA_LEDGER_FLUSH_NONE);
+    if (err != CMA_LEDGER_SUCCESS) {
+        std::ignore = std::fprintf(stderr, "[app] unable to set ledger flush policy: (%d) %s\n", err, cma_ledger_get_last_error_message());
+        return -1;
+    }
+
     // create ether asset in ledger lib
     cma_ledger_asset_id_t asset_id;
     cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_BASE;
@@ -39,8 +39,11 @@
 #include <boost/interprocess/containers/string.hpp>
 #include <boost/version.hpp>
 
+#include "swar_flat_map.hpp"
+
 // Fixes misc-include-cleaner check
 #include <boost/interprocess/creation_tags.hpp>
+#include <boost/interprocess/detail/os_file_functions.hpp>
 #include <boost/interprocess/detail/segment_manager_helper.hpp>
 #include <boost/interprocess/interprocess_fwd.hpp>
 #include <boost/predef.h>
@@ -75,6 +78,7 @@ using boost::interprocess::create_only;
 using boost::interprocess::open_only_t;
 using boost::interprocess::open_only;
 using boost::interprocess::read_write;
+using boost::interprocess::copy_on_write;
 using boost::interprocess::unique_instance;
 
 using basic_string = boost::interprocess::basic_string<char, std::char_traits<char>, void_allocator>;
@@ -111,6 +115,11 @@ template <typename Key, class Hash = boost::hash<Key>, class KeyEqual = std::equ
 using unordered_flat_set = boost::unordered_flat_set<Key, Hash, KeyEqual,
     boost::interprocess::allocator<Key, managed_memory::segment_manager>>;
 
+// Deterministic flat map (same bytes on every architecture, no SIMD probing)
+template <typename Key, typename Value, class Hash = boost::hash<Key>, class KeyEqual = std::equal_to<>>
+using swar_flat_map = libcma::swar_flat_map<Key, Value, Hash, KeyEqual,
+    boost::interprocess::allocator<libcma::swar_flat_map_entry<Key, Value>, managed_memory::segment_manager>>;
+
 template <typename Key, typename Value, class Compare>
 using flat_map = boost::container::flat_map<Key, Value, Compare,
     boost::interprocess::allocator<std::pair<Key, Value>, managed_memory::segment_manager>>;
@@ -130,6 +139,13 @@ inline auto remove(const char *file_name) -> void {
     boost::interprocess::file_mapping::remove(file_name);
 }
 
+/// @brief Get the native file handle of a file mapping.
+/// @param file The file mapping.
+/// @returns The file descriptor, valid while the file mapping is open.
+inline auto get_file_handle(const file_mapping &file) -> int {
+    return boost::interprocess::ipcdetail::file_handle_from_mapping_handle(file.get_mapping_handle());
+}
+
 } // namespace libcma::interprocess
 
 #endif // INTERPROCESS_HPP
@@ -55,6 +55,7 @@ auto cma_ledger_result_success() -> int {
  */
 
 static_assert(sizeof(cma_ledger_t) >= sizeof(cma_ledger_base));
+static_assert(sizeof(cma_ledger_t) >= sizeof(cma_ledger_memory));
 static_assert(alignof(cma_ledger_t) == alignof(cma_ledger_base));
 
 auto cma_ledger_init(cma_ledger_t *ledger) -> int try {
@@ -65,7 +66,14 @@ auto cma_ledger_init(cma_ledger_t *ledger) -> int try {
 }
 
 auto cma_ledger_init_file(cma_ledger_t *ledger, const char *memory_file_name, cma_ledger_memory_mode_t mode,
-    size_t offset, size_t mem_length, size_t n_accounts, size_t n_assets, size_t n_balances) -> int try {
+    size_t offset, size_t mem_length, size_t n_accounts, size_t n_assets, size_t n_balances) -> int {
+    return cma_ledger_init_file_wal(ledger, memory_file_name, mode, offset, mem_length, 0, n_accounts, n_assets,
+        n_balances);
+}
+
+auto cma_ledger_init_file_wal(cma_ledger_t *ledger, const char *memory_file_name, cma_ledger_memory_mode_t mode,
+    size_t offset, size_t mem_length, size_t wal_length, size_t n_accounts, size_t n_assets, size_t n_balances)
+    -> int try {
 
     size_t required_size = cma_ledger_memory::estimate_required_size(n_accounts, n_assets, n_balances);
     if (required_size > mem_length) {
@@ -85,11 +93,11 @@ auto cma_ledger_init_file(cma_ledger_t *ledger, const char *memory_file_name, cm
     switch (mode) {
         case CMA_LEDGER_OPEN_ONLY:
             new (ledger) cma_ledger_memory(interprocess::open_only, memory_file_name, offset, mem_length, n_accounts,
-                n_assets, n_balances);
+                n_assets, n_balances, wal_length);
             break;
         case CMA_LEDGER_CREATE_ONLY:
             new (ledger) cma_ledger_memory(interprocess::create_only, memory_file_name, offset, mem_length, n_accounts,
-                n_assets, n_balances);
+                n_assets, n_balances, wal_length);
             break;
         default:
             throw CmaException("Invalid file mode type", -EINVAL);
@@ -123,7 +131,7 @@ auto cma_ledger_fini(cma_ledger_t *ledger) -> int try {
     if (!ledger_ptr->is_initialized()) {
         throw CmaException("Invalid ledger ptr", -EINVAL);
     }
-    ledger_ptr->cma_ledger_base::~cma_ledger_base();
+    ledger_ptr->~cma_ledger_base();
     return cma_ledger_result_success();
 } catch (...) {
     return cma_ledger_result_failure();
@@ -199,6 +207,67 @@ auto cma_ledger_get_balance(cma_ledger_t *ledger, cma_ledger_asset_id_t asset_id
     return cma_ledger_result_failure();
 }
 
+auto cma_ledger_list_account_balances(cma_ledger_t *ledger, cma_ledger_account_id_t account_id,
+    cma_ledger_asset_balance_t *out, size_t cap, size_t *n_balances) -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    if (out == nullptr && cap > 0) {
+        throw CmaException("Invalid balances ptr", -EINVAL);
+    }
+    if (n_balances == nullptr) {
+        throw CmaException("Invalid number of balances ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    *n_balances = ledger_ptr->list_account_balances(account_id, out, cap);
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
+auto cma_ledger_list_asset_holders(cma_ledger_t *ledger, cma_ledger_asset_id_t asset_id,
+    const cma_ledger_account_id_t *after_account_id, cma_ledger_holder_balance_t *out, size_t cap,
+    size_t *n_holders) -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    if (out == nullptr && cap > 0) {
+        throw CmaException("Invalid holders ptr", -EINVAL);
+    }
+    if (n_holders == nullptr) {
+        throw CmaException("Invalid number of holders ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    *n_holders = ledger_ptr->list_asset_holders(asset_id, after_account_id, out, cap);
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
+auto cma_ledger_get_owner(cma_ledger_t *ledger, cma_ledger_asset_id_t asset_id,
+    cma_ledger_account_id_t *owner_account_id) -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    if (owner_account_id == nullptr) {
+        throw CmaException("Invalid owner account id ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    *owner_account_id = ledger_ptr->get_owner(asset_id);
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
 auto cma_ledger_deposit(cma_ledger_t *ledger, cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t to_account_id,
     const cma_amount_t *deposit) -> int try {
     if (ledger == nullptr) {
@@ -253,6 +322,163 @@ auto cma_ledger_transfer(cma_ledger_t *ledger, cma_ledger_asset_id_t asset_id, c
     return cma_ledger_result_failure();
 }
 
+auto cma_ledger_apply_batch(cma_ledger_t *ledger, const cma_ledger_op_t *ops, size_t n_ops,
+    cma_ledger_op_result_t *results, cma_ledger_batch_mode_t mode) -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    if (ops == nullptr && n_ops > 0) {
+        throw CmaException("Invalid ops ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    ledger_ptr->apply_batch(ops, n_ops, results, mode);
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
+auto cma_ledger_transfer_multi(cma_ledger_t *ledger, const cma_ledger_transfer_leg_t *legs, size_t n_legs)
+    -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    if (legs == nullptr && n_legs > 0) {
+        throw CmaException("Invalid legs ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    ledger_ptr->transfer_multi(legs, n_legs);
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
+auto cma_ledger_begin(cma_ledger_t *ledger) -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    ledger_ptr->begin();
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
+auto cma_ledger_commit(cma_ledger_t *ledger) -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    ledger_ptr->commit();
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
+auto cma_ledger_abort(cma_ledger_t *ledger) -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    ledger_ptr->abort();
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
+auto cma_ledger_rollback(cma_ledger_t *ledger) -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    ledger_ptr->rollback();
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
+auto cma_ledger_set_flush_policy(cma_ledger_t *ledger, cma_ledger_flush_policy_t policy) -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    ledger_ptr->set_flush_policy(policy);
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
+auto cma_ledger_presize(cma_ledger_t *ledger) -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    ledger_ptr->presize();
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
+auto cma_ledger_set_hash_seed(cma_ledger_t *ledger, const uint8_t *seed) -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    if (seed == nullptr) {
+        throw CmaException("Invalid hash seed ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    // little-endian words, as the key bytes are read
+    cma_hash_seed_t hash_seed{};
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        hash_seed.k0 |= static_cast<uint64_t>(seed[i]) << (8 * i);
+        hash_seed.k1 |= static_cast<uint64_t>(seed[sizeof(uint64_t) + i]) << (8 * i);
+    }
+    ledger_ptr->set_hash_seed(hash_seed);
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
+auto cma_ledger_checkpoint(cma_ledger_t *ledger) -> int try {
+    if (ledger == nullptr) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    auto *ledger_ptr = reinterpret_cast<cma_ledger_base *>(ledger);
+    if (!ledger_ptr->is_initialized()) {
+        throw CmaException("Invalid ledger ptr", -EINVAL);
+    }
+    ledger_ptr->checkpoint();
+    return cma_ledger_result_success();
+} catch (...) {
+    return cma_ledger_result_failure();
+}
+
 auto cma_ledger_get_last_error_message() -> const char * {
     return get_last_err_msg_storage().c_str();
 }
@@ -5,10 +5,15 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <limits>
 #include <span>
 #include <tuple>
 #include <utility>
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 extern "C" {
 #include "libcma/ledger.h"
 #include "libcma/types.h"
@@ -22,11 +27,6 @@ extern "C" {
  * Aux
  */
 
-auto is_one(const cma_amount_t &amount) -> bool {
-    static const cma_amount_t one = {.data = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1}};
-    return std::memcmp(amount.data, one.data, sizeof(amount.data)) == 0;
-}
-
 auto start_with_zeros(const uint8_t *data, size_t len) -> bool {
     static const uint8_t zero[32] = {0};
     if (len > 32) {
@@ -47,6 +47,242 @@ auto cma_ledger_base::is_initialized() const -> bool {
     return magic == CMA_LEDGER_MAGIC;
 }
 
+auto cma_ledger_base::in_transaction() const -> bool {
+    return transaction_open;
+}
+
+void cma_ledger_base::begin() {
+    if (transaction_open) {
+        throw CmaException("Transaction already open", CMA_LEDGER_ERROR_TRANSACTION);
+    }
+    transaction_open = true;
+}
+
+void cma_ledger_base::commit() {
+    if (!transaction_open) {
+        throw CmaException("No open transaction", CMA_LEDGER_ERROR_TRANSACTION);
+    }
+    transaction_open = false;
+}
+
+void cma_ledger_base::abort() {
+    if (!transaction_open) {
+        throw CmaException("No open transaction", CMA_LEDGER_ERROR_TRANSACTION);
+    }
+    throw CmaException("Abort not supported by the ledger", -ENOTSUP);
+}
+
+void cma_ledger_base::rollback() {
+    if (!transaction_open) {
+        throw CmaException("No open transaction", CMA_LEDGER_ERROR_TRANSACTION);
+    }
+    throw CmaException("Rollback not supported by the ledger", -ENOTSUP);
+}
+
+auto cma_ledger_base::savepoint() -> cma_ledger_savepoint_t {
+    throw CmaException("Savepoints not supported by the ledger", -ENOTSUP);
+}
+
+void cma_ledger_base::rollback_to(const cma_ledger_savepoint_t & /*savepoint*/) {
+    throw CmaException("Savepoints not supported by the ledger", -ENOTSUP);
+}
+
+void cma_ledger_base::apply_op(const cma_ledger_op_t &op) {
+    switch (op.type) {
+        case CMA_LEDGER_OP_TYPE_DEPOSIT:
+            deposit(op.asset_id, op.to_account_id, op.amount);
+            break;
+        case CMA_LEDGER_OP_TYPE_WITHDRAW:
+            withdraw(op.asset_id, op.from_account_id, op.amount);
+            break;
+        case CMA_LEDGER_OP_TYPE_TRANSFER:
+            transfer(op.asset_id, op.from_account_id, op.to_account_id, op.amount);
+            break;
+        default:
+            throw CmaException("Invalid operation type", -EINVAL);
+    }
+}
+
+void cma_ledger_base::apply_batch(const cma_ledger_op_t *ops, size_t n_ops, cma_ledger_op_result_t *results,
+    cma_ledger_batch_mode_t mode) {
+    if (mode != CMA_LEDGER_BATCH_BEST_EFFORT && mode != CMA_LEDGER_BATCH_ALL_OR_NOTHING) {
+        throw CmaException("Invalid batch mode", -EINVAL);
+    }
+    // a single transaction amortises the flush over the whole batch
+    const bool own_transaction = !transaction_open;
+    if (own_transaction) {
+        begin();
+    }
+    cma_ledger_savepoint_t batch_savepoint{};
+    if (mode == CMA_LEDGER_BATCH_ALL_OR_NOTHING) {
+        try {
+            batch_savepoint = savepoint();
+        } catch (...) {
+            // nothing was applied yet
+            if (own_transaction) {
+                commit();
+            }
+            throw;
+        }
+    }
+    int first_error = CMA_LEDGER_SUCCESS;
+    std::string first_error_message;
+    try {
+        for (size_t i = 0; i < n_ops; ++i) {
+            int status = CMA_LEDGER_SUCCESS;
+            try {
+                apply_op(ops[i]);
+            } catch (const CmaException &e) {
+                status = e.code();
+                if (first_error == CMA_LEDGER_SUCCESS) {
+                    first_error_message = e.what();
+                }
+            } catch (const std::exception &e) {
+                // e.g. the ledger memory is full
+                status = CMA_LEDGER_ERROR_EXCEPTION;
+                if (first_error == CMA_LEDGER_SUCCESS) {
+                    first_error_message = e.what();
+                }
+            }
+            if (results != nullptr) {
+                results[i].status = status;
+            }
+            if (status == CMA_LEDGER_SUCCESS || first_error != CMA_LEDGER_SUCCESS) {
+                continue;
+            }
+            first_error = status;
+            if (mode == CMA_LEDGER_BATCH_ALL_OR_NOTHING) {
+                rollback_to(batch_savepoint);
+                if (results != nullptr) {
+                    for (size_t j = 0; j < n_ops; ++j) {
+                        if (j != i) {
+                            results[j].status = -ECANCELED;
+                        }
+                    }
+                }
+                break;
+            }
+        }
+    } catch (...) {
+        // whatever failed, nothing of an all or nothing batch is kept
+        if (mode == CMA_LEDGER_BATCH_ALL_OR_NOTHING) {
+            if (own_transaction) {
+                rollback();
+            } else {
+                rollback_to(batch_savepoint);
+            }
+        } else if (own_transaction) {
+            // a best effort batch keeps what succeeded
+            commit();
+        }
+        throw;
+    }
+    if (own_transaction) {
+        commit();
+    }
+    if (first_error != CMA_LEDGER_SUCCESS) {
+        throw CmaException(first_error_message, first_error);
+    }
+}
+
+void cma_ledger_base::set_account_asset_balances(const std::vector<cma_ledger_balance_update_t> &updates) {
+    for (const auto &[key, balance] : updates) {
+        set_account_asset_balance(balance_key_asset_id(key), balance_key_account_id(key), balance);
+    }
+}
+
+void cma_ledger_base::transfer_multi(const cma_ledger_transfer_leg_t *legs, size_t n_legs) {
+    // 1: check legs and net the credits and debits of each balance (in order of first appearance)
+    std::vector<std::tuple<cma_map_key_t, cma_amount_t, cma_amount_t>> deltas; // key, credit, debit
+    std::unordered_map<cma_map_key_t, size_t, hash_balance_key> delta_index;
+    auto get_delta = [&](cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id) -> auto & {
+        auto [it, inserted] = delta_index.try_emplace(make_balance_key(asset_id, account_id), deltas.size());
+        if (inserted) {
+            deltas.emplace_back(it->first, cma_amount_t{}, cma_amount_t{});
+        }
+        return deltas[it->second];
+    };
+    for (size_t i = 0; i < n_legs; ++i) {
+        const cma_ledger_transfer_leg_t &leg = legs[i];
+        if (!find_asset(leg.asset_id, nullptr, nullptr, nullptr, nullptr)) {
+            throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+        }
+        if (leg.from_account_id == leg.to_account_id) {
+            throw CmaException("Account from equal to account to", -EINVAL);
+        }
+        if (!find_account(leg.from_account_id, nullptr, nullptr)) {
+            throw CmaException("Account from not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+        }
+        if (!find_account(leg.to_account_id, nullptr, nullptr)) {
+            throw CmaException("Account to not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+        }
+        auto &debit = std::get<2>(get_delta(leg.asset_id, leg.from_account_id));
+        if (!amount_checked_add(debit, debit, leg.amount)) {
+            throw CmaException("Insufficient funds", CMA_LEDGER_ERROR_INSUFFICIENT_FUNDS);
+        }
+        auto &credit = std::get<1>(get_delta(leg.asset_id, leg.to_account_id));
+        if (!amount_checked_add(credit, credit, leg.amount)) {
+            throw CmaException("Balance overflow", CMA_LEDGER_ERROR_BALANCE_OVERFLOW);
+        }
+    }
+
+    // 2: check final balances
+    std::vector<cma_ledger_balance_update_t> updates;
+    updates.reserve(deltas.size());
+    for (const auto &[key, credit, debit] : deltas) {
+        cma_amount_t curr_balance = {};
+        get_account_asset_balance(balance_key_asset_id(key), balance_key_account_id(key), &curr_balance, nullptr);
+
+        // a carry cancelled by a borrow still leaves a balance in range
+        cma_amount_t credited = {};
+        cma_amount_t new_balance = {};
+        const bool carry = !amount_checked_add(credited, curr_balance, credit);
+        const bool borrow = !amount_checked_sub(new_balance, credited, debit);
+        if (borrow && !carry) {
+            throw CmaException("Insufficient funds", CMA_LEDGER_ERROR_INSUFFICIENT_FUNDS);
+        }
+        if (carry && !borrow) {
+            throw CmaException("Balance overflow", CMA_LEDGER_ERROR_BALANCE_OVERFLOW);
+        }
+        if (amount_compare(new_balance, curr_balance) != 0) {
+            updates.emplace_back(key, new_balance);
+        }
+    }
+
+    // 3: update account balances, emptied balances first so their slots can be reused
+    std::ignore = std::stable_partition(updates.begin(), updates.end(),
+        [](const cma_ledger_balance_update_t &update) { return is_zero(update.second); });
+    set_account_asset_balances(updates);
+}
+
+void cma_ledger_base::set_flush_policy(cma_ledger_flush_policy_t policy) {
+    switch (policy) {
+        case CMA_LEDGER_FLUSH_PER_OP:
+        case CMA_LEDGER_FLUSH_PER_COMMIT:
+        case CMA_LEDGER_FLUSH_NONE:
+            flush_policy = policy;
+            break;
+        default:
+            throw CmaException("Invalid flush policy", -EINVAL);
+    }
+}
+
+void cma_ledger_base::checkpoint() {
+    if (transaction_open) {
+        throw CmaException("Can't checkpoint inside a transaction", CMA_LEDGER_ERROR_TRANSACTION);
+    }
+}
+
+void cma_ledger_base::presize() {
+    if (transaction_open) {
+        throw CmaException("Can't presize inside a transaction", CMA_LEDGER_ERROR_TRANSACTION);
+    }
+}
+
+void cma_ledger_base::set_hash_seed(const cma_hash_seed_t & /*seed*/) {
+    throw CmaException("Hash seed not supported by the ledger", -ENOTSUP);
+}
+
 void cma_ledger_basic::clear() {
     account_to_laccid.clear();
     laccid_to_account.clear();
@@ -137,10 +373,10 @@ void cma_ledger_basic::retrieve_asset(cma_ledger_asset_id_t *asset_id, cma_token
 
             // 2: create asset id map (but no reverse)
             if (operation == CMA_LEDGER_OP_CREATE || operation == CMA_LEDGER_OP_FIND_OR_CREATE) {
-                auto *new_asset = new cma_ledger_asset_struct_t();
-                new_asset->type = CMA_LEDGER_ASSET_TYPE_ID;
+                cma_ledger_asset_struct_t new_asset = {};
+                new_asset.type = CMA_LEDGER_ASSET_TYPE_ID;
                 const std::pair<lassid_to_asset_t::iterator, bool> insertion_result =
-                    lassid_to_asset.insert({curr_size, *new_asset});
+                    lassid_to_asset.insert({curr_size, new_asset});
                 if (!insertion_result.second) {
                     // Key already existed, value was not overwritten
                     // shouldn't be here
@@ -194,12 +430,12 @@ void cma_ledger_basic::retrieve_asset(cma_ledger_asset_id_t *asset_id, cma_token
                     throw CmaException("Asset Key already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
                 }
 
-                auto *new_asset = new cma_ledger_asset_struct_t();
-                new_asset->type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+                cma_ledger_asset_struct_t new_asset = {};
+                new_asset.type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
                 std::ignore = std::copy_n(std::begin(token_address->data), CMA_ABI_ADDRESS_LENGTH,
-                    std::begin(new_asset->token_address.data));
+                    std::begin(new_asset.token_address.data));
                 std::pair<lassid_to_asset_t::iterator, bool> insertion_result =
-                    lassid_to_asset.insert({curr_size, *new_asset});
+                    lassid_to_asset.insert({curr_size, new_asset});
                 if (!insertion_result.second) {
                     // shouldn't be here
                     throw CmaException("Asset ID already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
@@ -261,14 +497,14 @@ void cma_ledger_basic::retrieve_asset(cma_ledger_asset_id_t *asset_id, cma_token
                     throw CmaException("Asset Key already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
                 }
 
-                auto *new_asset = new cma_ledger_asset_struct_t();
-                new_asset->type = asset_type;
+                cma_ledger_asset_struct_t new_asset = {};
+                new_asset.type = asset_type;
                 std::ignore = std::copy_n(std::begin(token_address->data), CMA_ABI_ADDRESS_LENGTH,
-                    std::begin(new_asset->token_address.data));
+                    std::begin(new_asset.token_address.data));
                 std::ignore =
-                    std::copy_n(std::begin(token_id->data), CMA_ABI_ID_LENGTH, std::begin(new_asset->token_id.data));
+                    std::copy_n(std::begin(token_id->data), CMA_ABI_ID_LENGTH, std::begin(new_asset.token_id.data));
                 std::pair<lassid_to_asset_t::iterator, bool> insertion_result =
-                    lassid_to_asset.insert({curr_size, *new_asset});
+                    lassid_to_asset.insert({curr_size, new_asset});
                 if (!insertion_result.second) {
                     // shouldn't be here
                     throw CmaException("Asset ID already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
@@ -333,10 +569,10 @@ void cma_ledger_basic::retrieve_account(cma_ledger_account_id_t *account_id, cma
 
             // 2: create account id map (but no reverse)
             if (operation == CMA_LEDGER_OP_CREATE || operation == CMA_LEDGER_OP_FIND_OR_CREATE) {
-                auto *new_account = new cma_ledger_account_t();
-                new_account->type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+                cma_ledger_account_t new_account = {};
+                new_account.type = CMA_LEDGER_ACCOUNT_TYPE_ID;
                 std::pair<laccid_to_account_t::iterator, bool> insertion_result =
-                    laccid_to_account.insert({curr_size, *new_account});
+                    laccid_to_account.insert({curr_size, new_account});
                 if (!insertion_result.second) {
                     // shouldn't be here
                     throw CmaException("Account ID already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
@@ -441,7 +677,7 @@ void cma_ledger_basic::retrieve_account(cma_ledger_account_id_t *account_id, cma
 
 void cma_ledger_basic::get_account_asset_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
     cma_amount_t *balance, cma_ledger_account_balance_info_t *account_balance_info) {
-    auto find_result = account_asset_balance.find({asset_id, account_id});
+    auto find_result = account_asset_balance.find(make_balance_key(asset_id, account_id));
 
     if (account_balance_info != nullptr) {
         throw CmaException("Account balance not available", -CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
@@ -457,16 +693,83 @@ void cma_ledger_basic::get_account_asset_balance(cma_ledger_asset_id_t asset_id,
 
 void cma_ledger_basic::set_account_asset_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
     const cma_amount_t &balance) {
-    auto find_result = account_asset_balance.find({asset_id, account_id});
+    auto find_result = account_asset_balance.find(make_balance_key(asset_id, account_id));
     if (find_result == account_asset_balance.end()) {
         // create new entry
-        account_asset_balance.insert({{asset_id, account_id}, balance});
+        account_asset_balance.insert({make_balance_key(asset_id, account_id), balance});
         return;
     }
 
     std::ignore = std::copy_n(balance.data, CMA_ABI_U256_LENGTH, std::begin(find_result->second.data));
 }
 
+auto cma_ledger_basic::list_account_balances(cma_ledger_account_id_t account_id, cma_ledger_asset_balance_t *out,
+    size_t cap) -> size_t {
+    if (!laccid_to_account.contains(account_id)) {
+        throw CmaException("Account by id not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+    }
+    // no per account index here, the balances are scanned
+    size_t n_balances = 0;
+    for (const auto &[key, balance] : account_asset_balance) {
+        if (balance_key_account_id(key) != account_id || is_zero(balance)) {
+            continue;
+        }
+        if (n_balances < cap) {
+            out[n_balances] = {.asset_id = balance_key_asset_id(key), .amount = balance};
+        }
+        ++n_balances;
+    }
+    return n_balances;
+}
+
+auto cma_ledger_basic::get_owner(cma_ledger_asset_id_t asset_id) -> cma_ledger_account_id_t {
+    const auto find_result = lassid_to_asset.find(asset_id);
+    if (find_result == lassid_to_asset.end()) {
+        throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+    }
+    if (find_result->second.type != CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID) {
+        throw CmaException("Asset may have several owners", -EINVAL);
+    }
+    // no owner slot here, the balances are scanned
+    for (const auto &[key, balance] : account_asset_balance) {
+        if (balance_key_asset_id(key) == asset_id && !is_zero(balance)) {
+            return balance_key_account_id(key);
+        }
+    }
+    throw CmaException("Asset has no owner", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+}
+
+auto cma_ledger_basic::list_asset_holders(cma_ledger_asset_id_t asset_id,
+    const cma_ledger_account_id_t *after_account_id, cma_ledger_holder_balance_t *out, size_t cap) -> size_t {
+    if (!lassid_to_asset.contains(asset_id)) {
+        throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+    }
+    // no per asset index here, the balances are scanned (the map order is stable while the ledger is unchanged) and a
+    // page starts at the balance following the cursor one
+    auto position = account_asset_balance.begin();
+    if (after_account_id != nullptr) {
+        position = account_asset_balance.find(make_balance_key(asset_id, *after_account_id));
+        if (position == account_asset_balance.end() || is_zero(position->second)) {
+            throw CmaException("Cursor holder not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+        }
+        ++position;
+    }
+    size_t n_listed = 0;
+    for (; position != account_asset_balance.end() && n_listed < cap; ++position) {
+        if (balance_key_asset_id(position->first) == asset_id && !is_zero(position->second)) {
+            out[n_listed++] = {.account_id = balance_key_account_id(position->first), .amount = position->second};
+        }
+    }
+    // the count still needs the whole scan
+    size_t n_holders = 0;
+    for (const auto &[key, balance] : account_asset_balance) {
+        if (balance_key_asset_id(key) == asset_id && !is_zero(balance)) {
+            ++n_holders;
+        }
+    }
+    return n_holders;
+}
+
 void cma_ledger_basic::deposit(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t to_account_id,
     const cma_amount_t &deposit) {
     // 1: check asset
@@ -594,7 +897,27 @@ static constexpr size_t INIT_BALANCE = HINT_ASSETS_PER_ACCOUNT * INIT_ACCOUNTS_C
 // static constexpr size_t MAX_ASSETS = 256UL;             //< Maximum number of assets.
 // static constexpr size_t MAX_MEMORY_SIZE = 32UL * 1024 * 1024; //< Ledger state maximum memory usage.
 
+template <typename Table>
+static auto estimate_flat_table_size(size_t n_entries) -> size_t {
+    return sizeof(Table) + Table::max_memory_size(n_entries);
+}
+
+// Objects are looked up by name and type, so opening a ledger of another layout would build new empty tables next to
+// the existing ones. The version is checked before anything else is looked up.
+static auto open_layout_version(interprocess::managed_memory &memory) -> uint64_t & {
+    auto *version = memory.find<uint64_t>("layout_version").first;
+    if (version == nullptr || *version != CMA_LEDGER_LAYOUT_VERSION) {
+        throw CmaException("Incompatible ledger memory layout", -EINVAL);
+    }
+    return *version;
+}
+
 size_t cma_ledger_memory::estimate_required_size(size_t n_accounts, size_t n_assets, size_t n_balances) {
+    // balance back-indices are stored as uint32_t and ids are packed in 32-bit halves of the balance keys
+    if (n_balances > std::numeric_limits<uint32_t>::max() || n_accounts > std::numeric_limits<uint32_t>::max() ||
+        n_assets > std::numeric_limits<uint32_t>::max()) {
+        throw CmaException("Too many balances, accounts or assets", -EINVAL);
+    }
     // printf("estimate_required_size - n_accounts: %zu - n_assets: %zu - n_balances: %zu\n",
     //     n_accounts, n_assets, n_balances);
     // printf("  void_allocator: %zu\n", sizeof(interprocess::void_allocator));
@@ -620,103 +943,124 @@ size_t cma_ledger_memory::estimate_required_size(size_t n_accounts, size_t n_ass
     // sizeof(cma_map_key_t), n_balances*sizeof(cma_map_key_t));
 
     return (sizeof(interprocess::void_allocator) +
-               (sizeof(lassid_to_asset_t) +
-                   n_assets * (sizeof(cma_ledger_asset_id_t) + sizeof(cma_ledger_asset_struct_t))) +
-               (sizeof(asset_to_lassid_t) +
-                   n_assets * (sizeof(cma_ledger_asset_key_bytes_t) + sizeof(cma_ledger_asset_id_t))) +
-               (sizeof(laccid_to_account_t) +
-                   n_accounts * (sizeof(cma_ledger_account_id_t) + sizeof(cma_ledger_account_struct_t))) +
-               (sizeof(account_to_laccid_t) +
-                   n_accounts * (sizeof(cma_ledger_account_key_bytes_t) + sizeof(cma_ledger_account_id_t))) +
-               (sizeof(account_asset_map_t) +
-                   n_balances *
-                       (sizeof(cma_map_key_t) + sizeof(cma_balance_t) +
-                           sizeof(cma_ledger_account_balance_t) +        // sizeof(cma_ledger_account_virtual_balance_t)
-                           sizeof(cma_map_key_t) + sizeof(cma_map_key_t) // last keys lists
-                           )) +
-               3 * sizeof(cma_ledger_asset_id_t) + sizeof(bool)) *
+               (sizeof(asset_hot_table_t) + n_assets * sizeof(cma_ledger_asset_hot_t)) +
+               (sizeof(asset_cold_table_t) + n_assets * sizeof(cma_ledger_asset_cold_t)) +
+               estimate_flat_table_size<asset_to_lassid_t>(n_assets) +
+               (sizeof(account_hot_table_t) + n_accounts * sizeof(cma_ledger_account_hot_t)) +
+               (sizeof(account_cold_table_t) + n_accounts * sizeof(cma_ledger_account_t)) +
+               estimate_flat_table_size<account_to_laccid_t>(n_accounts) +
+               estimate_flat_table_size<account_asset_map_t>(n_balances) +
+               (sizeof(virtual_balance_pool_t) + n_balances * sizeof(cma_ledger_virtual_balance_slot_t)) +
+               (n_balances * (sizeof(cma_ledger_account_balance_t) + sizeof(cma_map_key_t) // last keys list
+                                 )) +
+               3 * sizeof(cma_ledger_asset_id_t) + sizeof(bool) + 5 * sizeof(size_t) + sizeof(cma_hash_seed_t) +
+               sizeof(uint64_t)) *
         5 / 4 // security factor
         + CMA_LEDGER_MIN_MEM_LENGTH;
 }
 
 cma_ledger_memory::cma_ledger_memory(interprocess::open_only_t mode, const char *memory_file_name, size_t offset,
-    size_t mem_length, size_t n_accounts, size_t n_assets, size_t n_balances) :
+    size_t mem_length, size_t n_accounts, size_t n_assets, size_t n_balances, size_t wal_len) :
     max_accounts(n_accounts),
     max_assets(n_assets),
     max_balances(n_balances),
     mem_offset(offset),
     m_file(memory_file_name, interprocess::read_write),
-    m_region(m_file, interprocess::read_write, mem_offset, mem_length),
+    wal_file(open_wal_file(memory_file_name, interprocess::get_file_handle(m_file), false, wal_len)),
+    m_region(m_file, wal_file.is_open() ? interprocess::copy_on_write : interprocess::read_write, mem_offset,
+        mem_length),
     balances{reinterpret_cast<cma_ledger_account_balance_t*>(m_region.get_address())},
     m_memory(mode, reinterpret_cast<char *>(m_region.get_address()) + max_balances * sizeof(cma_ledger_account_balance_t), m_region.get_size() - max_balances * sizeof(cma_ledger_account_balance_t)),
+    layout_version{open_layout_version(m_memory)},
     m_allocator(*m_memory.find_or_construct<interprocess::void_allocator>(interprocess::unique_instance)(
         m_memory.get_segment_manager())),
-    virtual_balances{*m_memory.find_or_construct<virtual_balance_list_t>(
-        interprocess::unique_instance)(0, m_memory.get_segment_manager())},
-    lassid_to_asset{*m_memory.find_or_construct<lassid_to_asset_t>(
-        interprocess::unique_instance)(INIT_ASSETS_CAPACITY, m_memory.get_segment_manager())},
+    hash_seed{*m_memory.find_or_construct<cma_hash_seed_t>("hash_seed")(cma_hash_seed_t{})},
+    virtual_balances{*m_memory.find_or_construct<virtual_balance_pool_t>(
+        interprocess::unique_instance)(max_balances, m_memory.get_segment_manager())},
+    asset_hot{*m_memory.find_or_construct<asset_hot_table_t>(
+        interprocess::unique_instance)(max_assets, m_memory.get_segment_manager())},
+    asset_cold{*m_memory.find_or_construct<asset_cold_table_t>(
+        interprocess::unique_instance)(max_assets, m_memory.get_segment_manager())},
     asset_to_lassid{*m_memory.find_or_construct<asset_to_lassid_t>(
-        interprocess::unique_instance)(INIT_ASSETS_CAPACITY, m_memory.get_segment_manager())},
-    laccid_to_account{*m_memory.find_or_construct<laccid_to_account_t>(
-        interprocess::unique_instance)(INIT_ACCOUNTS_CAPACITY, m_memory.get_segment_manager())},
+        interprocess::unique_instance)(std::min(INIT_ASSETS_CAPACITY, max_assets), asset_key_hash_t{hash_seed},
+        m_memory.get_segment_manager())},
+    account_hot{*m_memory.find_or_construct<account_hot_table_t>(
+        interprocess::unique_instance)(max_accounts, m_memory.get_segment_manager())},
+    account_cold{*m_memory.find_or_construct<account_cold_table_t>(
+        interprocess::unique_instance)(max_accounts, m_memory.get_segment_manager())},
     account_to_laccid{*m_memory.find_or_construct<account_to_laccid_t>(
-        interprocess::unique_instance)(INIT_ACCOUNTS_CAPACITY, m_memory.get_segment_manager())},
+        interprocess::unique_instance)(std::min(INIT_ACCOUNTS_CAPACITY, max_accounts), account_key_hash_t{hash_seed},
+        m_memory.get_segment_manager())},
     account_asset_balance{*m_memory.find_or_construct<account_asset_map_t>(
-        interprocess::unique_instance)(INIT_BALANCE, m_memory.get_segment_manager())},
+        interprocess::unique_instance)(std::min(INIT_BALANCE, max_balances), m_memory.get_segment_manager())},
     last_balances{*m_memory.find_or_construct<balance_key_list_t>("last_balances")(0, m_memory.get_segment_manager())},
-    last_virtual_balances{
-        *m_memory.find_or_construct<balance_key_list_t>("last_virtual_balances")(0, m_memory.get_segment_manager())},
     next_asset_id{*m_memory.find_or_construct<cma_ledger_asset_id_t>("next_asset_id")(0)},
     next_account_id{*m_memory.find_or_construct<cma_ledger_account_id_t>("next_account_id")(0)},
+    asset_count{*m_memory.find_or_construct<size_t>("asset_count")(0)},
+    account_count{*m_memory.find_or_construct<size_t>("account_count")(0)},
+    virtual_free_head{*m_memory.find_or_construct<size_t>("virtual_free_head")(VIRTUAL_BALANCE_NONE)},
+    virtual_pool_top{*m_memory.find_or_construct<size_t>("virtual_pool_top")(0)},
     base_asset_id{*m_memory.find_or_construct<cma_ledger_asset_id_t>("base_asset_id")(0)},
-    base_asset_id_defined{*m_memory.find_or_construct<bool>("base_asset_id_defined")(false)} {
+    base_asset_id_defined{*m_memory.find_or_construct<bool>("base_asset_id_defined")(false)},
+    wal_length{*m_memory.find_or_construct<size_t>("wal_length")(0)} {
     size_t required_size = cma_ledger_memory::estimate_required_size(max_accounts, max_assets, max_balances);
     if (required_size > m_region.get_size()) {
         throw CmaException("Mem length too small", -ENOBUFS);
     }
-    virtual_balances.reserve(INIT_BALANCE);
     last_balances.reserve(INIT_BALANCE);
-    last_virtual_balances.reserve(INIT_BALANCE);
+    open_wal(false, wal_len);
 }
 
 cma_ledger_memory::cma_ledger_memory(interprocess::create_only_t mode, const char *memory_file_name, size_t offset,
-    size_t mem_length, size_t n_accounts, size_t n_assets, size_t n_balances) :
+    size_t mem_length, size_t n_accounts, size_t n_assets, size_t n_balances, size_t wal_len) :
     max_accounts(n_accounts),
     max_assets(n_assets),
     max_balances(n_balances),
     mem_offset(offset),
     m_file(memory_file_name, interprocess::read_write),
-    m_region(m_file, interprocess::read_write, mem_offset, mem_length),
+    wal_file(open_wal_file(memory_file_name, interprocess::get_file_handle(m_file), true, wal_len)),
+    m_region(m_file, wal_file.is_open() ? interprocess::copy_on_write : interprocess::read_write, mem_offset,
+        mem_length),
     balances{reinterpret_cast<cma_ledger_account_balance_t*>(m_region.get_address())},
     m_memory(mode, reinterpret_cast<char *>(m_region.get_address()) + max_balances * sizeof(cma_ledger_account_balance_t), m_region.get_size() - max_balances * sizeof(cma_ledger_account_balance_t)),
+    layout_version{*m_memory.find_or_construct<uint64_t>("layout_version")(CMA_LEDGER_LAYOUT_VERSION)},
     m_allocator(*m_memory.find_or_construct<interprocess::void_allocator>(interprocess::unique_instance)(
         m_memory.get_segment_manager())),
-    virtual_balances{*m_memory.find_or_construct<virtual_balance_list_t>(
-        interprocess::unique_instance)(0, m_memory.get_segment_manager())},
-    lassid_to_asset{*m_memory.find_or_construct<lassid_to_asset_t>(
-        interprocess::unique_instance)(INIT_ASSETS_CAPACITY, m_memory.get_segment_manager())},
+    hash_seed{*m_memory.find_or_construct<cma_hash_seed_t>("hash_seed")(cma_hash_seed_t{})},
+    virtual_balances{*m_memory.find_or_construct<virtual_balance_pool_t>(
+        interprocess::unique_instance)(max_balances, m_memory.get_segment_manager())},
+    asset_hot{*m_memory.find_or_construct<asset_hot_table_t>(
+        interprocess::unique_instance)(max_assets, m_memory.get_segment_manager())},
+    asset_cold{*m_memory.find_or_construct<asset_cold_table_t>(
+        interprocess::unique_instance)(max_assets, m_memory.get_segment_manager())},
     asset_to_lassid{*m_memory.find_or_construct<asset_to_lassid_t>(
-        interprocess::unique_instance)(INIT_ASSETS_CAPACITY, m_memory.get_segment_manager())},
-    laccid_to_account{*m_memory.find_or_construct<laccid_to_account_t>(
-        interprocess::unique_instance)(INIT_ACCOUNTS_CAPACITY, m_memory.get_segment_manager())},
+        interprocess::unique_instance)(std::min(INIT_ASSETS_CAPACITY, max_assets), asset_key_hash_t{hash_seed},
+        m_memory.get_segment_manager())},
+    account_hot{*m_memory.find_or_construct<account_hot_table_t>(
+        interprocess::unique_instance)(max_accounts, m_memory.get_segment_manager())},
+    account_cold{*m_memory.find_or_construct<account_cold_table_t>(
+        interprocess::unique_instance)(max_accounts, m_memory.get_segment_manager())},
     account_to_laccid{*m_memory.find_or_construct<account_to_laccid_t>(
-        interprocess::unique_instance)(INIT_ACCOUNTS_CAPACITY, m_memory.get_segment_manager())},
+        interprocess::unique_instance)(std::min(INIT_ACCOUNTS_CAPACITY, max_accounts), account_key_hash_t{hash_seed},
+        m_memory.get_segment_manager())},
     account_asset_balance{*m_memory.find_or_construct<account_asset_map_t>(
-        interprocess::unique_instance)(INIT_BALANCE, m_memory.get_segment_manager())},
+        interprocess::unique_instance)(std::min(INIT_BALANCE, max_balances), m_memory.get_segment_manager())},
     last_balances{*m_memory.find_or_construct<balance_key_list_t>("last_balances")(0, m_memory.get_segment_manager())},
-    last_virtual_balances{
-        *m_memory.find_or_construct<balance_key_list_t>("last_virtual_balances")(0, m_memory.get_segment_manager())},
     next_asset_id{*m_memory.find_or_construct<cma_ledger_asset_id_t>("next_asset_id")(0)},
     next_account_id{*m_memory.find_or_construct<cma_ledger_account_id_t>("next_account_id")(0)},
+    asset_count{*m_memory.find_or_construct<size_t>("asset_count")(0)},
+    account_count{*m_memory.find_or_construct<size_t>("account_count")(0)},
+    virtual_free_head{*m_memory.find_or_construct<size_t>("virtual_free_head")(VIRTUAL_BALANCE_NONE)},
+    virtual_pool_top{*m_memory.find_or_construct<size_t>("virtual_pool_top")(0)},
     base_asset_id{*m_memory.find_or_construct<cma_ledger_asset_id_t>("base_asset_id")(0)},
-    base_asset_id_defined{*m_memory.find_or_construct<bool>("base_asset_id_defined")(false)} {
+    base_asset_id_defined{*m_memory.find_or_construct<bool>("base_asset_id_defined")(false)},
+    wal_length{*m_memory.find_or_construct<size_t>("wal_length")(0)} {
     size_t required_size = cma_ledger_memory::estimate_required_size(max_accounts, max_assets, max_balances);
     if (required_size > m_region.get_size()) {
         throw CmaException("Mem length too small", -ENOBUFS);
     }
-    virtual_balances.reserve(INIT_BALANCE);
     last_balances.reserve(INIT_BALANCE);
-    last_virtual_balances.reserve(INIT_BALANCE);
+    open_wal(true, wal_len);
 }
 
 cma_ledger_memory::cma_ledger_memory(void *mem_ptr, size_t mem_length, size_t n_accounts, size_t n_assets,
@@ -726,176 +1070,1044 @@ cma_ledger_memory::cma_ledger_memory(void *mem_ptr, size_t mem_length, size_t n_
     max_balances(n_balances),
     mem_offset(0),
     m_file(),
+    wal_file(),
     m_region(),
     balances{reinterpret_cast<cma_ledger_account_balance_t*>(mem_ptr)},
     m_memory(interprocess::create_only, reinterpret_cast<char *>(mem_ptr) + max_balances * sizeof(cma_ledger_account_balance_t), mem_length - max_balances * sizeof(cma_ledger_account_balance_t)),
+    layout_version{*m_memory.find_or_construct<uint64_t>("layout_version")(CMA_LEDGER_LAYOUT_VERSION)},
     m_allocator(*m_memory.find_or_construct<interprocess::void_allocator>(interprocess::unique_instance)(
         m_memory.get_segment_manager())),
-    virtual_balances{*m_memory.find_or_construct<virtual_balance_list_t>(
-        interprocess::unique_instance)(0, m_memory.get_segment_manager())},
-    lassid_to_asset{*m_memory.find_or_construct<lassid_to_asset_t>(
-        interprocess::unique_instance)(INIT_ASSETS_CAPACITY, m_memory.get_segment_manager())},
+    hash_seed{*m_memory.find_or_construct<cma_hash_seed_t>("hash_seed")(cma_hash_seed_t{})},
+    virtual_balances{*m_memory.find_or_construct<virtual_balance_pool_t>(
+        interprocess::unique_instance)(max_balances, m_memory.get_segment_manager())},
+    asset_hot{*m_memory.find_or_construct<asset_hot_table_t>(
+        interprocess::unique_instance)(max_assets, m_memory.get_segment_manager())},
+    asset_cold{*m_memory.find_or_construct<asset_cold_table_t>(
+        interprocess::unique_instance)(max_assets, m_memory.get_segment_manager())},
     asset_to_lassid{*m_memory.find_or_construct<asset_to_lassid_t>(
-        interprocess::unique_instance)(INIT_ASSETS_CAPACITY, m_memory.get_segment_manager())},
-    laccid_to_account{*m_memory.find_or_construct<laccid_to_account_t>(
-        interprocess::unique_instance)(INIT_ACCOUNTS_CAPACITY, m_memory.get_segment_manager())},
+        interprocess::unique_instance)(std::min(INIT_ASSETS_CAPACITY, max_assets), asset_key_hash_t{hash_seed},
+        m_memory.get_segment_manager())},
+    account_hot{*m_memory.find_or_construct<account_hot_table_t>(
+        interprocess::unique_instance)(max_accounts, m_memory.get_segment_manager())},
+    account_cold{*m_memory.find_or_construct<account_cold_table_t>(
+        interprocess::unique_instance)(max_accounts, m_memory.get_segment_manager())},
     account_to_laccid{*m_memory.find_or_construct<account_to_laccid_t>(
-        interprocess::unique_instance)(INIT_ACCOUNTS_CAPACITY, m_memory.get_segment_manager())},
+        interprocess::unique_instance)(std::min(INIT_ACCOUNTS_CAPACITY, max_accounts), account_key_hash_t{hash_seed},
+        m_memory.get_segment_manager())},
     account_asset_balance{*m_memory.find_or_construct<account_asset_map_t>(
-        interprocess::unique_instance)(INIT_BALANCE, m_memory.get_segment_manager())},
+        interprocess::unique_instance)(std::min(INIT_BALANCE, max_balances), m_memory.get_segment_manager())},
     last_balances{*m_memory.find_or_construct<balance_key_list_t>("last_balances")(0, m_memory.get_segment_manager())},
-    last_virtual_balances{
-        *m_memory.find_or_construct<balance_key_list_t>("last_virtual_balances")(0, m_memory.get_segment_manager())},
     next_asset_id{*m_memory.find_or_construct<cma_ledger_asset_id_t>("next_asset_id")(0)},
     next_account_id{*m_memory.find_or_construct<cma_ledger_account_id_t>("next_account_id")(0)},
+    asset_count{*m_memory.find_or_construct<size_t>("asset_count")(0)},
+    account_count{*m_memory.find_or_construct<size_t>("account_count")(0)},
+    virtual_free_head{*m_memory.find_or_construct<size_t>("virtual_free_head")(VIRTUAL_BALANCE_NONE)},
+    virtual_pool_top{*m_memory.find_or_construct<size_t>("virtual_pool_top")(0)},
     base_asset_id{*m_memory.find_or_construct<cma_ledger_asset_id_t>("base_asset_id")(0)},
-    base_asset_id_defined{*m_memory.find_or_construct<bool>("base_asset_id_defined")(false)} {
+    base_asset_id_defined{*m_memory.find_or_construct<bool>("base_asset_id_defined")(false)},
+    wal_length{*m_memory.find_or_construct<size_t>("wal_length")(0)} {
     size_t required_size = cma_ledger_memory::estimate_required_size(max_accounts, max_assets, max_balances);
     if (required_size > mem_length) {
         throw CmaException("Mem length too small", -ENOBUFS);
     }
-    virtual_balances.reserve(INIT_BALANCE);
     last_balances.reserve(INIT_BALANCE);
-    last_virtual_balances.reserve(INIT_BALANCE);
 }
 
-void cma_ledger_memory::clear() {
-    for (size_t i = 0; i < last_balances.size(); ++i) {
-        std::ignore = std::fill_n(reinterpret_cast<uint8_t *>(&balances[i]),
-            sizeof(cma_ledger_account_balance_t), (uint8_t) 0);
+void cma_ledger_memory::add_dirty_range(size_t begin, size_t end) {
+    // coalesce with overlapping or adjacent ranges
+    for (size_t i = 0; i < n_dirty_ranges;) {
+        const dirty_range_t &range = dirty_ranges[i];
+        if (begin <= range.second && range.first <= end) {
+            begin = std::min(begin, range.first);
+            end = std::max(end, range.second);
+            dirty_ranges[i] = dirty_ranges[--n_dirty_ranges];
+            i = 0;
+            continue;
+        }
+        ++i;
     }
-    virtual_balances.clear();
-    last_balances.clear();
-    last_virtual_balances.clear();
-    account_to_laccid.clear();
-    laccid_to_account.clear();
-    asset_to_lassid.clear();
-    lassid_to_asset.clear();
-    account_asset_balance.clear();
-    if (m_region.get_address() != nullptr) {
-        m_region.flush();
+    if (n_dirty_ranges == MAX_DIRTY_RANGES) {
+        // too many scattered ranges, collapse them into a single one
+        for (size_t i = 0; i < n_dirty_ranges; ++i) {
+            begin = std::min(begin, dirty_ranges[i].first);
+            end = std::max(end, dirty_ranges[i].second);
+        }
+        n_dirty_ranges = 0;
     }
+    dirty_ranges[n_dirty_ranges++] = {begin, end};
 }
 
-auto cma_ledger_memory::get_asset_count() -> size_t {
-    return lassid_to_asset.size();
+void cma_ledger_memory::mark_dirty(const void *ptr, size_t length) {
+    // checkpoints need the changes tracked under no flush as well
+    if (m_region.get_address() == nullptr || (flush_policy == CMA_LEDGER_FLUSH_NONE && wal_length == 0) ||
+        length == 0) {
+        return;
+    }
+    const auto *region_begin = static_cast<const uint8_t *>(m_region.get_address());
+    const auto *dirty_begin = static_cast<const uint8_t *>(ptr);
+    if (dirty_begin < region_begin || dirty_begin + length > region_begin + m_region.get_size()) {
+        return;
+    }
+    // offsets are relative to the page aligned start of the mapping
+    const size_t page_size = interprocess::mapped_region::get_page_size();
+    const size_t offset = static_cast<size_t>(dirty_begin - region_begin) + mem_offset % page_size;
+    add_dirty_range(offset / page_size * page_size, (offset + length + page_size - 1) / page_size * page_size);
 }
 
-auto cma_ledger_memory::find_asset(cma_ledger_asset_id_t asset_id, cma_ledger_asset_type_t *asset_type,
-    cma_token_address_t *token_address, cma_token_id_t *token_id, cma_amount_t *supply) -> bool {
-    const auto find_result = lassid_to_asset.find(asset_id);
-    if (find_result == lassid_to_asset.end()) {
+void cma_ledger_memory::mark_counters_dirty() {
+    mark_dirty(&next_asset_id, sizeof(next_asset_id));
+    mark_dirty(&next_account_id, sizeof(next_account_id));
+    mark_dirty(&asset_count, sizeof(asset_count));
+    mark_dirty(&account_count, sizeof(account_count));
+    mark_dirty(&virtual_free_head, sizeof(virtual_free_head));
+    mark_dirty(&virtual_pool_top, sizeof(virtual_pool_top));
+    mark_dirty(&base_asset_id, sizeof(base_asset_id));
+    mark_dirty(&base_asset_id_defined, sizeof(base_asset_id_defined));
+}
+
+void cma_ledger_memory::mark_segment_dirty() {
+    // rehashing or reallocating (with the allocator metadata) can touch anything in the segment
+    const size_t balances_size = max_balances * sizeof(cma_ledger_account_balance_t);
+    mark_dirty(&balances[max_balances], m_region.get_size() - balances_size);
+}
+
+template <typename Table, typename... Args>
+auto cma_ledger_memory::emplace_entry(Table &table, const typename Table::key_type &key, Args &&...args)
+    -> std::pair<typename Table::iterator, bool> {
+    const bool rehashes = table.growth_left() == 0;
+    auto result = table.try_emplace(key, std::forward<Args>(args)...);
+    if (!result.second) {
+        return result;
+    }
+    if (rehashes) {
+        mark_segment_dirty();
+    } else {
+        mark_dirty(&table, sizeof(Table));
+        mark_dirty(&*result.first, sizeof(typename Table::value_type));
+        mark_dirty(table.ctrl_of(result.first), sizeof(uint64_t));
+    }
+    return result;
+}
+
+template <typename Table>
+void cma_ledger_memory::erase_entry(Table &table, typename Table::iterator position) {
+    // erasing never rehashes nor writes the slot
+    mark_dirty(&table, sizeof(Table));
+    mark_dirty(table.ctrl_of(position), sizeof(uint64_t));
+    table.erase(position);
+}
+
+template <typename Table>
+auto cma_ledger_memory::erase_entry(Table &table, const typename Table::key_type &key) -> bool {
+    auto position = table.find(key);
+    if (position == table.end()) {
         return false;
     }
+    erase_entry(table, position);
+    return true;
+}
 
-    if (asset_type != nullptr) {
-        *asset_type = find_result->second.type;
+void cma_ledger_memory::push_last_balance(cma_map_key_t balance_key) {
+    const bool reallocates = last_balances.size() == last_balances.capacity();
+    last_balances.push_back(balance_key);
+    if (reallocates) {
+        mark_segment_dirty();
+    } else {
+        mark_dirty(&last_balances, sizeof(last_balances));
+        mark_dirty(&last_balances.back(), sizeof(cma_map_key_t));
     }
+}
 
-    // asset found
-    switch (find_result->second.type) {
-        case CMA_LEDGER_ASSET_TYPE_ID:
-        case CMA_LEDGER_ASSET_TYPE_BASE:
-            break;
-        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS:
-            if (token_address != nullptr) {
-                std::ignore = std::copy_n(std::begin(find_result->second.token_address.data), CMA_ABI_ADDRESS_LENGTH,
-                    std::begin(token_address->data));
-            }
-            break;
-        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID:
-        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID_AMOUNT:
-            if (token_address != nullptr) {
-                std::ignore = std::copy_n(std::begin(find_result->second.token_address.data), CMA_ABI_ADDRESS_LENGTH,
-                    std::begin(token_address->data));
-            }
-            if (token_id != nullptr) {
-                std::ignore = std::copy_n(std::begin(find_result->second.token_id.data), CMA_ABI_ID_LENGTH,
-                    std::begin(token_id->data));
-            }
-            break;
-        default:
-            // shouldn't be here (wrongly added to map)
-            throw CmaException("Invalid asset type", -EINVAL);
+void cma_ledger_memory::sync_dirty_ranges() {
+    if (m_region.get_address() == nullptr) {
+        return;
     }
-    if (supply != nullptr) {
-        std::ignore =
-            std::copy_n(std::begin(find_result->second.supply.data), CMA_ABI_U256_LENGTH, std::begin(supply->data));
+    const size_t page_size = interprocess::mapped_region::get_page_size();
+    const size_t page_offset = mem_offset % page_size;
+    // mapped_region rejects offsets past its size, which the last page of an unaligned mapping starts at, so a
+    // range starting there is flushed from the page before
+    const size_t last_begin = (m_region.get_size() - 1) / page_size * page_size;
+    for (size_t i = 0; i < n_dirty_ranges; ++i) {
+        const size_t begin = std::min(dirty_ranges[i].first, last_begin);
+        const size_t end = std::min(dirty_ranges[i].second, m_region.get_size() + page_offset);
+        // mapped_region adds the page offset back to the number of bytes
+        if (!m_region.flush(begin, end - begin - page_offset)) {
+            throw CmaException("Unable to flush the ledger memory", -EIO);
+        }
     }
-    return true;
+    n_dirty_ranges = 0;
 }
 
-auto cma_ledger_memory::remove_asset(cma_ledger_asset_id_t asset_id) -> void {
-    const auto find_result = lassid_to_asset.find(asset_id);
-    if (find_result == lassid_to_asset.end()) {
-        throw CmaException("Couldn't find asset to remove", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+void cma_ledger_memory::flush() {
+    // inside a transaction the flush is postponed to commit
+    // with a write-ahead log the ledger file is only written by checkpoints
+    if (transaction_open || flush_policy != CMA_LEDGER_FLUSH_PER_OP || wal_length != 0) {
+        return;
     }
-    if (!is_zero(find_result->second.supply)) {
-        throw CmaException("Asset still have supply", CMA_LEDGER_ERROR_ASSET_SUPPLY);
+    sync_dirty_ranges();
+}
+
+void cma_ledger_memory::begin() {
+    // records of a transaction can't be checkpointed before it commits, it starts with at least half of the log free
+    if (wal_length != 0 && !transaction_open && wal_tail > get_wal_capacity() / 2) {
+        write_checkpoint();
     }
-    switch (find_result->second.type) {
-        case CMA_LEDGER_ASSET_TYPE_ID: {
-            break;
+    cma_ledger_base::begin();
+    undo_journal.clear();
+    begin_savepoint = savepoint();
+}
+
+void cma_ledger_memory::commit() {
+    if (!transaction_open) {
+        throw CmaException("No open transaction", CMA_LEDGER_ERROR_TRANSACTION);
+    }
+    // the transaction stays open until it is durable, so a failed flush can still be rolled back
+    if (wal_length != 0) {
+        end_wal_group(flush_policy != CMA_LEDGER_FLUSH_NONE);
+    } else if (flush_policy != CMA_LEDGER_FLUSH_NONE) {
+        sync_dirty_ranges();
+    }
+    cma_ledger_base::commit();
+    undo_journal.clear();
+}
+
+void cma_ledger_memory::abort() {
+    rollback();
+}
+
+void cma_ledger_memory::rollback() {
+    rollback_to(begin_savepoint);
+    transaction_open = false;
+    flush();
+}
+
+auto cma_ledger_memory::savepoint() -> cma_ledger_savepoint_t {
+    if (!transaction_open) {
+        throw CmaException("No open transaction", CMA_LEDGER_ERROR_TRANSACTION);
+    }
+    return {.journal_size = undo_journal.size(),
+        .wal_tail = wal_tail,
+        .wal_pending = wal_pending};
+}
+
+void cma_ledger_memory::rollback_to(const cma_ledger_savepoint_t &savepoint) {
+    if (!transaction_open) {
+        throw CmaException("No open transaction", CMA_LEDGER_ERROR_TRANSACTION);
+    }
+    // undo in reverse order, so creations are undone after the balances and supplies that reference them
+    rolling_back = true;
+    try {
+        while (undo_journal.size() > savepoint.journal_size) {
+            const cma_ledger_undo_entry_t &entry = undo_journal.back();
+            switch (entry.type) {
+                case CMA_LEDGER_UNDO_BALANCE: {
+                    restore_balance(entry.asset_id, entry.account_id, entry.amount);
+                    break;
+                }
+                case CMA_LEDGER_UNDO_SUPPLY: {
+                    cma_amount_t supply = entry.amount;
+                    set_asset_supply(entry.asset_id, supply);
+                    break;
+                }
+                case CMA_LEDGER_UNDO_ASSET_CREATED: {
+                    remove_asset(entry.asset_id);
+                    next_asset_id = entry.asset_id;
+                    break;
+                }
+                case CMA_LEDGER_UNDO_ASSET_REMOVED: {
+                    restore_asset(entry.asset_id, entry.asset);
+                    break;
+                }
+                case CMA_LEDGER_UNDO_ACCOUNT_CREATED: {
+                    remove_account(entry.account_id);
+                    next_account_id = entry.account_id;
+                    break;
+                }
+                case CMA_LEDGER_UNDO_ACCOUNT_REMOVED: {
+                    restore_account(entry.account_id, entry.account);
+                    break;
+                }
+                default:
+                    throw CmaException("Invalid undo entry", -EINVAL);
+            }
+            undo_journal.pop_back();
         }
-        case CMA_LEDGER_ASSET_TYPE_BASE: {
-            base_asset_id_defined = false;
+    } catch (...) {
+        rolling_back = false;
+        throw;
+    }
+    rolling_back = false;
+
+    if (wal_length != 0) {
+        // records of the undone changes are overwritten, they are never followed by a commit record (checkpoints
+        // don't run while records are pending, so the savepoint is still in the current generation)
+        wal_tail = savepoint.wal_tail;
+        wal_pending = savepoint.wal_pending;
+    }
+}
+
+auto cma_ledger_memory::journaling() const -> bool {
+    return transaction_open && !rolling_back;
+}
+
+void cma_ledger_memory::restore_asset(cma_ledger_asset_id_t asset_id, const cma_ledger_asset_struct_t &asset) {
+    switch (asset.type) {
+        case CMA_LEDGER_ASSET_TYPE_ID:
             break;
-        }
-        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS: {
-            cma_ledger_asset_key_bytes_t asset_key = {0};
-            std::span<uint8_t> asset_key_bytes_span(asset_key);
-            std::span<uint8_t> asset_key_bytes_addr_span =
-                asset_key_bytes_span.subspan(CMA_LEDGER_ASSET_ARRAY_KEY_ADDRESS_IND, CMA_ABI_ADDRESS_LENGTH);
-            asset_key[CMA_LEDGER_ASSET_ARRAY_KEY_TYPE_IND] = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
-            std::ignore = std::copy_n(std::begin(find_result->second.token_address.data), CMA_ABI_ADDRESS_LENGTH,
-                asset_key_bytes_addr_span.begin());
-            if (asset_to_lassid.erase(asset_key) == 0) {
-                throw CmaException("Coundn't erase asset key map", CMA_LEDGER_ERROR_REMOVE);
-            }
+        case CMA_LEDGER_ASSET_TYPE_BASE: {
+            base_asset_id = asset_id;
+            base_asset_id_defined = true;
             break;
         }
+        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS:
         case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID:
         case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID_AMOUNT: {
-            cma_ledger_asset_key_bytes_t asset_key = {0};
+            cma_ledger_asset_key_bytes_t asset_key = {};
             std::span<uint8_t> asset_key_bytes_span(asset_key);
             std::span<uint8_t> asset_key_bytes_addr_span =
                 asset_key_bytes_span.subspan(CMA_LEDGER_ASSET_ARRAY_KEY_ADDRESS_IND, CMA_ABI_ADDRESS_LENGTH);
-            std::span<uint8_t> asset_key_bytes_id_span =
-                asset_key_bytes_span.subspan(CMA_LEDGER_ASSET_ARRAY_KEY_ID_IND, CMA_ABI_ID_LENGTH);
-            asset_key[CMA_LEDGER_ASSET_ARRAY_KEY_TYPE_IND] = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID;
-            std::ignore = std::copy_n(std::begin(find_result->second.token_address.data), CMA_ABI_ADDRESS_LENGTH,
+            std::ignore = std::copy_n(std::begin(asset.token_address.data), CMA_ABI_ADDRESS_LENGTH,
                 asset_key_bytes_addr_span.begin());
-            std::ignore = std::copy_n(std::begin(find_result->second.token_id.data), CMA_ABI_ID_LENGTH,
-                asset_key_bytes_id_span.begin());
-            if (asset_to_lassid.erase(asset_key) == 0) {
-                throw CmaException("Coundn't erase asset key map", CMA_LEDGER_ERROR_REMOVE);
+            if (asset.type == CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS) {
+                asset_key[CMA_LEDGER_ASSET_ARRAY_KEY_TYPE_IND] = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+            } else {
+                std::span<uint8_t> asset_key_bytes_id_span =
+                    asset_key_bytes_span.subspan(CMA_LEDGER_ASSET_ARRAY_KEY_ID_IND, CMA_ABI_ID_LENGTH);
+                asset_key[CMA_LEDGER_ASSET_ARRAY_KEY_TYPE_IND] = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID;
+                std::ignore = std::copy_n(std::begin(asset.token_id.data), CMA_ABI_ID_LENGTH,
+                    asset_key_bytes_id_span.begin());
+            }
+            if (!emplace_entry(asset_to_lassid, asset_key, asset_id).second) {
+                throw CmaException("Asset Key already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
             }
             break;
         }
-        default: {
-            // shouldn't be here (wrongly added to map)
+        default:
             throw CmaException("Invalid asset type", -EINVAL);
-        }
     }
-
-    if (lassid_to_asset.erase(asset_id) == 0) {
-        throw CmaException("Coundn't erase asset id map", CMA_LEDGER_ERROR_REMOVE);
+    if (asset_id >= asset_hot.size() || asset_hot[asset_id].live) {
+        throw CmaException("Asset ID already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
     }
+    write_asset_record(asset_id, asset);
+    ++asset_count;
+    mark_counters_dirty();
 }
 
-void cma_ledger_memory::set_asset_supply(cma_ledger_asset_id_t asset_id, cma_amount_t &supply) {
-    auto find_result = lassid_to_asset.find(asset_id);
-    if (find_result == lassid_to_asset.end()) {
+void cma_ledger_memory::restore_account(cma_ledger_account_id_t account_id,
+    const cma_ledger_account_struct_t &account) {
+    if (account.account.type != CMA_LEDGER_ACCOUNT_TYPE_ID) {
+        cma_ledger_account_key_bytes_t account_key;
+        std::ignore =
+            std::copy_n(std::begin(account.account.account_id.data), CMA_ABI_ID_LENGTH, account_key.begin());
+        if (!emplace_entry(account_to_laccid, account_key, account_id).second) {
+            throw CmaException("Account Key already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
+        }
+    }
+    if (account_id >= account_hot.size() || account_hot[account_id].live) {
+        throw CmaException("Account ID already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
+    }
+    write_account_record(account_id, account);
+    ++account_count;
+    mark_counters_dirty();
+}
+
+void cma_ledger_memory::presize() {
+    cma_ledger_base::presize();
+    // the id tables and the virtual balance pool are already sized to the maximums
+    asset_to_lassid.reserve(max_assets);
+    account_to_laccid.reserve(max_accounts);
+    account_asset_balance.reserve(max_balances);
+    last_balances.reserve(max_balances);
+    mark_segment_dirty();
+    checkpoint_unlogged();
+}
+
+void cma_ledger_memory::set_hash_seed(const cma_hash_seed_t &seed) {
+    if (transaction_open) {
+        throw CmaException("Can't set the hash seed inside a transaction", CMA_LEDGER_ERROR_TRANSACTION);
+    }
+    // hashes already in the key tables would no longer be found
+    if (!asset_to_lassid.empty() || !account_to_laccid.empty()) {
+        throw CmaException("Hash seed set after keys were hashed", -EBUSY);
+    }
+    hash_seed = seed;
+    asset_to_lassid.reset_hash_function(asset_key_hash_t{hash_seed});
+    account_to_laccid.reset_hash_function(account_key_hash_t{hash_seed});
+    mark_segment_dirty();
+    checkpoint_unlogged();
+}
+
+void cma_ledger_memory::set_flush_policy(cma_ledger_flush_policy_t policy) {
+    const cma_ledger_flush_policy_t previous_policy = flush_policy;
+    cma_ledger_base::set_flush_policy(policy);
+    if (wal_length != 0) {
+        // the policy only decides when the log is synced, the changes are tracked for the checkpoints
+        return;
+    }
+    if (flush_policy == CMA_LEDGER_FLUSH_NONE) {
+        // nothing will be synced, stop tracking
+        n_dirty_ranges = 0;
+        } else if (previous_policy == CMA_LEDGER_FLUSH_NONE && m_region.get_address() != nullptr) {
+        // changes made under no flush weren't tracked, the next flush writes the whole ledger memory
+        mark_dirty(m_region.get_address(), m_region.get_size());
+    }
+}
+
+/*
+ * Write-ahead log
+ */
+
+static constexpr size_t WAL_HEADER_SIZE = 64; //< Bytes reserved for the write-ahead log header.
+static constexpr uint64_t WAL_FNV_OFFSET = 0xcbf29ce484222325;
+static constexpr uint64_t WAL_FNV_PRIME = 0x100000001b3;
+static constexpr size_t WAL_COPY_CHUNK = 1024UL * 1024; //< Bytes copied at once when finishing a checkpoint.
+static constexpr const char *WAL_FILE_SUFFIX = "-wal";
+
+cma_ledger_wal_file::~cma_ledger_wal_file() {
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+auto cma_ledger_memory::get_wal_capacity() const -> size_t {
+    return (wal_length - WAL_HEADER_SIZE) / sizeof(cma_ledger_wal_record_t);
+}
+
+static auto wal_checksum(const void *data, size_t length, uint64_t hash = WAL_FNV_OFFSET) -> uint64_t {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ bytes[i]) * WAL_FNV_PRIME;
+    }
+    return hash;
+}
+
+// pread and pwrite may transfer less than asked, these loop until the whole range is done
+static auto read_fully(int fd, void *data, size_t length, size_t offset) -> bool {
+    auto *bytes = static_cast<uint8_t *>(data);
+    while (length > 0) {
+        const ssize_t n = pread(fd, bytes, length, static_cast<off_t>(offset));
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        length -= static_cast<size_t>(n);
+        offset += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static auto write_fully(int fd, const void *data, size_t length, size_t offset) -> bool {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    while (length > 0) {
+        const ssize_t n = pwrite(fd, bytes, length, static_cast<off_t>(offset));
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        length -= static_cast<size_t>(n);
+        offset += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+auto cma_ledger_memory::open_wal_file(const char *memory_file_name, int memory_fd, bool create, size_t length)
+    -> int {
+    const std::string wal_file_name = std::string(memory_file_name) + WAL_FILE_SUFFIX;
+    if (create && length == 0) {
+        // the log of a ledger created before in the file would be replayed over this one
+        if (unlink(wal_file_name.c_str()) != 0 && errno != ENOENT) {
+            throw CmaException("Unable to remove the write-ahead log", -errno);
+        }
+        return -1;
+    }
+    int flags = O_RDWR | O_CLOEXEC;
+    if (create) {
+        flags |= O_CREAT | O_TRUNC;
+    } else if (length != 0) {
+        // log added to an existing ledger
+        flags |= O_CREAT;
+    }
+    const int wal_fd = open(wal_file_name.c_str(), flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (wal_fd == -1) {
+        if (errno == ENOENT) {
+            return -1;
+        }
+        throw CmaException("Unable to open the write-ahead log", -errno);
+    }
+    try {
+        finish_checkpoint(wal_fd, memory_fd);
+    } catch (...) {
+        close(wal_fd);
+        throw;
+    }
+    return wal_fd;
+}
+
+void cma_ledger_memory::finish_checkpoint(int wal_fd, int memory_fd) {
+    // an invalid header is reported by open_wal, once the ledger is mapped
+    cma_ledger_wal_header_t header = {};
+    if (pread(wal_fd, &header, sizeof(header), 0) != sizeof(header) || header.magic != CMA_LEDGER_WAL_MAGIC) {
+        return;
+    }
+    // only the checkpoint of the current generation may have been interrupted, older ones are finished already
+    cma_ledger_wal_checkpoint_t checkpoint = {};
+    if (pread(wal_fd, &checkpoint, sizeof(checkpoint), static_cast<off_t>(header.length)) != sizeof(checkpoint) ||
+        checkpoint.generation != header.generation + 1 || checkpoint.n_ranges > MAX_DIRTY_RANGES) {
+        return;
+    }
+    std::vector<uint8_t> chunk(WAL_COPY_CHUNK);
+    auto for_each_chunk = [&](auto &&apply) -> bool {
+        size_t staged_offset = header.length + sizeof(checkpoint);
+        for (size_t i = 0; i < checkpoint.n_ranges; ++i) {
+            for (size_t done = 0; done < checkpoint.lengths[i];) {
+                const size_t n = std::min(chunk.size(), checkpoint.lengths[i] - done);
+                if (!read_fully(wal_fd, chunk.data(), n, staged_offset) ||
+                    !apply(checkpoint.offsets[i] + done, chunk.data(), n)) {
+                    return false;
+                }
+                staged_offset += n;
+                done += n;
+            }
+        }
+        return true;
+    };
+
+    // a torn staging means the ledger file wasn't written yet, its records replay over the previous checkpoint
+    uint64_t checksum = WAL_FNV_OFFSET;
+    const bool staged = for_each_chunk([&checksum](size_t /*offset*/, const uint8_t *bytes, size_t n) {
+        checksum = wal_checksum(bytes, n, checksum);
+        return true;
+    });
+    if (!staged ||
+        checkpoint.checksum != wal_checksum(&checkpoint, offsetof(cma_ledger_wal_checkpoint_t, checksum), checksum)) {
+        return;
+    }
+    const bool written = for_each_chunk([memory_fd](size_t offset, const uint8_t *bytes, size_t n) {
+        return write_fully(memory_fd, bytes, n, offset);
+    });
+    if (!written || fdatasync(memory_fd) != 0) {
+        throw CmaException("Unable to finish the checkpoint", -EIO);
+    }
+    header.generation = checkpoint.generation;
+    if (pwrite(wal_fd, &header, sizeof(header), 0) != sizeof(header) || fdatasync(wal_fd) != 0) {
+        throw CmaException("Unable to write the write-ahead log header", -EIO);
+    }
+}
+
+void cma_ledger_memory::open_wal(bool create, size_t length) {
+    bool create_log = create;
+    if (length != 0 && length != wal_length) {
+        if (!create && wal_length != 0) {
+            throw CmaException("Write-ahead log length mismatch", -EINVAL);
+        }
+        // new log (or log added to an existing ledger)
+        create_log = true;
+        wal_length = length;
+        mark_dirty(&wal_length, sizeof(wal_length));
+    }
+    if (wal_length == 0) {
+        if (wal_file.is_open()) {
+            throw CmaException("Write-ahead log of another ledger", -EINVAL);
+        }
+        return;
+    }
+    if (!wal_file.is_open()) {
+        throw CmaException("Write-ahead log not found", -EINVAL);
+    }
+    if (wal_length < WAL_HEADER_SIZE + sizeof(cma_ledger_wal_record_t)) {
+        throw CmaException("Write-ahead log length too small", -ENOBUFS);
+    }
+    if (create_log) {
+        // the records are written out once, so appending them doesn't allocate blocks the log sync must persist
+        const std::vector<uint8_t> zeros(wal_length - WAL_HEADER_SIZE);
+        if (!write_fully(wal_file.get_fd(), zeros.data(), zeros.size(), WAL_HEADER_SIZE)) {
+            throw CmaException("Unable to write the write-ahead log", -EIO);
+        }
+        if (create) {
+            // nothing to keep atomic yet, a ledger whose log has no header can't be opened
+            add_dirty_range(0, m_region.get_size() + mem_offset % interprocess::mapped_region::get_page_size());
+            write_dirty_ranges();
+            write_wal_header(1);
+            return;
+        }
+        write_wal_header(0);
+        write_checkpoint();
+        return;
+    }
+    cma_ledger_wal_header_t header = {};
+    if (pread(wal_file.get_fd(), &header, sizeof(header), 0) != sizeof(header) ||
+        header.magic != CMA_LEDGER_WAL_MAGIC || header.length != wal_length || header.ledger_offset != mem_offset ||
+        header.ledger_length != m_region.get_size()) {
+        throw CmaException("Invalid write-ahead log", -EINVAL);
+    }
+    wal_generation = header.generation;
+    replay_wal();
+}
+
+void cma_ledger_memory::write_wal_header(uint64_t generation) {
+    cma_ledger_wal_header_t header = {
+        .magic = CMA_LEDGER_WAL_MAGIC,
+        .generation = generation,
+        .length = wal_length,
+        .ledger_offset = mem_offset,
+        .ledger_length = m_region.get_size(),
+    };
+    if (pwrite(wal_file.get_fd(), &header, sizeof(header), 0) != sizeof(header) || fdatasync(wal_file.get_fd()) != 0) {
+        throw CmaException("Unable to write the write-ahead log header", -EIO);
+    }
+    // records of the older generations are discarded from here on
+    wal_generation = generation;
+}
+
+void cma_ledger_memory::restore_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
+    const cma_amount_t &balance) {
+    // zero balances have no entry (and the entry may have been removed already)
+    if (is_zero(balance) && !account_asset_balance.contains(make_balance_key(asset_id, account_id))) {
+        return;
+    }
+    set_account_asset_balance(asset_id, account_id, balance);
+}
+
+void cma_ledger_memory::replay_wal() {
+    const size_t capacity = get_wal_capacity();
+    auto read_record = [this](size_t index, cma_ledger_wal_record_t &record) -> bool {
+        const size_t record_offset = WAL_HEADER_SIZE + index * sizeof(cma_ledger_wal_record_t);
+        return pread(wal_file.get_fd(), &record, sizeof(record), static_cast<off_t>(record_offset)) ==
+            sizeof(record) &&
+            record.generation == wal_generation &&
+            record.checksum == wal_checksum(&record, offsetof(cma_ledger_wal_record_t, checksum));
+    };
+
+    // 1: find the end of the last committed group (the tail may hold a torn or unsynced group)
+    size_t n_records = 0;
+    size_t n_committed = 0;
+    for (; n_records < capacity; ++n_records) {
+        cma_ledger_wal_record_t record = {};
+        if (!read_record(n_records, record)) {
+            break;
+        }
+        if (record.op == CMA_LEDGER_WAL_OP_COMMIT) {
+            n_committed = n_records + 1;
+        }
+    }
+
+    // 2: apply the committed records over the checkpointed state, in the order they were made
+    replaying_wal = true;
+    try {
+        for (size_t i = 0; i < n_committed; ++i) {
+            cma_ledger_wal_record_t record = {};
+            if (!read_record(i, record)) {
+                throw CmaException("Unable to read the write-ahead log", -EIO);
+            }
+            replay_record(record);
+        }
+    } catch (...) {
+        replaying_wal = false;
+        throw;
+    }
+    replaying_wal = false;
+    wal_tail = n_records;
+    if (n_records > 0) {
+        write_checkpoint();
+    }
+}
+
+void cma_ledger_memory::replay_record(const cma_ledger_wal_record_t &record) {
+    switch (record.op) {
+        case CMA_LEDGER_WAL_OP_COMMIT:
+            break;
+        case CMA_LEDGER_WAL_OP_DEPOSIT: {
+            restore_balance(record.asset_id, record.to_account_id, record.to_balance);
+            cma_amount_t supply = record.supply;
+            set_asset_supply(record.asset_id, supply);
+            break;
+        }
+        case CMA_LEDGER_WAL_OP_WITHDRAW: {
+            restore_balance(record.asset_id, record.from_account_id, record.from_balance);
+            cma_amount_t supply = record.supply;
+            set_asset_supply(record.asset_id, supply);
+            break;
+        }
+        case CMA_LEDGER_WAL_OP_TRANSFER: {
+            restore_balance(record.asset_id, record.from_account_id, record.from_balance);
+            restore_balance(record.asset_id, record.to_account_id, record.to_balance);
+            break;
+        }
+        case CMA_LEDGER_WAL_OP_BALANCE: {
+            restore_balance(record.asset_id, record.to_account_id, record.to_balance);
+            break;
+        }
+        case CMA_LEDGER_WAL_OP_CREATE_ASSET: {
+            // ids are handed out in order, the same creations made again get the same ids
+            cma_ledger_asset_id_t asset_id = 0;
+            cma_token_address_t token_address = record.token_address;
+            cma_token_id_t token_id = record.token_id;
+            auto asset_type = static_cast<cma_ledger_asset_type_t>(record.key_type);
+            retrieve_asset(&asset_id, &token_address, &token_id, nullptr, asset_type, CMA_LEDGER_OP_CREATE);
+            if (asset_id != record.asset_id) {
+                throw CmaException("Write-ahead log doesn't match the ledger", -EINVAL);
+            }
+            break;
+        }
+        case CMA_LEDGER_WAL_OP_REMOVE_ASSET:
+            remove_asset(record.asset_id);
+            break;
+        case CMA_LEDGER_WAL_OP_CREATE_ACCOUNT: {
+            cma_ledger_account_id_t account_id = 0;
+            cma_ledger_account_t account = {.account_id = record.account_key};
+            auto account_type = static_cast<cma_ledger_account_type_t>(record.key_type);
+            retrieve_account(&account_id, &account, nullptr, nullptr, account_type, CMA_LEDGER_OP_CREATE);
+            if (account_id != record.to_account_id) {
+                throw CmaException("Write-ahead log doesn't match the ledger", -EINVAL);
+            }
+            break;
+        }
+        case CMA_LEDGER_WAL_OP_REMOVE_ACCOUNT:
+            remove_account(record.to_account_id);
+            break;
+        default:
+            throw CmaException("Invalid write-ahead log record", -EINVAL);
+    }
+}
+
+auto cma_ledger_memory::get_dirty_range_bytes(const dirty_range_t &range) const -> std::pair<size_t, size_t> {
+    // ranges are page aligned from the start of the mapping, which the ledger memory starts page_offset bytes into
+    const size_t page_offset = mem_offset % interprocess::mapped_region::get_page_size();
+    const size_t begin = std::max(range.first, page_offset);
+    const size_t end = std::min(range.second, m_region.get_size() + page_offset);
+    return {begin - page_offset, end > begin ? end - begin : 0};
+}
+
+void cma_ledger_memory::stage_checkpoint() {
+    const int wal_fd = wal_file.get_fd();
+    const auto *memory = static_cast<const uint8_t *>(m_region.get_address());
+    cma_ledger_wal_checkpoint_t checkpoint = {.generation = wal_generation + 1, .n_ranges = n_dirty_ranges};
+    uint64_t checksum = WAL_FNV_OFFSET;
+    size_t staged_offset = wal_length + sizeof(checkpoint);
+    for (size_t i = 0; i < n_dirty_ranges; ++i) {
+        const auto [offset, length] = get_dirty_range_bytes(dirty_ranges[i]);
+        checkpoint.offsets[i] = mem_offset + offset;
+        checkpoint.lengths[i] = length;
+        checksum = wal_checksum(memory + offset, length, checksum);
+        if (!write_fully(wal_fd, memory + offset, length, staged_offset)) {
+            throw CmaException("Unable to stage the checkpoint", -EIO);
+        }
+        staged_offset += length;
+    }
+    checkpoint.checksum = wal_checksum(&checkpoint, offsetof(cma_ledger_wal_checkpoint_t, checksum), checksum);
+    if (!write_fully(wal_fd, &checkpoint, sizeof(checkpoint), wal_length) || fdatasync(wal_fd) != 0) {
+        throw CmaException("Unable to stage the checkpoint", -EIO);
+    }
+}
+
+void cma_ledger_memory::write_dirty_ranges() {
+    const int memory_fd = interprocess::get_file_handle(m_file);
+    const auto *memory = static_cast<const uint8_t *>(m_region.get_address());
+    for (size_t i = 0; i < n_dirty_ranges; ++i) {
+        const auto [offset, length] = get_dirty_range_bytes(dirty_ranges[i]);
+        if (!write_fully(memory_fd, memory + offset, length, mem_offset + offset)) {
+            throw CmaException("Unable to write the ledger memory", -EIO);
+        }
+    }
+    if (fdatasync(memory_fd) != 0) {
+        throw CmaException("Unable to write the ledger memory", -EIO);
+    }
+    n_dirty_ranges = 0;
+}
+
+void cma_ledger_memory::write_checkpoint() {
+    if (wal_length == 0) {
+        // the mapped memory must be durable
+        if (m_region.get_address() != nullptr && !m_region.flush(0, 0, false)) {
+            throw CmaException("Unable to flush the ledger memory", -EIO);
+        }
+        n_dirty_ranges = 0;
+            return;
+    }
+    // the private mapping only reaches the ledger file here: the pages are staged in the log file first, so a crash
+    // while writing them leaves either the previous checkpoint and its records, or a checkpoint finished on open
+    if (n_dirty_ranges > 0) {
+        stage_checkpoint();
+        write_dirty_ranges();
+    }
+    write_wal_header(wal_generation + 1);
+    wal_tail = 0;
+    wal_unsynced = false;
+    wal_pending = false;
+}
+
+void cma_ledger_memory::checkpoint() {
+    cma_ledger_base::checkpoint();
+    write_checkpoint();
+}
+
+void cma_ledger_memory::checkpoint_unlogged() {
+    // changes the log can't replay are made outside transactions, a checkpoint makes them durable
+    if (wal_length != 0) {
+        write_checkpoint();
+        return;
+    }
+    flush();
+}
+
+void cma_ledger_memory::reserve_wal(size_t n_records) {
+    if (wal_length == 0 || replaying_wal) {
+        return;
+    }
+    // the records and the commit record of their group
+    const size_t capacity = get_wal_capacity();
+    if (wal_tail + n_records + 1 <= capacity) {
+        return;
+    }
+    // between transactions the ledger memory holds committed changes only, so it can be checkpointed (begin leaves
+    // half of the log to a transaction, a savepoint never refers to an older generation)
+    if (!transaction_open) {
+        write_checkpoint();
+    }
+    if (wal_tail + n_records + 1 > capacity) {
+        throw CmaException("Transaction too large for the write-ahead log", -ENOBUFS);
+    }
+}
+
+void cma_ledger_memory::append_wal(cma_ledger_wal_record_t &record) {
+    if (wal_tail == get_wal_capacity()) {
+        throw CmaException("Transaction too large for the write-ahead log", -ENOBUFS);
+    }
+    record.generation = wal_generation;
+    record.checksum = wal_checksum(&record, offsetof(cma_ledger_wal_record_t, checksum));
+    const size_t record_offset = WAL_HEADER_SIZE + wal_tail * sizeof(cma_ledger_wal_record_t);
+    if (pwrite(wal_file.get_fd(), &record, sizeof(record), static_cast<off_t>(record_offset)) != sizeof(record)) {
+        throw CmaException("Unable to append to the write-ahead log", -EIO);
+    }
+    ++wal_tail;
+    wal_unsynced = true;
+    wal_pending = true;
+}
+
+void cma_ledger_memory::end_wal_group(bool sync) {
+    const size_t group_tail = wal_tail;
+    const bool group_pending = wal_pending;
+    if (wal_pending) {
+        cma_ledger_wal_record_t record = {.op = CMA_LEDGER_WAL_OP_COMMIT};
+        append_wal(record);
+        wal_pending = false;
+    }
+    if (!sync || !wal_unsynced) {
+        return;
+    }
+    if (fdatasync(wal_file.get_fd()) != 0) {
+        // the group stays open, a rollback overwrites its commit record
+        wal_tail = group_tail;
+        wal_pending = group_pending;
+        throw CmaException("Unable to sync the write-ahead log", -EIO);
+    }
+    wal_unsynced = false;
+}
+
+void cma_ledger_memory::log_operation(cma_ledger_wal_record_t *records, size_t n_records) {
+    if (wal_length == 0) {
+        flush();
+        return;
+    }
+    if (replaying_wal) {
+        return;
+    }
+    for (size_t i = 0; i < n_records; ++i) {
+        append_wal(records[i]);
+    }
+    // outside a transaction each operation is a group of its own
+    if (!transaction_open) {
+        end_wal_group(flush_policy == CMA_LEDGER_FLUSH_PER_OP);
+    }
+}
+
+void cma_ledger_memory::log_asset_change(cma_wal_op_t op, cma_ledger_asset_id_t asset_id) {
+    cma_ledger_wal_record_t record = {.op = op, .asset_id = asset_id};
+    if (op == CMA_LEDGER_WAL_OP_CREATE_ASSET) {
+        record.key_type = asset_hot[asset_id].type;
+        record.token_address = asset_cold[asset_id].token_address;
+        record.token_id = asset_cold[asset_id].token_id;
+    }
+    log_operation(&record, 1);
+}
+
+void cma_ledger_memory::log_account_change(cma_wal_op_t op, cma_ledger_account_id_t account_id) {
+    cma_ledger_wal_record_t record = {.op = op, .to_account_id = account_id};
+    if (op == CMA_LEDGER_WAL_OP_CREATE_ACCOUNT) {
+        record.key_type = account_hot[account_id].type;
+        record.account_key = account_cold[account_id].account_id;
+    }
+    log_operation(&record, 1);
+}
+
+void cma_ledger_memory::clear() {
+    for (size_t i = 0; i < last_balances.size(); ++i) {
+        std::ignore = std::fill_n(reinterpret_cast<uint8_t *>(&balances[i]),
+            sizeof(cma_ledger_account_balance_t), (uint8_t) 0);
+    }
+    virtual_free_head = VIRTUAL_BALANCE_NONE;
+    virtual_pool_top = 0;
+    last_balances.clear();
+    account_to_laccid.clear();
+    for (auto &account : account_hot) {
+        account.live = false;
+    }
+    account_count = 0;
+    asset_to_lassid.clear();
+    for (auto &asset : asset_hot) {
+        asset.live = false;
+    }
+    asset_count = 0;
+    account_asset_balance.clear();
+    mark_dirty(m_region.get_address(), m_region.get_size());
+    if (wal_length != 0) {
+        // logged operations don't apply to the cleared ledger
+        write_checkpoint();
+        return;
+    }
+    flush();
+}
+
+auto cma_ledger_memory::get_asset_count() -> size_t {
+    return asset_count;
+}
+
+auto cma_ledger_memory::find_asset(cma_ledger_asset_id_t asset_id, cma_ledger_asset_type_t *asset_type,
+    cma_token_address_t *token_address, cma_token_id_t *token_id, cma_amount_t *supply) -> bool {
+    const auto *asset = lookup_asset(asset_id);
+    if (asset == nullptr) {
+        return false;
+    }
+
+    if (asset_type != nullptr) {
+        *asset_type = asset->type;
+    }
+
+    // asset found
+    const cma_ledger_asset_cold_t &asset_keys = asset_cold[asset_id];
+    switch (asset->type) {
+        case CMA_LEDGER_ASSET_TYPE_ID:
+        case CMA_LEDGER_ASSET_TYPE_BASE:
+            break;
+        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS:
+            if (token_address != nullptr) {
+                std::ignore = std::copy_n(std::begin(asset_keys.token_address.data), CMA_ABI_ADDRESS_LENGTH,
+                    std::begin(token_address->data));
+            }
+            break;
+        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID:
+        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID_AMOUNT:
+            if (token_address != nullptr) {
+                std::ignore = std::copy_n(std::begin(asset_keys.token_address.data), CMA_ABI_ADDRESS_LENGTH,
+                    std::begin(token_address->data));
+            }
+            if (token_id != nullptr) {
+                std::ignore = std::copy_n(std::begin(asset_keys.token_id.data), CMA_ABI_ID_LENGTH,
+                    std::begin(token_id->data));
+            }
+            break;
+        default:
+            // shouldn't be here (wrongly added to map)
+            throw CmaException("Invalid asset type", -EINVAL);
+    }
+    if (supply != nullptr) {
+        std::ignore =
+            std::copy_n(std::begin(asset->supply.data), CMA_ABI_U256_LENGTH, std::begin(supply->data));
+    }
+    return true;
+}
+
+auto cma_ledger_memory::remove_asset(cma_ledger_asset_id_t asset_id) -> void {
+    auto *asset = lookup_asset(asset_id);
+    if (asset == nullptr) {
+        throw CmaException("Couldn't find asset to remove", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+    }
+    if (!is_zero(asset->supply)) {
+        throw CmaException("Asset still have supply", CMA_LEDGER_ERROR_ASSET_SUPPLY);
+    }
+    if (journaling()) {
+        undo_journal.push_back(
+            {.type = CMA_LEDGER_UNDO_ASSET_REMOVED, .asset_id = asset_id, .asset = read_asset_record(asset_id)});
+    }
+    const cma_ledger_asset_cold_t &asset_keys = asset_cold[asset_id];
+    switch (asset->type) {
+        case CMA_LEDGER_ASSET_TYPE_ID: {
+            break;
+        }
+        case CMA_LEDGER_ASSET_TYPE_BASE: {
+            base_asset_id_defined = false;
+            break;
+        }
+        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS: {
+            cma_ledger_asset_key_bytes_t asset_key = {0};
+            std::span<uint8_t> asset_key_bytes_span(asset_key);
+            std::span<uint8_t> asset_key_bytes_addr_span =
+                asset_key_bytes_span.subspan(CMA_LEDGER_ASSET_ARRAY_KEY_ADDRESS_IND, CMA_ABI_ADDRESS_LENGTH);
+            asset_key[CMA_LEDGER_ASSET_ARRAY_KEY_TYPE_IND] = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+            std::ignore = std::copy_n(std::begin(asset_keys.token_address.data), CMA_ABI_ADDRESS_LENGTH,
+                asset_key_bytes_addr_span.begin());
+            if (!erase_entry(asset_to_lassid, asset_key)) {
+                throw CmaException("Coundn't erase asset key map", CMA_LEDGER_ERROR_REMOVE);
+            }
+            break;
+        }
+        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID:
+        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID_AMOUNT: {
+            cma_ledger_asset_key_bytes_t asset_key = {0};
+            std::span<uint8_t> asset_key_bytes_span(asset_key);
+            std::span<uint8_t> asset_key_bytes_addr_span =
+                asset_key_bytes_span.subspan(CMA_LEDGER_ASSET_ARRAY_KEY_ADDRESS_IND, CMA_ABI_ADDRESS_LENGTH);
+            std::span<uint8_t> asset_key_bytes_id_span =
+                asset_key_bytes_span.subspan(CMA_LEDGER_ASSET_ARRAY_KEY_ID_IND, CMA_ABI_ID_LENGTH);
+            asset_key[CMA_LEDGER_ASSET_ARRAY_KEY_TYPE_IND] = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID;
+            std::ignore = std::copy_n(std::begin(asset_keys.token_address.data), CMA_ABI_ADDRESS_LENGTH,
+                asset_key_bytes_addr_span.begin());
+            std::ignore = std::copy_n(std::begin(asset_keys.token_id.data), CMA_ABI_ID_LENGTH,
+                asset_key_bytes_id_span.begin());
+            if (!erase_entry(asset_to_lassid, asset_key)) {
+                throw CmaException("Coundn't erase asset key map", CMA_LEDGER_ERROR_REMOVE);
+            }
+            break;
+        }
+        default: {
+            // shouldn't be here (wrongly added to map)
+            throw CmaException("Invalid asset type", -EINVAL);
+        }
+    }
+
+    asset->live = false;
+    mark_dirty(asset, sizeof(cma_ledger_asset_hot_t));
+    --asset_count;
+    mark_counters_dirty();
+    if (!rolling_back) {
+        log_asset_change(CMA_LEDGER_WAL_OP_REMOVE_ASSET, asset_id);
+    }
+}
+
+void cma_ledger_memory::set_asset_supply(cma_ledger_asset_id_t asset_id, cma_amount_t &supply) {
+    auto *asset = lookup_asset(asset_id);
+    if (asset == nullptr) {
         throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
     }
+    store_supply(asset_id, *asset, supply);
+}
 
-    std::ignore =
-        std::copy_n(std::begin(supply.data), CMA_ABI_U256_LENGTH, std::begin(find_result->second.supply.data));
+void cma_ledger_memory::store_supply(cma_ledger_asset_id_t asset_id, cma_ledger_asset_hot_t &asset,
+    const cma_amount_t &supply) {
+    if (journaling()) {
+        undo_journal.push_back({.type = CMA_LEDGER_UNDO_SUPPLY, .asset_id = asset_id, .amount = asset.supply});
+    }
+
+    std::ignore = std::copy_n(std::begin(supply.data), CMA_ABI_U256_LENGTH, std::begin(asset.supply.data));
+    mark_dirty(&asset.supply, sizeof(cma_amount_t));
 }
 
 void cma_ledger_memory::retrieve_asset(cma_ledger_asset_id_t *asset_id, cma_token_address_t *token_address,
     cma_token_id_t *token_id, cma_amount_t *out_total_supply, cma_ledger_asset_type_t &asset_type,
     cma_ledger_retrieve_operation_t operation) {
+    if (operation != CMA_LEDGER_OP_FIND) {
+        reserve_wal(1);
+    }
 
     switch (asset_type) {
         case CMA_LEDGER_ASSET_TYPE_ID:
@@ -931,22 +2143,12 @@ void cma_ledger_memory::retrieve_asset(cma_ledger_asset_id_t *asset_id, cma_toke
                 if (asset_type == CMA_LEDGER_ASSET_TYPE_BASE && base_asset_id_defined) {
                     throw CmaException("Base asset already inserted", CMA_LEDGER_ERROR_INSERTION_ERROR);
                 }
-                auto *new_asset = new cma_ledger_asset_struct_t();
-                new_asset->type = asset_type;
-                const std::pair<lassid_to_asset_t::iterator, bool> insertion_result =
-                    lassid_to_asset.insert({next_asset_id, *new_asset});
-                if (!insertion_result.second) {
-                    // Key already existed, value was not overwritten
-                    // shouldn't be here
-                    throw CmaException("Asset ID already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
-                }
-
-                *asset_id = next_asset_id;
+                const cma_ledger_asset_struct_t new_asset = {.type = asset_type};
+                *asset_id = insert_asset(new_asset, asset_to_lassid.end());
                 if (asset_type == CMA_LEDGER_ASSET_TYPE_BASE && !base_asset_id_defined) {
                     base_asset_id = *asset_id;
                     base_asset_id_defined = true;
                 }
-                next_asset_id++;
             }
             break;
         }
@@ -966,54 +2168,48 @@ void cma_ledger_memory::retrieve_asset(cma_ledger_asset_id_t *asset_id, cma_toke
             std::ignore =
                 std::copy_n(std::begin(token_address->data), CMA_ABI_ADDRESS_LENGTH, asset_key_bytes_addr_span.begin());
 
-            if (operation == CMA_LEDGER_OP_FIND || operation == CMA_LEDGER_OP_FIND_OR_CREATE ||
-                operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
-                auto find_result_addr = asset_to_lassid.find(asset_key);
-                if (find_result_addr != asset_to_lassid.end()) {
-                    if (!find_asset(find_result_addr->second, &asset_type, token_address, token_id, out_total_supply)) {
-                        // shouldn't be here
-                        throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
-                    }
-                    if (asset_id != nullptr) {
-                        *asset_id = find_result_addr->second;
-                    }
-                    if (operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
-                        remove_asset(find_result_addr->second);
-                    }
-                    return;
-                }
-                if (operation == CMA_LEDGER_OP_FIND || operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
-                    throw CmaException("Asset not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
-                }
+            // creation probes once: the key is either found or reserved for the new asset
+            auto find_result_addr = asset_to_lassid.end();
+            bool key_reserved = false;
+            switch (operation) {
+                case CMA_LEDGER_OP_FIND:
+                case CMA_LEDGER_OP_FIND_AND_REMOVE:
+                    find_result_addr = asset_to_lassid.find(asset_key);
+                    break;
+                case CMA_LEDGER_OP_CREATE:
+                case CMA_LEDGER_OP_FIND_OR_CREATE:
+                    std::tie(find_result_addr, key_reserved) = emplace_entry(asset_to_lassid, asset_key, next_asset_id);
+                    break;
+                default:
+                    throw CmaException("Invalid retrieve operation", -EINVAL);
             }
-
-            // 2: create asset id map (and reverse token address, no token id)
-            if (operation == CMA_LEDGER_OP_CREATE || operation == CMA_LEDGER_OP_FIND_OR_CREATE) {
-                if (next_asset_id >= max_assets) {
-                    throw CmaException("Max assets reached", CMA_LEDGER_ERROR_MAX_ASSETS_REACHED);
-                }
-                std::pair<asset_to_lassid_t::iterator, bool> insertion_result_addr =
-                    asset_to_lassid.insert({asset_key, next_asset_id});
-                if (!insertion_result_addr.second) {
-                    // Key already existed, value was not overwritten
+            if (find_result_addr != asset_to_lassid.end() && !key_reserved) {
+                if (operation == CMA_LEDGER_OP_CREATE) {
                     throw CmaException("Asset Key already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
                 }
-
-                auto *new_asset = new cma_ledger_asset_struct_t();
-                new_asset->type = asset_type;
-                std::ignore = std::copy_n(std::begin(token_address->data), CMA_ABI_ADDRESS_LENGTH,
-                    std::begin(new_asset->token_address.data));
-                std::pair<lassid_to_asset_t::iterator, bool> insertion_result =
-                    lassid_to_asset.insert({next_asset_id, *new_asset});
-                if (!insertion_result.second) {
+                if (!find_asset(find_result_addr->second, &asset_type, token_address, token_id, out_total_supply)) {
                     // shouldn't be here
-                    throw CmaException("Asset ID already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
+                    throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
                 }
-
                 if (asset_id != nullptr) {
-                    *asset_id = next_asset_id;
+                    *asset_id = find_result_addr->second;
                 }
-                next_asset_id++;
+                if (operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
+                    remove_asset(find_result_addr->second);
+                }
+                return;
+            }
+            if (operation == CMA_LEDGER_OP_FIND || operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
+                throw CmaException("Asset not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+            }
+
+            // 2: create asset id map (reverse token address already reserved, no token id)
+            cma_ledger_asset_struct_t new_asset = {.type = asset_type};
+            std::ignore = std::copy_n(std::begin(token_address->data), CMA_ABI_ADDRESS_LENGTH,
+                std::begin(new_asset.token_address.data));
+            const cma_ledger_asset_id_t new_asset_id = insert_asset(new_asset, find_result_addr);
+            if (asset_id != nullptr) {
+                *asset_id = new_asset_id;
             }
             break;
         }
@@ -1040,110 +2236,165 @@ void cma_ledger_memory::retrieve_asset(cma_ledger_asset_id_t *asset_id, cma_toke
                 std::copy_n(std::begin(token_address->data), CMA_ABI_ADDRESS_LENGTH, asset_key_bytes_addr_span.begin());
             std::ignore = std::copy_n(std::begin(token_id->data), CMA_ABI_ID_LENGTH, asset_key_bytes_id_span.begin());
 
-            if (operation == CMA_LEDGER_OP_FIND || operation == CMA_LEDGER_OP_FIND_OR_CREATE ||
-                operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
-                auto find_result_addr = asset_to_lassid.find(asset_key);
-                if (find_result_addr != asset_to_lassid.end()) {
-                    if (!find_asset(find_result_addr->second, &asset_type, token_address, token_id, out_total_supply)) {
-                        // shouldn't be here
-                        throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
-                    }
-                    if (asset_id != nullptr) {
-                        *asset_id = find_result_addr->second;
-                    }
-                    if (operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
-                        remove_asset(find_result_addr->second);
-                    }
-                    return;
-                }
-                if (operation == CMA_LEDGER_OP_FIND || operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
-                    throw CmaException("Asset not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
-                }
+            // creation probes once: the key is either found or reserved for the new asset
+            auto find_result_addr = asset_to_lassid.end();
+            bool key_reserved = false;
+            switch (operation) {
+                case CMA_LEDGER_OP_FIND:
+                case CMA_LEDGER_OP_FIND_AND_REMOVE:
+                    find_result_addr = asset_to_lassid.find(asset_key);
+                    break;
+                case CMA_LEDGER_OP_CREATE:
+                case CMA_LEDGER_OP_FIND_OR_CREATE:
+                    std::tie(find_result_addr, key_reserved) = emplace_entry(asset_to_lassid, asset_key, next_asset_id);
+                    break;
+                default:
+                    throw CmaException("Invalid retrieve operation", -EINVAL);
             }
-
-            // 2: create asset id map (and reverse token address, token id)
-            if (operation == CMA_LEDGER_OP_CREATE || operation == CMA_LEDGER_OP_FIND_OR_CREATE) {
-                if (next_asset_id >= max_assets) {
-                    throw CmaException("Max assets reached", CMA_LEDGER_ERROR_MAX_ASSETS_REACHED);
-                }
-                std::pair<asset_to_lassid_t::iterator, bool> insertion_result_addr =
-                    asset_to_lassid.insert({asset_key, next_asset_id});
-                if (!insertion_result_addr.second) {
-                    // Key already existed, value was not overwritten
+            if (find_result_addr != asset_to_lassid.end() && !key_reserved) {
+                if (operation == CMA_LEDGER_OP_CREATE) {
                     throw CmaException("Asset Key already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
                 }
-
-                auto *new_asset = new cma_ledger_asset_struct_t();
-                new_asset->type = asset_type;
-                std::ignore = std::copy_n(std::begin(token_address->data), CMA_ABI_ADDRESS_LENGTH,
-                    std::begin(new_asset->token_address.data));
-                std::ignore =
-                    std::copy_n(std::begin(token_id->data), CMA_ABI_ID_LENGTH, std::begin(new_asset->token_id.data));
-                std::pair<lassid_to_asset_t::iterator, bool> insertion_result =
-                    lassid_to_asset.insert({next_asset_id, *new_asset});
-                if (!insertion_result.second) {
+                if (!find_asset(find_result_addr->second, &asset_type, token_address, token_id, out_total_supply)) {
                     // shouldn't be here
-                    throw CmaException("Asset ID already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
+                    throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
                 }
-
                 if (asset_id != nullptr) {
-                    *asset_id = next_asset_id;
+                    *asset_id = find_result_addr->second;
                 }
-                next_asset_id++;
+                if (operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
+                    remove_asset(find_result_addr->second);
+                }
+                return;
+            }
+            if (operation == CMA_LEDGER_OP_FIND || operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
+                throw CmaException("Asset not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+            }
+
+            // 2: create asset id map (reverse token address and token id already reserved)
+            cma_ledger_asset_struct_t new_asset = {.type = asset_type};
+            std::ignore = std::copy_n(std::begin(token_address->data), CMA_ABI_ADDRESS_LENGTH,
+                std::begin(new_asset.token_address.data));
+            std::ignore =
+                std::copy_n(std::begin(token_id->data), CMA_ABI_ID_LENGTH, std::begin(new_asset.token_id.data));
+            const cma_ledger_asset_id_t new_asset_id = insert_asset(new_asset, find_result_addr);
+            if (asset_id != nullptr) {
+                *asset_id = new_asset_id;
             }
             break;
         }
-        default:
-            throw CmaException("Invalid asset type", -EINVAL);
+        default:
+            throw CmaException("Invalid asset type", -EINVAL);
+    }
+    flush();
+}
+
+auto cma_ledger_memory::insert_asset(const cma_ledger_asset_struct_t &asset, asset_to_lassid_t::iterator key_slot)
+    -> cma_ledger_asset_id_t {
+    // a reserved reverse key is released when the asset can't be created
+    try {
+        if (next_asset_id >= max_assets || next_asset_id >= asset_hot.size()) {
+            throw CmaException("Max assets reached", CMA_LEDGER_ERROR_MAX_ASSETS_REACHED);
+        }
+        if (asset_hot[next_asset_id].live) {
+            // shouldn't be here
+            throw CmaException("Asset ID already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
+        }
+    } catch (...) {
+        if (key_slot != asset_to_lassid.end()) {
+            erase_entry(asset_to_lassid, key_slot);
+        }
+        throw;
+    }
+
+    if (journaling()) {
+        undo_journal.push_back({.type = CMA_LEDGER_UNDO_ASSET_CREATED, .asset_id = next_asset_id});
+    }
+    write_asset_record(next_asset_id, asset);
+    ++asset_count;
+    mark_counters_dirty();
+    const cma_ledger_asset_id_t asset_id = next_asset_id++;
+    log_asset_change(CMA_LEDGER_WAL_OP_CREATE_ASSET, asset_id);
+    return asset_id;
+}
+
+auto cma_ledger_memory::insert_account(const cma_ledger_account_struct_t &account,
+    account_to_laccid_t::iterator key_slot) -> cma_ledger_account_id_t {
+    // a reserved reverse key is released when the account can't be created
+    try {
+        if (next_account_id >= max_accounts || next_account_id >= account_hot.size()) {
+            throw CmaException("Max accounts reached", CMA_LEDGER_ERROR_MAX_ACCOUNTS_REACHED);
+        }
+        if (account_hot[next_account_id].live) {
+            // shouldn't be here
+            throw CmaException("Account ID already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
+        }
+    } catch (...) {
+        if (key_slot != account_to_laccid.end()) {
+            erase_entry(account_to_laccid, key_slot);
+        }
+        throw;
     }
-    if (m_region.get_address() != nullptr) {
-        m_region.flush();
+
+    if (journaling()) {
+        undo_journal.push_back({.type = CMA_LEDGER_UNDO_ACCOUNT_CREATED, .account_id = next_account_id});
     }
+    write_account_record(next_account_id, account);
+    ++account_count;
+    mark_counters_dirty();
+    const cma_ledger_account_id_t account_id = next_account_id++;
+    log_account_change(CMA_LEDGER_WAL_OP_CREATE_ACCOUNT, account_id);
+    return account_id;
 }
 
 auto cma_ledger_memory::get_account_count() -> size_t {
-    return laccid_to_account.size();
+    return account_count;
 }
 
 auto cma_ledger_memory::find_account(cma_ledger_account_id_t account_id, cma_ledger_account_t *account,
     size_t *n_balances) -> bool {
-    auto find_result = laccid_to_account.find(account_id);
-    if (find_result == laccid_to_account.end()) {
+    const auto *account_entry = lookup_account(account_id);
+    if (account_entry == nullptr) {
         return false;
     }
 
     // account found
     if (account != nullptr) {
-        account->type = find_result->second.account.type;
-        std::ignore = std::copy_n(std::begin(find_result->second.account.account_id.data), CMA_ABI_ID_LENGTH,
+        account->type = account_entry->type;
+        std::ignore = std::copy_n(std::begin(account_cold[account_id].account_id.data), CMA_ABI_ID_LENGTH,
             std::begin(account->account_id.data));
     }
     if (n_balances != nullptr) {
-        *n_balances = find_result->second.n_balances;
+        *n_balances = account_entry->n_balances;
     }
 
     return true;
 }
 
 auto cma_ledger_memory::remove_account(cma_ledger_account_id_t account_id) -> void {
-    auto find_result = laccid_to_account.find(account_id);
-    if (find_result == laccid_to_account.end()) {
+    auto *account = lookup_account(account_id);
+    if (account == nullptr) {
         throw CmaException("Account not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
     }
-    if (find_result->second.n_balances > 0) {
+    if (account->n_balances > 0) {
         throw CmaException("Account still have balances", CMA_LEDGER_ERROR_ACCOUNT_BALANCE);
     }
+    if (journaling()) {
+        undo_journal.push_back({.type = CMA_LEDGER_UNDO_ACCOUNT_REMOVED,
+            .account_id = account_id,
+            .account = read_account_record(account_id)});
+    }
 
-    switch (find_result->second.account.type) {
+    switch (account->type) {
         case CMA_LEDGER_ACCOUNT_TYPE_ID: {
             break;
         }
         case CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS:
         case CMA_LEDGER_ACCOUNT_TYPE_ACCOUNT_ID: {
             cma_ledger_account_key_bytes_t account_key;
-            std::ignore = std::copy_n(std::begin(find_result->second.account.account_id.data), CMA_ABI_ID_LENGTH,
+            std::ignore = std::copy_n(std::begin(account_cold[account_id].account_id.data), CMA_ABI_ID_LENGTH,
                 account_key.begin());
-            if (account_to_laccid.erase(account_key) == 0) {
+            if (!erase_entry(account_to_laccid, account_key)) {
                 throw CmaException("Coundn't erase account key map", CMA_LEDGER_ERROR_REMOVE);
             }
             break;
@@ -1154,13 +2405,20 @@ auto cma_ledger_memory::remove_account(cma_ledger_account_id_t account_id) -> vo
         }
     }
 
-    if (laccid_to_account.erase(account_id) == 0) {
-        throw CmaException("Coundn't erase account id map", CMA_LEDGER_ERROR_REMOVE);
+    account->live = false;
+    mark_dirty(account, sizeof(cma_ledger_account_hot_t));
+    --account_count;
+    mark_counters_dirty();
+    if (!rolling_back) {
+        log_account_change(CMA_LEDGER_WAL_OP_REMOVE_ACCOUNT, account_id);
     }
 }
 void cma_ledger_memory::retrieve_account(cma_ledger_account_id_t *account_id, cma_ledger_account_t *account,
     const void *addr_accid, size_t *n_balances, cma_ledger_account_type_t &account_type,
     cma_ledger_retrieve_operation_t operation) {
+    if (operation != CMA_LEDGER_OP_FIND) {
+        reserve_wal(1);
+    }
 
     switch (account_type) {
         case CMA_LEDGER_ACCOUNT_TYPE_ID: {
@@ -1189,20 +2447,9 @@ void cma_ledger_memory::retrieve_account(cma_ledger_account_id_t *account_id, cm
 
             // 2: create account id map (but no reverse)
             if (operation == CMA_LEDGER_OP_CREATE || operation == CMA_LEDGER_OP_FIND_OR_CREATE) {
-                if (next_account_id >= max_accounts) {
-                    throw CmaException("Max accounts reached", CMA_LEDGER_ERROR_MAX_ACCOUNTS_REACHED);
-                }
-                auto *new_account = new cma_ledger_account_struct_t();
-                new_account->account.type = account_type;
-                std::pair<laccid_to_account_t::iterator, bool> insertion_result =
-                    laccid_to_account.insert({next_account_id, *new_account});
-                if (!insertion_result.second) {
-                    // shouldn't be here
-                    throw CmaException("Account ID already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
-                }
-
-                *account_id = next_account_id;
-                next_account_id++;
+                cma_ledger_account_struct_t new_account = {};
+                new_account.account.type = account_type;
+                *account_id = insert_account(new_account, account_to_laccid.end());
             }
             break;
         }
@@ -1242,96 +2489,78 @@ void cma_ledger_memory::retrieve_account(cma_ledger_account_id_t *account_id, cm
             std::ignore =
                 std::copy_n(std::begin(account_local.account.account_id.data), CMA_ABI_ID_LENGTH, account_key.begin());
 
-            if (operation == CMA_LEDGER_OP_FIND || operation == CMA_LEDGER_OP_FIND_OR_CREATE ||
-                operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
-                auto find_result_acc = account_to_laccid.find(account_key);
-                if (find_result_acc != account_to_laccid.end()) {
-                    if (!cma_ledger_memory::find_account(find_result_acc->second, &account_local.account, n_balances)) {
-                        // shouldn't be here
-                        throw CmaException("Account by id not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
-                    }
-                    if (account_id != nullptr) {
-                        *account_id = find_result_acc->second;
-                    }
-                    if (account != nullptr) {
-                        account->type = account_local.account.type;
-                        account_type = account_local.account.type;
-                        std::ignore = std::copy_n(std::begin(account_local.account.account_id.data), CMA_ABI_ID_LENGTH,
-                            std::begin(account->account_id.data));
-                    }
-                    if (operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
-                        remove_account(find_result_acc->second);
-                    }
-                    return;
-                }
-                if (operation == CMA_LEDGER_OP_FIND || operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
-                    throw CmaException("Account not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
-                }
+            // creation probes once: the key is either found or reserved for the new account
+            auto find_result_acc = account_to_laccid.end();
+            bool key_reserved = false;
+            switch (operation) {
+                case CMA_LEDGER_OP_FIND:
+                case CMA_LEDGER_OP_FIND_AND_REMOVE:
+                    find_result_acc = account_to_laccid.find(account_key);
+                    break;
+                case CMA_LEDGER_OP_CREATE:
+                case CMA_LEDGER_OP_FIND_OR_CREATE:
+                    std::tie(find_result_acc, key_reserved) =
+                        emplace_entry(account_to_laccid, account_key, next_account_id);
+                    break;
+                default:
+                    throw CmaException("Invalid retrieve operation", -EINVAL);
             }
-
-            // 2: create account id map (and reverse account)
-            if (operation == CMA_LEDGER_OP_CREATE || operation == CMA_LEDGER_OP_FIND_OR_CREATE) {
-                if (next_account_id >= max_accounts) {
-                    throw CmaException("Max accounts reached", CMA_LEDGER_ERROR_MAX_ACCOUNTS_REACHED);
-                }
-                std::pair<account_to_laccid_t::iterator, bool> insertion_result_acc =
-                    account_to_laccid.insert({account_key, next_account_id});
-                if (!insertion_result_acc.second) {
-                    // Key already existed, value was not overwritten
+            if (find_result_acc != account_to_laccid.end() && !key_reserved) {
+                if (operation == CMA_LEDGER_OP_CREATE) {
                     throw CmaException("Account Key already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
                 }
-
-                account_local.account.type = account_type_local; // set correct type
-                std::pair<laccid_to_account_t::iterator, bool> insertion_result =
-                    laccid_to_account.insert({next_account_id, account_local});
-                if (!insertion_result.second) {
+                if (!cma_ledger_memory::find_account(find_result_acc->second, &account_local.account, n_balances)) {
                     // shouldn't be here
-                    throw CmaException("Account ID already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
+                    throw CmaException("Account by id not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
                 }
-
                 if (account_id != nullptr) {
-                    *account_id = next_account_id;
+                    *account_id = find_result_acc->second;
                 }
                 if (account != nullptr) {
                     account->type = account_local.account.type;
+                    account_type = account_local.account.type;
                     std::ignore = std::copy_n(std::begin(account_local.account.account_id.data), CMA_ABI_ID_LENGTH,
                         std::begin(account->account_id.data));
                 }
-                account_type = account_type_local;
-                next_account_id++;
+                if (operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
+                    remove_account(find_result_acc->second);
+                }
+                return;
+            }
+            if (operation == CMA_LEDGER_OP_FIND || operation == CMA_LEDGER_OP_FIND_AND_REMOVE) {
+                throw CmaException("Account not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+            }
+
+            // 2: create account id map (reverse account already reserved)
+            account_local.account.type = account_type_local; // set correct type
+            const cma_ledger_account_id_t new_account_id = insert_account(account_local, find_result_acc);
+            if (account_id != nullptr) {
+                *account_id = new_account_id;
+            }
+            if (account != nullptr) {
+                account->type = account_local.account.type;
+                std::ignore = std::copy_n(std::begin(account_local.account.account_id.data), CMA_ABI_ID_LENGTH,
+                    std::begin(account->account_id.data));
             }
+            account_type = account_type_local;
             break;
         }
         default:
             throw CmaException("Invalid asset type", -EINVAL);
     }
-    if (m_region.get_address() != nullptr) {
-        m_region.flush();
-    }
+    flush();
 }
 
 void cma_ledger_memory::get_account_asset_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
     cma_amount_t *balance, cma_ledger_account_balance_info_t *account_balance_info) {
-    auto find_result = account_asset_balance.find({asset_id, account_id});
+    auto find_result = account_asset_balance.find(make_balance_key(asset_id, account_id));
 
     if (balance != nullptr) {
         if (find_result == account_asset_balance.end()) {
             std::fill_n(std::begin(balance->data), CMA_ABI_U256_LENGTH, (uint8_t) 0);
         } else {
-            switch (find_result->second.type) {
-                case CMA_LEDGER_BALANCE_TYPE_VIRTUAL: {
-                    std::ignore = std::copy_n(std::begin(find_result->second.virtual_balance->amount.data),
-                        CMA_ABI_U256_LENGTH, std::begin(balance->data));
-                    break;
-                }
-                case CMA_LEDGER_BALANCE_TYPE_WITHDRAWABLE: {
-                    std::ignore = std::copy_n(std::begin(find_result->second.withdrawable_balance->amount.data),
-                        CMA_ABI_U256_LENGTH, std::begin(balance->data));
-                    break;
-                }
-                default:
-                    throw CmaException("Invalid balance type", -EINVAL);
-            }
+            std::ignore = std::copy_n(std::begin(get_balance_amount(find_result->second).data), CMA_ABI_U256_LENGTH,
+                std::begin(balance->data));
         }
     }
 
@@ -1341,234 +2570,444 @@ void cma_ledger_memory::get_account_asset_balance(cma_ledger_asset_id_t asset_id
             account_balance_info->balance = nullptr;
             return;
         }
-        account_balance_info->balance = find_result->second.withdrawable_balance.get();
-        account_balance_info->index = find_result->second.withdrawable_balance.get() - balances;
+        account_balance_info->balance = &balances[find_result->second.index];
+        account_balance_info->index = find_result->second.index;
         account_balance_info->offset = account_balance_info->index * sizeof(cma_ledger_account_balance_t) + mem_offset;
     }
 }
 
 void cma_ledger_memory::set_account_asset_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
     const cma_amount_t &balance) {
-    auto find_result = account_asset_balance.find({asset_id, account_id});
-    if (find_result == account_asset_balance.end()) {
-        // create new entry
-        if (account_asset_balance.size() >= max_balances) {
+    auto [balance_slot, reserved] = reserve_balance(asset_id, account_id);
+    store_balance(asset_id, account_id, balance_slot, reserved, nullptr, nullptr, balance);
+}
+
+auto cma_ledger_memory::lookup_asset(cma_ledger_asset_id_t asset_id) -> cma_ledger_asset_hot_t * {
+    if (asset_id >= asset_hot.size() || !asset_hot[asset_id].live) {
+        return nullptr;
+    }
+    return &asset_hot[asset_id];
+}
+
+auto cma_ledger_memory::lookup_account(cma_ledger_account_id_t account_id) -> cma_ledger_account_hot_t * {
+    if (account_id >= account_hot.size() || !account_hot[account_id].live) {
+        return nullptr;
+    }
+    return &account_hot[account_id];
+}
+
+auto cma_ledger_memory::read_asset_record(cma_ledger_asset_id_t asset_id) const -> cma_ledger_asset_struct_t {
+    const cma_ledger_asset_hot_t &hot = asset_hot[asset_id];
+    const cma_ledger_asset_cold_t &cold = asset_cold[asset_id];
+    return {.type = hot.type, .token_address = cold.token_address, .token_id = cold.token_id, .supply = hot.supply};
+}
+
+void cma_ledger_memory::write_asset_record(cma_ledger_asset_id_t asset_id, const cma_ledger_asset_struct_t &asset) {
+    asset_hot[asset_id] = {
+        .supply = asset.supply,
+        .type = asset.type,
+        .owner_account_id = OWNER_NONE,
+        .n_holders = 0,
+        .first_account_id = BALANCE_LINK_NONE,
+        .live = true,
+    };
+    asset_cold[asset_id] = {.token_address = asset.token_address, .token_id = asset.token_id};
+    mark_dirty(&asset_hot[asset_id], sizeof(cma_ledger_asset_hot_t));
+    mark_dirty(&asset_cold[asset_id], sizeof(cma_ledger_asset_cold_t));
+}
+
+auto cma_ledger_memory::read_account_record(cma_ledger_account_id_t account_id) const
+    -> cma_ledger_account_struct_t {
+    return {.account = account_cold[account_id], .n_balances = account_hot[account_id].n_balances};
+}
+
+void cma_ledger_memory::write_account_record(cma_ledger_account_id_t account_id,
+    const cma_ledger_account_struct_t &account) {
+    account_hot[account_id] = {
+        .n_balances = account.n_balances,
+        .type = account.account.type,
+        .first_asset_id = BALANCE_LINK_NONE,
+        .live = true,
+    };
+    account_cold[account_id] = account.account;
+    mark_dirty(&account_hot[account_id], sizeof(cma_ledger_account_hot_t));
+    mark_dirty(&account_cold[account_id], sizeof(cma_ledger_account_t));
+}
+
+auto cma_ledger_memory::lookup_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id)
+    -> cma_balance_t * {
+    auto find_result = find_balance(asset_id, account_id);
+    return find_result == account_asset_balance.end() ? nullptr : &find_result->second;
+}
+
+auto cma_ledger_memory::find_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id)
+    -> account_asset_map_t::iterator {
+    return account_asset_balance.find(make_balance_key(asset_id, account_id));
+}
+
+auto cma_ledger_memory::reserve_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id)
+    -> std::pair<account_asset_map_t::iterator, bool> {
+    const cma_map_key_t balance_key = make_balance_key(asset_id, account_id);
+    // a missing balance can't be created at the max, it is left to store_balance (e.g. a transfer draining its source
+    // makes room for its destination)
+    if (account_asset_balance.size() >= max_balances) {
+        return {account_asset_balance.find(balance_key), false};
+    }
+    return emplace_entry(account_asset_balance, balance_key, cma_balance_t{});
+}
+
+auto cma_ledger_memory::allocate_virtual_balance() -> uint32_t {
+    size_t index = virtual_free_head;
+    if (index != VIRTUAL_BALANCE_NONE) {
+        virtual_free_head = virtual_balances[index].next_free;
+    } else {
+        if (virtual_pool_top >= virtual_balances.size()) {
             throw CmaException("Max balances reached", CMA_LEDGER_ERROR_MAX_BALANCES_REACHED);
         }
-        // check if it is withdrawable (if not create virtual balance)
-        cma_balance_type_t balance_type;
-        auto asset_find_result = lassid_to_asset.find(asset_id);
-        if (asset_find_result == lassid_to_asset.end()) {
-            throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+        index = virtual_pool_top++;
+    }
+    mark_dirty(&virtual_free_head, sizeof(virtual_free_head));
+    mark_dirty(&virtual_pool_top, sizeof(virtual_pool_top));
+    return static_cast<uint32_t>(index);
+}
+
+void cma_ledger_memory::free_virtual_balance(uint32_t index) {
+    if (index >= virtual_pool_top) {
+        throw CmaException("Virtual balance out of pool", CMA_LEDGER_ERROR_REMOVE);
+    }
+    virtual_balances[index].next_free = virtual_free_head;
+    virtual_free_head = index;
+    mark_dirty(&virtual_balances[index], sizeof(cma_ledger_virtual_balance_slot_t));
+    mark_dirty(&virtual_free_head, sizeof(virtual_free_head));
+}
+
+void cma_ledger_memory::link_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
+    cma_ledger_asset_hot_t &asset, cma_ledger_account_hot_t &account, cma_balance_t &balance_entry) {
+    // push to the front of the balance list of the account
+    balance_entry.prev_asset_id = BALANCE_LINK_NONE;
+    balance_entry.next_asset_id = account.first_asset_id;
+    if (account.first_asset_id != BALANCE_LINK_NONE) {
+        auto *head = lookup_balance(account.first_asset_id, account_id);
+        if (head == nullptr) {
+            throw CmaException("Balance list head not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+        }
+        head->prev_asset_id = static_cast<uint32_t>(asset_id);
+        mark_dirty(head, sizeof(cma_balance_t));
+    }
+    account.first_asset_id = static_cast<uint32_t>(asset_id);
+    account.n_balances++;
+    mark_dirty(&account, sizeof(cma_ledger_account_hot_t));
+
+    // and to the front of the holder list of the asset
+    balance_entry.prev_account_id = BALANCE_LINK_NONE;
+    balance_entry.next_account_id = asset.first_account_id;
+    if (asset.first_account_id != BALANCE_LINK_NONE) {
+        auto *head = lookup_balance(asset_id, asset.first_account_id);
+        if (head == nullptr) {
+            throw CmaException("Holder list head not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+        }
+        head->prev_account_id = static_cast<uint32_t>(account_id);
+        mark_dirty(head, sizeof(cma_balance_t));
+    }
+    asset.first_account_id = static_cast<uint32_t>(account_id);
+    asset.n_holders++;
+
+    if (asset.type == CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID) {
+        asset.owner_account_id = static_cast<uint32_t>(account_id);
+    }
+    mark_dirty(&asset, sizeof(cma_ledger_asset_hot_t));
+}
+
+void cma_ledger_memory::unlink_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
+    cma_ledger_asset_hot_t &asset, cma_ledger_account_hot_t &account, const cma_balance_t &balance_entry) {
+    if (balance_entry.prev_asset_id == BALANCE_LINK_NONE) {
+        account.first_asset_id = balance_entry.next_asset_id;
+    } else {
+        auto *prev = lookup_balance(balance_entry.prev_asset_id, account_id);
+        if (prev == nullptr) {
+            throw CmaException("Previous balance not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
         }
-        auto account_find_result = laccid_to_account.find(account_id);
-        if (account_find_result == laccid_to_account.end()) {
-            throw CmaException("Account by id not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+        prev->next_asset_id = balance_entry.next_asset_id;
+        mark_dirty(prev, sizeof(cma_balance_t));
+    }
+    if (balance_entry.next_asset_id != BALANCE_LINK_NONE) {
+        auto *next = lookup_balance(balance_entry.next_asset_id, account_id);
+        if (next == nullptr) {
+            throw CmaException("Next balance not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+        }
+        next->prev_asset_id = balance_entry.prev_asset_id;
+        mark_dirty(next, sizeof(cma_balance_t));
+    }
+    account.n_balances--;
+    mark_dirty(&account, sizeof(cma_ledger_account_hot_t));
+
+    if (balance_entry.prev_account_id == BALANCE_LINK_NONE) {
+        asset.first_account_id = balance_entry.next_account_id;
+    } else {
+        auto *prev = lookup_balance(asset_id, balance_entry.prev_account_id);
+        if (prev == nullptr) {
+            throw CmaException("Previous holder not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+        }
+        prev->next_account_id = balance_entry.next_account_id;
+        mark_dirty(prev, sizeof(cma_balance_t));
+    }
+    if (balance_entry.next_account_id != BALANCE_LINK_NONE) {
+        auto *next = lookup_balance(asset_id, balance_entry.next_account_id);
+        if (next == nullptr) {
+            throw CmaException("Next holder not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+        }
+        next->prev_account_id = balance_entry.prev_account_id;
+        mark_dirty(next, sizeof(cma_balance_t));
+    }
+    asset.n_holders--;
+
+    // the new holder may have been set already (its balance created before this one was removed)
+    if (asset.owner_account_id == account_id) {
+        asset.owner_account_id = OWNER_NONE;
+    }
+    mark_dirty(&asset, sizeof(cma_ledger_asset_hot_t));
+}
+
+auto cma_ledger_memory::get_balance_amount(const cma_balance_t &balance_entry) const -> const cma_amount_t & {
+    switch (balance_entry.type) {
+        case CMA_LEDGER_BALANCE_TYPE_VIRTUAL:
+            return virtual_balances[balance_entry.index].balance.amount;
+        case CMA_LEDGER_BALANCE_TYPE_WITHDRAWABLE:
+            return balances[balance_entry.index].amount;
+        default:
+            throw CmaException("Invalid balance type", -EINVAL);
+    }
+}
+
+void cma_ledger_memory::store_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
+    account_asset_map_t::iterator balance_slot, bool reserved, cma_ledger_asset_hot_t *asset,
+    cma_ledger_account_hot_t *account, const cma_amount_t &balance) {
+    const cma_map_key_t balance_key = make_balance_key(asset_id, account_id);
+    if (reserved || balance_slot == account_asset_balance.end()) {
+        // create new entry, a reserved one is released if the balance can't be created
+        cma_balance_type_t balance_type;
+        try {
+            if (journaling()) {
+                undo_journal.push_back(
+                    {.type = CMA_LEDGER_UNDO_BALANCE, .asset_id = asset_id, .account_id = account_id});
+            }
+            if (!reserved && account_asset_balance.size() >= max_balances) {
+                throw CmaException("Max balances reached", CMA_LEDGER_ERROR_MAX_BALANCES_REACHED);
+            }
+            // check if it is withdrawable (if not create virtual balance)
+            if (asset == nullptr) {
+                asset = lookup_asset(asset_id);
+                if (asset == nullptr) {
+                    throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+                }
+            }
+            if (account == nullptr) {
+                account = lookup_account(account_id);
+                if (account == nullptr) {
+                    throw CmaException("Account by id not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+                }
+            }
+        } catch (...) {
+            if (reserved) {
+                erase_entry(account_asset_balance, balance_slot);
+            }
+            throw;
         }
-        if (asset_find_result->second.type == CMA_LEDGER_ASSET_TYPE_ID) {
+        if (asset->type == CMA_LEDGER_ASSET_TYPE_ID) {
             balance_type = CMA_LEDGER_BALANCE_TYPE_VIRTUAL;
         } else {
-            if (account_find_result->second.account.type != CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS) {
+            if (account->type != CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS) {
                 balance_type = CMA_LEDGER_BALANCE_TYPE_VIRTUAL;
             } else {
                 balance_type = CMA_LEDGER_BALANCE_TYPE_WITHDRAWABLE;
             }
         }
 
-        cma_balance_t new_balance = {.type = balance_type};
-        switch (balance_type) {
-            case CMA_LEDGER_BALANCE_TYPE_VIRTUAL: {
-                cma_ledger_account_virtual_balance_t new_virtual_balance = {};
-                std::ignore = std::copy_n(std::begin(balance.data), CMA_ABI_U256_LENGTH,
-                    std::begin(new_virtual_balance.amount.data));
-
-                virtual_balances.push_back(new_virtual_balance);
-                new_balance.virtual_balance = &virtual_balances.back();
-                last_virtual_balances.push_back({asset_id, account_id});
-                break;
+        // the entry goes in first, growing the table is what can fail (e.g. when the ledger memory is full) and a
+        // failure past it takes the entry out again, so the balance is either fully created or not at all
+        if (reserved) {
+            balance_slot->second = cma_balance_t{.type = balance_type};
+        } else {
+            auto insertion_result =
+                emplace_entry(account_asset_balance, balance_key, cma_balance_t{.type = balance_type});
+            if (!insertion_result.second) {
+                // shouldn't be here
+                throw CmaException("Balance already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
             }
-            case CMA_LEDGER_BALANCE_TYPE_WITHDRAWABLE: {
-                auto new_index = last_balances.size();
-                cma_ledger_account_balance_t *new_withdrawable_balance = &balances[new_index];
-                // uint32_t type;
-                new_withdrawable_balance->type = static_cast<uint32_t>(asset_find_result->second.type);
-                // cma_abi_address_t owner;
-                std::ignore = std::copy_n(std::begin(account_find_result->second.account.address.data),
-                    CMA_ABI_ADDRESS_LENGTH, std::begin(new_withdrawable_balance->owner.data));
-
-                // cma_amount_t amount;
-                std::ignore = std::copy_n(std::begin(balance.data), CMA_ABI_U256_LENGTH,
-                    std::begin(new_withdrawable_balance->amount.data));
-
-                switch (asset_find_result->second.type) {
-                    case CMA_LEDGER_ASSET_TYPE_ID:
-                    case CMA_LEDGER_ASSET_TYPE_BASE: {
-                        break;
-                    }
-                    case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS: {
-                        // cma_token_address_t token;
-                        std::ignore = std::copy_n(std::begin(asset_find_result->second.token_address.data),
-                            CMA_ABI_ADDRESS_LENGTH, std::begin(new_withdrawable_balance->token_address.data));
-                        break;
-                    }
-                    case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID:
-                    case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID_AMOUNT: {
-                        // cma_token_address_t token;
-                        std::ignore = std::copy_n(std::begin(asset_find_result->second.token_address.data),
-                            CMA_ABI_ADDRESS_LENGTH, std::begin(new_withdrawable_balance->token_address.data));
-                        // cma_token_id_t token_id;
-                        std::ignore = std::copy_n(std::begin(asset_find_result->second.token_id.data),
-                            CMA_ABI_ID_LENGTH, std::begin(new_withdrawable_balance->token_id.data));
-                        break;
-                    }
-                    default: {
-                        // shouldn't be here (wrongly added to map)
-                        throw CmaException("Invalid asset type", -EINVAL);
-                    }
+            balance_slot = insertion_result.first;
+        }
+        cma_balance_t &new_balance = balance_slot->second;
+        try {
+            switch (balance_type) {
+                case CMA_LEDGER_BALANCE_TYPE_VIRTUAL: {
+                    cma_ledger_account_virtual_balance_t new_virtual_balance = {};
+                    std::ignore = std::copy_n(std::begin(balance.data), CMA_ABI_U256_LENGTH,
+                        std::begin(new_virtual_balance.amount.data));
+
+                    new_balance.index = allocate_virtual_balance();
+                    virtual_balances[new_balance.index].balance = new_virtual_balance;
+                    mark_dirty(&virtual_balances[new_balance.index], sizeof(cma_ledger_virtual_balance_slot_t));
+                    break;
                 }
+                case CMA_LEDGER_BALANCE_TYPE_WITHDRAWABLE: {
+                    auto new_index = last_balances.size();
+                    new_balance.index = static_cast<uint32_t>(new_index);
+                    cma_ledger_account_balance_t *new_withdrawable_balance = &balances[new_index];
+                    // uint32_t type;
+                    new_withdrawable_balance->type = static_cast<uint32_t>(asset->type);
+                    // cma_abi_address_t owner;
+                    std::ignore = std::copy_n(std::begin(account_cold[account_id].address.data),
+                        CMA_ABI_ADDRESS_LENGTH, std::begin(new_withdrawable_balance->owner.data));
+
+                    // cma_amount_t amount;
+                    std::ignore = std::copy_n(std::begin(balance.data), CMA_ABI_U256_LENGTH,
+                        std::begin(new_withdrawable_balance->amount.data));
+
+                    switch (asset->type) {
+                        case CMA_LEDGER_ASSET_TYPE_ID:
+                        case CMA_LEDGER_ASSET_TYPE_BASE: {
+                            break;
+                        }
+                        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS: {
+                            // cma_token_address_t token;
+                            std::ignore = std::copy_n(std::begin(asset_cold[asset_id].token_address.data),
+                                CMA_ABI_ADDRESS_LENGTH, std::begin(new_withdrawable_balance->token_address.data));
+                            break;
+                        }
+                        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID:
+                        case CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID_AMOUNT: {
+                            // cma_token_address_t token;
+                            std::ignore = std::copy_n(std::begin(asset_cold[asset_id].token_address.data),
+                                CMA_ABI_ADDRESS_LENGTH, std::begin(new_withdrawable_balance->token_address.data));
+                            // cma_token_id_t token_id;
+                            std::ignore = std::copy_n(std::begin(asset_cold[asset_id].token_id.data),
+                                CMA_ABI_ID_LENGTH, std::begin(new_withdrawable_balance->token_id.data));
+                            break;
+                        }
+                        default: {
+                            // shouldn't be here (wrongly added to map)
+                            throw CmaException("Invalid asset type", -EINVAL);
+                        }
+                    }
 
-                new_balance.withdrawable_balance = new_withdrawable_balance;
-                last_balances.push_back({asset_id, account_id});
-                break;
+                    mark_dirty(new_withdrawable_balance, sizeof(cma_ledger_account_balance_t));
+                    push_last_balance(balance_key);
+                    break;
+                }
+                default:
+                    throw CmaException("Invalid balance type", -EINVAL);
             }
-            default:
-                throw CmaException("Invalid balance type", -EINVAL);
-        }
-
-        cma_map_key_t balance_key = {asset_id, account_id};
-        auto insertion_result = account_asset_balance.emplace(balance_key, new_balance);
-        if (!insertion_result.second) {
-            // shouldn't be here
-            throw CmaException("Balance already exists", CMA_LEDGER_ERROR_INSERTION_ERROR);
+        } catch (...) {
+            if (balance_type == CMA_LEDGER_BALANCE_TYPE_WITHDRAWABLE) {
+                // positions past the last balance stay zeroed
+                std::ignore = std::fill_n(reinterpret_cast<uint8_t *>(&balances[new_balance.index]),
+                    sizeof(cma_ledger_account_balance_t), (uint8_t) 0);
+            }
+            erase_entry(account_asset_balance, balance_slot);
+            throw;
         }
-        account_find_result->second.n_balances++;
+        link_balance(asset_id, account_id, *asset, *account, new_balance);
 
         return;
     }
 
+    cma_balance_t *balance_entry = &balance_slot->second;
+    if (journaling()) {
+        undo_journal.push_back({.type = CMA_LEDGER_UNDO_BALANCE,
+            .asset_id = asset_id,
+            .account_id = account_id,
+            .amount = get_balance_amount(*balance_entry)});
+    }
+
     auto no_balance = is_zero(balance);
+    if (no_balance) {
+        // find asset and account
+        if (asset == nullptr) {
+            asset = lookup_asset(asset_id);
+            if (asset == nullptr) {
+                throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+            }
+        }
+        if (account == nullptr) {
+            account = lookup_account(account_id);
+            if (account == nullptr) {
+                throw CmaException("Account by id not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+            }
+        }
+    }
 
-    switch (find_result->second.type) {
+    switch (balance_entry->type) {
         case CMA_LEDGER_BALANCE_TYPE_VIRTUAL: {
             std::ignore = std::copy_n(std::begin(balance.data), CMA_ABI_U256_LENGTH,
-                std::begin(find_result->second.virtual_balance->amount.data));
+                std::begin(virtual_balances[balance_entry->index].balance.amount.data));
+            mark_dirty(&virtual_balances[balance_entry->index], sizeof(cma_ledger_account_virtual_balance_t));
             if (no_balance) {
-                // find account
-                auto account_find_result = laccid_to_account.find(account_id);
-                if (account_find_result == laccid_to_account.end()) {
-                    throw CmaException("Account by id not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
-                }
-
-                // transfer last to current
-                if (account_asset_balance.size() > 1) {
-                    // copy last balance from list to current position
-                    if (last_virtual_balances.empty()) {
-                        // shouldn't be here
-                        throw CmaException("Last virtual balance key not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
-                    }
-                    auto last_virtual_balance = last_virtual_balances.back();
-                    auto find_result_last = account_asset_balance.find(last_virtual_balance);
-                    if (find_result_last == account_asset_balance.end()) {
-                        // shouldn't be here
-                        throw CmaException("Last virtual balance not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
-                    }
-                    auto current_virtual_balance = interprocess::find(last_virtual_balances,find_result->first);
-                    if (current_virtual_balance == last_virtual_balances.end()) {
-                        throw CmaException("Coundn't find current virtual balance", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
-                    }
+                // update number of balances and holders
+                unlink_balance(asset_id, account_id, *asset, *account, *balance_entry);
 
-                    // copy the last balance to current position
-                    std::ignore = std::copy_n(std::begin(find_result_last->second.virtual_balance->amount.data),
-                        CMA_ABI_U256_LENGTH, std::begin(find_result->second.virtual_balance->amount.data));
-
-                    // point last balance to current position
-                    find_result_last->second.virtual_balance = find_result->second.virtual_balance;
-                    current_virtual_balance->first = last_virtual_balance.first;
-                    current_virtual_balance->second = last_virtual_balance.second;
-                }
-                // update number of balances
-                account_find_result->second.n_balances--;
+                // return the slot to the pool, other virtual balances don't move
+                free_virtual_balance(balance_entry->index);
 
-                // remove last balance from lists
-                last_virtual_balances.pop_back();
-                virtual_balances.pop_back();
-
-                // remove last balance
-                if (account_asset_balance.erase(find_result->first) == 0) {
-                    throw CmaException("Coundn't erase virtual balance", CMA_LEDGER_ERROR_REMOVE);
-                }
+                // remove the balance where it was found
+                erase_entry(account_asset_balance, balance_slot);
             }
             break;
         }
         case CMA_LEDGER_BALANCE_TYPE_WITHDRAWABLE: {
             std::ignore = std::copy_n(std::begin(balance.data), CMA_ABI_U256_LENGTH,
-                std::begin(find_result->second.withdrawable_balance->amount.data));
+                std::begin(balances[balance_entry->index].amount.data));
+            mark_dirty(&balances[balance_entry->index], sizeof(cma_ledger_account_balance_t));
             if (no_balance) {
-                // find account
-                auto account_find_result = laccid_to_account.find(account_id);
-                if (account_find_result == laccid_to_account.end()) {
-                    throw CmaException("Account by id not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+                // transfer last to current (the back-index locates the current key without a scan)
+                if (balance_entry->index >= last_balances.size() || last_balances[balance_entry->index] != balance_key) {
+                    throw CmaException("Coundn't find current balance", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
                 }
-
-                // transfer last to current
-                if (account_asset_balance.size() > 1) {
-                    // copy last balance from list to current position
-                    if (last_balances.empty()) {
-                        // shouldn't be here
-                        throw CmaException("Last balance key not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
-                    }
-                    auto last_balance = last_balances.back();
+                auto last_balance = last_balances.back();
+                if (last_balance != balance_key) {
                     auto find_result_last = account_asset_balance.find(last_balance);
                     if (find_result_last == account_asset_balance.end()) {
                         // shouldn't be here
                         throw CmaException("Last balance not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
                     }
 
-                    auto current_balance = interprocess::find(last_balances,find_result->first);
-                    if (current_balance == last_balances.end()) {
-                        throw CmaException("Coundn't find current balance", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
-                    }
-
                     // copy the last balance to current position
-                    if (last_balance.first != find_result->first.first || last_balance.second != find_result->first.second) {
-                        find_result->second.withdrawable_balance->type =
-                            find_result_last->second.withdrawable_balance->type;
-                        std::ignore = std::copy_n(std::begin(find_result_last->second.withdrawable_balance->owner.data),
-                            CMA_ABI_ADDRESS_LENGTH, std::begin(find_result->second.withdrawable_balance->owner.data));
-                        std::ignore =
-                            std::copy_n(std::begin(find_result_last->second.withdrawable_balance->token_address.data),
-                                CMA_ABI_ADDRESS_LENGTH,
-                                std::begin(find_result->second.withdrawable_balance->token_address.data));
-                        std::ignore = std::copy_n(std::begin(find_result_last->second.withdrawable_balance->token_id.data),
-                            CMA_ABI_ID_LENGTH, std::begin(find_result->second.withdrawable_balance->token_id.data));
-                        std::ignore = std::copy_n(std::begin(find_result_last->second.withdrawable_balance->amount.data),
-                            CMA_ABI_U256_LENGTH, std::begin(find_result->second.withdrawable_balance->amount.data));
-                    }
+                    balances[balance_entry->index].type = balances[find_result_last->second.index].type;
+                    std::ignore = std::copy_n(std::begin(balances[find_result_last->second.index].owner.data),
+                        CMA_ABI_ADDRESS_LENGTH, std::begin(balances[balance_entry->index].owner.data));
+                    std::ignore =
+                        std::copy_n(std::begin(balances[find_result_last->second.index].token_address.data),
+                            CMA_ABI_ADDRESS_LENGTH, std::begin(balances[balance_entry->index].token_address.data));
+                    std::ignore = std::copy_n(std::begin(balances[find_result_last->second.index].token_id.data),
+                        CMA_ABI_ID_LENGTH, std::begin(balances[balance_entry->index].token_id.data));
+                    std::ignore = std::copy_n(std::begin(balances[find_result_last->second.index].amount.data),
+                        CMA_ABI_U256_LENGTH, std::begin(balances[balance_entry->index].amount.data));
 
                     // nullify last position
                     std::ignore =
-                        std::fill_n(reinterpret_cast<uint8_t *>(find_result_last->second.withdrawable_balance.get()),
+                        std::fill_n(reinterpret_cast<uint8_t *>(&balances[find_result_last->second.index]),
                             sizeof(cma_ledger_account_balance_t), (uint8_t) 0);
+                    mark_dirty(&balances[find_result_last->second.index],
+                        sizeof(cma_ledger_account_balance_t));
 
                     // point last balance to current position
-                    find_result_last->second.withdrawable_balance = find_result->second.withdrawable_balance;
-                    current_balance->first = last_balance.first;
-                    current_balance->second = last_balance.second;
+                    find_result_last->second.index = balance_entry->index;
+                    mark_dirty(&find_result_last->second, sizeof(cma_balance_t));
+                    last_balances[balance_entry->index] = last_balance;
+                    mark_dirty(&last_balances[balance_entry->index], sizeof(cma_map_key_t));
                 } else {
                     // nullify current position (is single in balance)
-                    std::ignore = std::fill_n(reinterpret_cast<uint8_t *>(find_result->second.withdrawable_balance.get()),
+                    std::ignore = std::fill_n(reinterpret_cast<uint8_t *>(&balances[balance_entry->index]),
                         sizeof(cma_ledger_account_balance_t), (uint8_t) 0);
                 }
-                // update number of balances
-                account_find_result->second.n_balances--;
+                // update number of balances and holders
+                unlink_balance(asset_id, account_id, *asset, *account, *balance_entry);
 
                 // remove last balance from lists
                 last_balances.pop_back();
+                mark_dirty(&last_balances, sizeof(last_balances));
 
-                // remove last balance
-                if (account_asset_balance.erase(find_result->first) == 0) {
-                    throw CmaException("Coundn't erase balance", CMA_LEDGER_ERROR_REMOVE);
-                }
+                // remove the balance where it was found
+                erase_entry(account_asset_balance, balance_slot);
             }
             break;
         }
@@ -1580,32 +3019,37 @@ void cma_ledger_memory::set_account_asset_balance(cma_ledger_asset_id_t asset_id
 
 void cma_ledger_memory::deposit(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t to_account_id,
     const cma_amount_t &deposit) {
+    reserve_wal(1);
+    // each key is looked up once, the updates work on the entries found
     // 1: check asset
     if (is_zero(deposit)) {
         throw CmaException("Can't deposit zero", CMA_LEDGER_ERROR_BALANCE_OVERFLOW);
     }
-    cma_amount_t curr_supply = {};
-    cma_ledger_asset_type_t asset_type;
-    if (!find_asset(asset_id, &asset_type, nullptr, nullptr, &curr_supply)) {
+    auto *asset = lookup_asset(asset_id);
+    if (asset == nullptr) {
         throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
     }
 
     cma_amount_t new_supply = {};
-    if (!amount_checked_add(new_supply, curr_supply, deposit)) {
+    if (!amount_checked_add(new_supply, asset->supply, deposit)) {
         throw CmaException("Asset supply overflow", CMA_LEDGER_ERROR_SUPPLY_OVERFLOW);
     }
-    if (asset_type == CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID &&
-            (!is_zero(curr_supply) || !is_one(deposit) )) {
+    if (asset->type == CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID &&
+            (!is_zero(asset->supply) || !is_one(deposit) )) {
         throw CmaException("Can't deposit type id asset and end with higher amounts than 1", CMA_LEDGER_ERROR_SUPPLY_OVERFLOW);
     }
 
     // 2: check account
-    if (!cma_ledger_memory::find_account(to_account_id, nullptr, nullptr)) {
+    auto *account = lookup_account(to_account_id);
+    if (account == nullptr) {
         throw CmaException("Account by id not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
     }
-    // 3: check amount
+    // 3: check amount (a missing balance is reserved by the same probe, a new one can't overflow)
+    auto [balance_slot, reserved] = reserve_balance(asset_id, to_account_id);
     cma_amount_t curr_balance = {};
-    get_account_asset_balance(asset_id, to_account_id, &curr_balance, nullptr);
+    if (!reserved && balance_slot != account_asset_balance.end()) {
+        curr_balance = get_balance_amount(balance_slot->second);
+    }
 
     cma_amount_t new_balance = {};
     if (!amount_checked_add(new_balance, curr_balance, deposit)) {
@@ -1613,36 +3057,46 @@ void cma_ledger_memory::deposit(cma_ledger_asset_id_t asset_id, cma_ledger_accou
     }
 
     // 4: update account balance
-    set_account_asset_balance(asset_id, to_account_id, new_balance);
+    store_balance(asset_id, to_account_id, balance_slot, reserved, asset, account, new_balance);
 
     // 5: update asset supply
-    set_asset_supply(asset_id, new_supply);
-
-    // 6: flush
-    if (m_region.get_address() != nullptr) {
-        m_region.flush();
-    }
+    store_supply(asset_id, *asset, new_supply);
+
+    // 6: log and flush
+    cma_ledger_wal_record_t record = {
+        .op = CMA_LEDGER_WAL_OP_DEPOSIT,
+        .asset_id = asset_id,
+        .to_account_id = to_account_id,
+        .to_balance = new_balance,
+        .supply = new_supply,
+    };
+    log_operation(&record, 1);
 }
 
 void cma_ledger_memory::withdraw(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t from_account_id,
     const cma_amount_t &withdrawal) {
+    reserve_wal(1);
     // 1: check asset
-    cma_amount_t curr_supply = {};
-    if (!find_asset(asset_id, nullptr, nullptr, nullptr, &curr_supply)) {
+    auto *asset = lookup_asset(asset_id);
+    if (asset == nullptr) {
         throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
     }
 
     cma_amount_t new_supply = {};
-    if (!amount_checked_sub(new_supply, curr_supply, withdrawal)) {
+    if (!amount_checked_sub(new_supply, asset->supply, withdrawal)) {
         throw CmaException("Asset supply underflow", CMA_LEDGER_ERROR_SUPPLY_OVERFLOW);
     }
     // 2: check account
-    if (!cma_ledger_memory::find_account(from_account_id, nullptr, nullptr)) {
+    auto *account = lookup_account(from_account_id);
+    if (account == nullptr) {
         throw CmaException("Account by id not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
     }
     // 3: check amount
+    auto balance_slot = find_balance(asset_id, from_account_id);
     cma_amount_t curr_balance = {};
-    get_account_asset_balance(asset_id, from_account_id, &curr_balance, nullptr);
+    if (balance_slot != account_asset_balance.end()) {
+        curr_balance = get_balance_amount(balance_slot->second);
+    }
 
     cma_amount_t new_balance = {};
     if (!amount_checked_sub(new_balance, curr_balance, withdrawal)) {
@@ -1650,24 +3104,30 @@ void cma_ledger_memory::withdraw(cma_ledger_asset_id_t asset_id, cma_ledger_acco
     }
 
     // 4: update account balance
-    set_account_asset_balance(asset_id, from_account_id, new_balance);
+    store_balance(asset_id, from_account_id, balance_slot, false, asset, account, new_balance);
 
     // 5: update asset supply
-    set_asset_supply(asset_id, new_supply);
-
-    // 6: flush
-    if (m_region.get_address() != nullptr) {
-        m_region.flush();
-    }
+    store_supply(asset_id, *asset, new_supply);
+
+    // 6: log and flush
+    cma_ledger_wal_record_t record = {
+        .op = CMA_LEDGER_WAL_OP_WITHDRAW,
+        .asset_id = asset_id,
+        .from_account_id = from_account_id,
+        .from_balance = new_balance,
+        .supply = new_supply,
+    };
+    log_operation(&record, 1);
 
     // TODO: cleanup asset with not supply and account with no balance
 }
 
 void cma_ledger_memory::transfer(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t from_account_id,
     cma_ledger_account_id_t to_account_id, const cma_amount_t &amount) {
+    reserve_wal(1);
     // 1: check asset
-    cma_amount_t curr_supply = {};
-    if (!find_asset(asset_id, nullptr, nullptr, nullptr, &curr_supply)) {
+    auto *asset = lookup_asset(asset_id);
+    if (asset == nullptr) {
         throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
     }
 
@@ -1675,12 +3135,16 @@ void cma_ledger_memory::transfer(cma_ledger_asset_id_t asset_id, cma_ledger_acco
     if (from_account_id == to_account_id) {
         throw CmaException("Account from equal to account to", -EINVAL);
     }
-    if (!cma_ledger_memory::find_account(from_account_id, nullptr, nullptr)) {
+    auto *from_account = lookup_account(from_account_id);
+    if (from_account == nullptr) {
         throw CmaException("Account from not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
     }
     // 3: check amount from
+    auto from_balance_slot = find_balance(asset_id, from_account_id);
     cma_amount_t curr_balance_from = {};
-    get_account_asset_balance(asset_id, from_account_id, &curr_balance_from, nullptr);
+    if (from_balance_slot != account_asset_balance.end()) {
+        curr_balance_from = get_balance_amount(from_balance_slot->second);
+    }
 
     cma_amount_t new_balance_from = {};
     if (!amount_checked_sub(new_balance_from, curr_balance_from, amount)) {
@@ -1688,26 +3152,168 @@ void cma_ledger_memory::transfer(cma_ledger_asset_id_t asset_id, cma_ledger_acco
     }
 
     // 4: check account to
-    if (!cma_ledger_memory::find_account(to_account_id, nullptr, nullptr)) {
+    auto *to_account = lookup_account(to_account_id);
+    if (to_account == nullptr) {
         throw CmaException("Account to not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
     }
-    // 5: check amount to
+    // 5: check amount to (a missing balance is reserved by the same probe, a new one can't overflow; reserving moves
+    // the entries when the table makes room, the source is found again then)
+    const bool moves_entries = account_asset_balance.growth_left() == 0;
+    auto [to_balance_slot, to_reserved] = reserve_balance(asset_id, to_account_id);
+    if (to_reserved && moves_entries) {
+        from_balance_slot = find_balance(asset_id, from_account_id);
+    }
     cma_amount_t curr_balance_to = {};
-    get_account_asset_balance(asset_id, to_account_id, &curr_balance_to, nullptr);
+    if (!to_reserved && to_balance_slot != account_asset_balance.end()) {
+        curr_balance_to = get_balance_amount(to_balance_slot->second);
+    }
 
     cma_amount_t new_balance_to = {};
     if (!amount_checked_add(new_balance_to, curr_balance_to, amount)) {
         throw CmaException("Balance overflow", CMA_LEDGER_ERROR_BALANCE_OVERFLOW);
     }
 
-    // 6: update account balances
-    set_account_asset_balance(asset_id, from_account_id, new_balance_from);
-    set_account_asset_balance(asset_id, to_account_id, new_balance_to);
+    // 6: update account balances (erasing doesn't move other entries, so the destination entry stays valid when the
+    // source one is removed; a destination missing at the max balances is only created after the source is stored)
+    const bool from_missing = from_balance_slot == account_asset_balance.end();
+    try {
+        store_balance(asset_id, from_account_id, from_balance_slot, false, asset, from_account, new_balance_from);
+    } catch (...) {
+        if (to_reserved) {
+            erase_entry(account_asset_balance, to_balance_slot);
+        }
+        throw;
+    }
+    if (to_reserved && from_missing) {
+        // a zero transfer from a missing balance inserted it, which may have moved the reserved destination
+        to_balance_slot = find_balance(asset_id, to_account_id);
+    }
+    store_balance(asset_id, to_account_id, to_balance_slot, to_reserved, asset, to_account, new_balance_to);
+
+    // 7: log and flush
+    cma_ledger_wal_record_t record = {
+        .op = CMA_LEDGER_WAL_OP_TRANSFER,
+        .asset_id = asset_id,
+        .from_account_id = from_account_id,
+        .to_account_id = to_account_id,
+        .from_balance = new_balance_from,
+        .to_balance = new_balance_to,
+    };
+    log_operation(&record, 1);
+}
+
+void cma_ledger_memory::set_account_asset_balances(const std::vector<cma_ledger_balance_update_t> &updates) {
+    // check capacity up front, so either all balances are set or none is
+    size_t n_created = 0;
+    size_t n_removed = 0;
+    for (const auto &[key, balance] : updates) {
+        const bool exists = account_asset_balance.contains(key);
+        const bool no_balance = is_zero(balance);
+        if (!exists && !no_balance) {
+            ++n_created;
+        } else if (exists && no_balance) {
+            ++n_removed;
+        }
+    }
+    if (account_asset_balance.size() - n_removed + n_created > max_balances) {
+        throw CmaException("Max balances reached", CMA_LEDGER_ERROR_MAX_BALANCES_REACHED);
+    }
+
+    // the updates are journaled, so a failure midway (e.g. a table that can't grow when the ledger memory is full)
+    // undoes the balances already set
+    reserve_wal(updates.size());
+    const bool own_transaction = !transaction_open;
+    if (own_transaction) {
+        begin();
+    }
+    const cma_ledger_savepoint_t updates_savepoint = savepoint();
+    std::vector<cma_ledger_wal_record_t> records;
+    try {
+        records.reserve(updates.size());
+        for (const auto &[key, balance] : updates) {
+            set_account_asset_balance(balance_key_asset_id(key), balance_key_account_id(key), balance);
+            records.push_back({
+                .op = CMA_LEDGER_WAL_OP_BALANCE,
+                .asset_id = balance_key_asset_id(key),
+                .to_account_id = balance_key_account_id(key),
+                .to_balance = balance,
+            });
+        }
+    } catch (...) {
+        if (own_transaction) {
+            rollback();
+        } else {
+            rollback_to(updates_savepoint);
+        }
+        throw;
+    }
+    if (own_transaction) {
+        // the transaction only guards the updates, they are logged and flushed as any single operation
+        cma_ledger_base::commit();
+        undo_journal.clear();
+    }
+
+    // log and flush once
+    log_operation(records.data(), records.size());
+}
+
+auto cma_ledger_memory::list_account_balances(cma_ledger_account_id_t account_id, cma_ledger_asset_balance_t *out,
+    size_t cap) -> size_t {
+    const auto *account = lookup_account(account_id);
+    if (account == nullptr) {
+        throw CmaException("Account by id not found", CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+    }
+    size_t n_listed = 0;
+    for (uint32_t asset_id = account->first_asset_id; asset_id != BALANCE_LINK_NONE && n_listed < cap;) {
+        const auto *balance_entry = lookup_balance(asset_id, account_id);
+        if (balance_entry == nullptr) {
+            throw CmaException("Listed balance not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+        }
+        out[n_listed++] = {.asset_id = asset_id, .amount = get_balance_amount(*balance_entry)};
+        asset_id = balance_entry->next_asset_id;
+    }
+    return account->n_balances;
+}
+
+auto cma_ledger_memory::get_owner(cma_ledger_asset_id_t asset_id) -> cma_ledger_account_id_t {
+    const auto *asset = lookup_asset(asset_id);
+    if (asset == nullptr) {
+        throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+    }
+    if (asset->type != CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID) {
+        throw CmaException("Asset may have several owners", -EINVAL);
+    }
+    if (asset->owner_account_id == OWNER_NONE) {
+        throw CmaException("Asset has no owner", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+    }
+    return asset->owner_account_id;
+}
 
-    // 6: flush
-    if (m_region.get_address() != nullptr) {
-        m_region.flush();
+auto cma_ledger_memory::list_asset_holders(cma_ledger_asset_id_t asset_id,
+    const cma_ledger_account_id_t *after_account_id, cma_ledger_holder_balance_t *out, size_t cap) -> size_t {
+    const auto *asset = lookup_asset(asset_id);
+    if (asset == nullptr) {
+        throw CmaException("Asset by id not found", CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+    }
+    // a page resumes from the holder link of the cursor balance, the holders before it aren't walked again
+    uint32_t account_id = asset->first_account_id;
+    if (after_account_id != nullptr) {
+        const auto *cursor_entry = lookup_balance(asset_id, *after_account_id);
+        if (cursor_entry == nullptr) {
+            throw CmaException("Cursor holder not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+        }
+        account_id = cursor_entry->next_account_id;
     }
+    size_t n_listed = 0;
+    while (account_id != BALANCE_LINK_NONE && n_listed < cap) {
+        const auto *balance_entry = lookup_balance(asset_id, account_id);
+        if (balance_entry == nullptr) {
+            throw CmaException("Listed holder not found", CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+        }
+        out[n_listed++] = {.account_id = account_id, .amount = get_balance_amount(*balance_entry)};
+        account_id = balance_entry->next_account_id;
+    }
+    return asset->n_holders;
 }
 
 auto cma_ledger_memory::get_balances() -> cma_ledger_account_balance_t * {
@@ -1721,3 +3327,7 @@ auto cma_ledger_memory::get_balances_size() -> size_t {
 auto cma_ledger_memory::get_mem_offset() -> size_t {
     return mem_offset;
 }
+
+auto cma_ledger_memory::get_dirty_ranges_count() -> size_t {
+    return n_dirty_ranges;
+}
@@ -1,10 +1,18 @@
 #ifndef CMA_LEDGER_IMPL_H
 #define CMA_LEDGER_IMPL_H
 
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <string> // for string class
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 extern "C" {
 #include "libcma/ledger.h"
@@ -25,9 +33,22 @@ enum : uint8_t {
 
 enum : uint64_t {
     CMA_LEDGER_MAGIC = 0x6de6c7b338afbad6,
-    CMA_HASH_PAIR_CTE = 0x9e3779b9,
-    CMA_HASH_PAIR_LSHIFT = 6,
-    CMA_HASH_PAIR_RSHIFT = 2,
+    CMA_LEDGER_WAL_MAGIC = 0x4c41572d414d4332,
+    CMA_LEDGER_LAYOUT_VERSION = 1, ///< Objects kept in the ledger memory, bumped whenever any of them changes
+    CMA_BALANCE_KEY_ID_BITS = 32,
+    CMA_HASH_MIX_SHIFT1 = 30,
+    CMA_HASH_MIX_MUL1 = 0xbf58476d1ce4e5b9,
+    CMA_HASH_MIX_SHIFT2 = 27,
+    CMA_HASH_MIX_MUL2 = 0x94d049bb133111eb,
+    CMA_HASH_MIX_SHIFT3 = 31,
+    CMA_SIPHASH_INIT0 = 0x736f6d6570736575,
+    CMA_SIPHASH_INIT1 = 0x646f72616e646f6d,
+    CMA_SIPHASH_INIT2 = 0x6c7967656e657261,
+    CMA_SIPHASH_INIT3 = 0x7465646279746573,
+    CMA_SIPHASH_FINAL = 0xff,
+    CMA_SIPHASH_LENGTH_SHIFT = 56,
+    CMA_SIPHASH_COMPRESSION_ROUNDS = 1,
+    CMA_SIPHASH_FINAL_ROUNDS = 3,
 };
 
 using cma_ledger_asset_struct_t = struct cma_ledger_asset_struct {
@@ -44,27 +65,146 @@ using cma_ledger_asset_struct_t = struct cma_ledger_asset_struct {
 //     cma_amount_t supply;
 // };
 
-struct hash_pair {
-    template <class T1, class T2>
-    auto operator()(const std::pair<T1, T2> &pair_ref) const -> size_t {
-        const size_t hash1 = std::hash<T1>{}(pair_ref.first);
-        const size_t hash2 = std::hash<T2>{}(pair_ref.second);
-        return hash1 ^ (hash2 + CMA_HASH_PAIR_CTE + (hash1 << CMA_HASH_PAIR_LSHIFT) + (hash1 >> CMA_HASH_PAIR_RSHIFT));
+using cma_ledger_asset_key_bytes_t = std::array<uint8_t, CMA_LEDGER_ASSET_MAP_KEY_SIZE>;
+
+// Balance key, the asset id in the high half and the account id in the low half. Ids are below the max limits,
+// which are capped to 32 bits, so larger ids saturate to an id that is never allocated and has no entry.
+using cma_map_key_t = uint64_t;
+
+inline auto make_balance_key(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id) -> cma_map_key_t {
+    constexpr uint64_t max_id = std::numeric_limits<uint32_t>::max();
+    return (std::min(asset_id, max_id) << CMA_BALANCE_KEY_ID_BITS) | std::min(account_id, max_id);
+}
+
+inline auto balance_key_asset_id(cma_map_key_t key) -> cma_ledger_asset_id_t {
+    return key >> CMA_BALANCE_KEY_ID_BITS;
+}
+
+inline auto balance_key_account_id(cma_map_key_t key) -> cma_ledger_account_id_t {
+    return key & std::numeric_limits<uint32_t>::max();
+}
+
+// Deterministic mixer (splitmix64 finalizer), spreads keys built from sequential ids over the whole hash range
+inline auto mix_hash(uint64_t hash) -> uint64_t {
+    hash = (hash ^ (hash >> CMA_HASH_MIX_SHIFT1)) * CMA_HASH_MIX_MUL1;
+    hash = (hash ^ (hash >> CMA_HASH_MIX_SHIFT2)) * CMA_HASH_MIX_MUL2;
+    return hash ^ (hash >> CMA_HASH_MIX_SHIFT3);
+}
+
+struct hash_balance_key {
+    using is_avalanching = std::true_type; ///< No further post-mixing needed by the tables
+
+    auto operator()(cma_map_key_t key) const noexcept -> size_t {
+        return mix_hash(key);
     }
 };
 
-using cma_ledger_asset_key_bytes_t = std::array<uint8_t, CMA_LEDGER_ASSET_MAP_KEY_SIZE>;
+// 128-bit key of the hashes of user supplied keys, given right after the ledger is created (all zero otherwise) and
+// stored with it
+using cma_hash_seed_t = struct cma_hash_seed {
+    uint64_t k0;
+    uint64_t k1;
+};
+
+// SipHash state, one round mixes the four lanes
+struct siphash_state {
+    uint64_t v0;
+    uint64_t v1;
+    uint64_t v2;
+    uint64_t v3;
+
+    void round() {
+        v0 += v1;
+        v1 = std::rotl(v1, 13) ^ v0;
+        v0 = std::rotl(v0, 32);
+        v2 += v3;
+        v3 = std::rotl(v3, 16) ^ v2;
+        v0 += v3;
+        v3 = std::rotl(v3, 21) ^ v0;
+        v2 += v1;
+        v1 = std::rotl(v1, 17) ^ v2;
+        v2 = std::rotl(v2, 32);
+    }
+
+    template <size_t Rounds>
+    void compress(uint64_t word) {
+        v3 ^= word;
+        for (size_t i = 0; i < Rounds; ++i) {
+            round();
+        }
+        v0 ^= word;
+    }
+};
 
-using cma_map_key_t = std::pair<cma_ledger_account_id_t, cma_ledger_asset_id_t>;
+// Keyed hash (SipHash-1-3 unless other rounds are given) of fixed size key bytes (account and asset keys), read as
+// little-endian 64-bit words. Keys come from user controlled addresses and ids: without the secret seed colliding keys
+// can't be precomputed, so probe lengths stay short under adversarial input. The result only depends on the seed and
+// the key bytes.
+template <size_t N, size_t CompressionRounds = CMA_SIPHASH_COMPRESSION_ROUNDS,
+    size_t FinalRounds = CMA_SIPHASH_FINAL_ROUNDS>
+struct hash_key_bytes {
+    using is_avalanching = std::true_type; ///< No further post-mixing needed by the tables
+
+    cma_hash_seed_t seed{};
+
+    auto operator()(const std::array<uint8_t, N> &key) const noexcept -> size_t {
+        siphash_state state{seed.k0 ^ CMA_SIPHASH_INIT0, seed.k1 ^ CMA_SIPHASH_INIT1, seed.k0 ^ CMA_SIPHASH_INIT2,
+            seed.k1 ^ CMA_SIPHASH_INIT3};
+        constexpr size_t tail = N % sizeof(uint64_t);
+        for (size_t offset = 0; offset < N - tail; offset += sizeof(uint64_t)) {
+            uint64_t word = 0;
+            std::memcpy(&word, key.data() + offset, sizeof(uint64_t));
+            state.compress<CompressionRounds>(word);
+        }
+        uint64_t last = static_cast<uint64_t>(N) << CMA_SIPHASH_LENGTH_SHIFT;
+        if constexpr (tail != 0) {
+            uint64_t word = 0;
+            std::memcpy(&word, key.data() + N - tail, tail);
+            last |= word;
+        }
+        state.compress<CompressionRounds>(last);
+        state.v2 ^= CMA_SIPHASH_FINAL;
+        for (size_t i = 0; i < FinalRounds; ++i) {
+            state.round();
+        }
+        return state.v0 ^ state.v1 ^ state.v2 ^ state.v3;
+    }
+};
+
+// Position inside an open transaction that can be rolled back to
+using cma_ledger_savepoint_t = struct cma_ledger_savepoint {
+    size_t journal_size;
+    size_t wal_tail;
+    bool wal_pending;
+};
+
+// Final balance of an account asset
+using cma_ledger_balance_update_t = std::pair<cma_map_key_t, cma_amount_t>;
 
 class cma_ledger_base {
 private:
     uint64_t magic = CMA_LEDGER_MAGIC;
 
+protected:
+    bool transaction_open = false;
+    cma_ledger_flush_policy_t flush_policy = CMA_LEDGER_FLUSH_PER_OP;
+
 public:
-    ~cma_ledger_base();
+    virtual ~cma_ledger_base();
 
     [[nodiscard]] auto is_initialized() const -> bool;
+    [[nodiscard]] auto in_transaction() const -> bool;
+
+    virtual void begin();
+    virtual void commit();
+    virtual void abort();
+    virtual void rollback();
+    virtual auto savepoint() -> cma_ledger_savepoint_t;
+    virtual void rollback_to(const cma_ledger_savepoint_t &savepoint);
+    virtual void set_flush_policy(cma_ledger_flush_policy_t policy);
+    virtual void checkpoint();
+    virtual void presize();
+    virtual void set_hash_seed(const cma_hash_seed_t &seed);
 
     virtual void clear() = 0;
 
@@ -87,6 +227,12 @@ public:
         cma_amount_t *balance, cma_ledger_account_balance_info_t *account_balance_info) = 0;
     virtual void set_account_asset_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
         const cma_amount_t &balance) = 0;
+    virtual void set_account_asset_balances(const std::vector<cma_ledger_balance_update_t> &updates);
+    virtual auto list_account_balances(cma_ledger_account_id_t account_id, cma_ledger_asset_balance_t *out,
+        size_t cap) -> size_t = 0;
+    virtual auto get_owner(cma_ledger_asset_id_t asset_id) -> cma_ledger_account_id_t = 0;
+    virtual auto list_asset_holders(cma_ledger_asset_id_t asset_id, const cma_ledger_account_id_t *after_account_id,
+        cma_ledger_holder_balance_t *out, size_t cap) -> size_t = 0;
 
     virtual void deposit(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t to_account_id,
         const cma_amount_t &deposit) = 0;
@@ -94,6 +240,12 @@ public:
         const cma_amount_t &withdrawal) = 0;
     virtual void transfer(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t from_account_id,
         cma_ledger_account_id_t to_account_id, const cma_amount_t &amount) = 0;
+
+    void transfer_multi(const cma_ledger_transfer_leg_t *legs, size_t n_legs);
+
+    void apply_op(const cma_ledger_op_t &op);
+    void apply_batch(const cma_ledger_op_t *ops, size_t n_ops, cma_ledger_op_result_t *results,
+        cma_ledger_batch_mode_t mode);
 };
 
 class cma_ledger_basic : public cma_ledger_base {
@@ -104,7 +256,7 @@ private:
     using asset_to_lassid_t = std::unordered_map<cma_ledger_asset_key_t, cma_ledger_asset_id_t>;
     using laccid_to_account_t = std::unordered_map<cma_ledger_account_id_t, cma_ledger_account_t>;
     using account_to_laccid_t = std::unordered_map<cma_ledger_account_key_t, cma_ledger_account_id_t>;
-    using account_asset_map_t = std::unordered_map<cma_map_key_t, cma_amount_t, hash_pair>;
+    using account_asset_map_t = std::unordered_map<cma_map_key_t, cma_amount_t, hash_balance_key>;
 
     lassid_to_asset_t lassid_to_asset;
     asset_to_lassid_t asset_to_lassid;
@@ -135,6 +287,11 @@ public:
         cma_amount_t *balance, cma_ledger_account_balance_info_t *account_balance_info) override;
     void set_account_asset_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
         const cma_amount_t &balance) override;
+    auto list_account_balances(cma_ledger_account_id_t account_id, cma_ledger_asset_balance_t *out, size_t cap)
+        -> size_t override;
+    auto get_owner(cma_ledger_asset_id_t asset_id) -> cma_ledger_account_id_t override;
+    auto list_asset_holders(cma_ledger_asset_id_t asset_id, const cma_ledger_account_id_t *after_account_id,
+        cma_ledger_holder_balance_t *out, size_t cap) -> size_t override;
 
     void deposit(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t to_account_id,
         const cma_amount_t &deposit) override;
@@ -144,6 +301,26 @@ public:
         cma_ledger_account_id_t to_account_id, const cma_amount_t &amount) override;
 };
 
+// Descriptor of the write-ahead log file of a file ledger (-1 when it has no log), closed with the ledger
+class cma_ledger_wal_file {
+    int fd;
+
+public:
+    explicit cma_ledger_wal_file(int wal_fd = -1) : fd(wal_fd) {}
+    ~cma_ledger_wal_file();
+    cma_ledger_wal_file(const cma_ledger_wal_file &) = delete;
+    cma_ledger_wal_file(cma_ledger_wal_file &&) = delete;
+    auto operator=(const cma_ledger_wal_file &) -> cma_ledger_wal_file & = delete;
+    auto operator=(cma_ledger_wal_file &&) -> cma_ledger_wal_file & = delete;
+
+    [[nodiscard]] auto get_fd() const -> int {
+        return fd;
+    }
+    [[nodiscard]] auto is_open() const -> bool {
+        return fd != -1;
+    }
+};
+
 // TODO: remove extra maps
 // TODO: add balance list and non withdrawable balance list
 // TODO: remove account+asset pair map and use pointer to lists
@@ -160,15 +337,17 @@ private:
         cma_amount_t amount;
     };
 
-    using cma_ledger_offset_balance_ptr_t = interprocess::offset_ptr<cma_ledger_account_balance_t>;
-    using cma_ledger_offset_virtual_balance_ptr_t = interprocess::offset_ptr<cma_ledger_account_virtual_balance_t>;
-
+    // Balances are located by 32-bit indices instead of pointers. The balances of an account are chained in a
+    // doubly linked list through their entries, linked by asset id as entries move when the map grows.
     using cma_balance_t = struct cma_balance {
         cma_balance_type_t type;
-        cma_ledger_offset_balance_ptr_t withdrawable_balance;
-        cma_ledger_offset_virtual_balance_ptr_t virtual_balance;
+        uint32_t index; ///< Withdrawable: position in balances and last_balances, virtual: slot of virtual_balances
+        uint32_t prev_asset_id; ///< Previous balance of the account (BALANCE_LINK_NONE at the head)
+        uint32_t next_asset_id; ///< Next balance of the account (BALANCE_LINK_NONE at the tail)
+        uint32_t prev_account_id; ///< Previous holder of the asset (BALANCE_LINK_NONE at the head)
+        uint32_t next_account_id; ///< Next holder of the asset (BALANCE_LINK_NONE at the tail)
     };
-    using cma_ledger_offset_balance_struct_ptr_t = interprocess::offset_ptr<cma_balance_t>;
+    static constexpr uint32_t BALANCE_LINK_NONE = std::numeric_limits<uint32_t>::max();
     // using cma_ledger_balance_set_t = interprocess::unordered_flat_set<cma_map_key_t>;
 
     using cma_ledger_account_struct_t = struct cma_ledger_account_struct {
@@ -176,16 +355,112 @@ private:
         size_t n_balances;
     };
 
+    typedef enum : uint64_t {
+        CMA_LEDGER_WAL_OP_DEPOSIT = 1,
+        CMA_LEDGER_WAL_OP_WITHDRAW,
+        CMA_LEDGER_WAL_OP_TRANSFER,
+        CMA_LEDGER_WAL_OP_BALANCE, ///< Single balance of a multi-leg transfer
+        CMA_LEDGER_WAL_OP_COMMIT,  ///< Ends a group of records, only committed groups are replayed
+        CMA_LEDGER_WAL_OP_CREATE_ASSET,
+        CMA_LEDGER_WAL_OP_REMOVE_ASSET,
+        CMA_LEDGER_WAL_OP_CREATE_ACCOUNT,
+        CMA_LEDGER_WAL_OP_REMOVE_ACCOUNT,
+    } cma_wal_op_t;
+
+    using cma_ledger_wal_header_t = struct cma_ledger_wal_header {
+        uint64_t magic;
+        uint64_t generation; ///< Records of older generations were already checkpointed
+        uint64_t length;
+        uint64_t ledger_offset; ///< Offset of the ledger the log belongs to in the ledger file
+        uint64_t ledger_length;
+    };
+
+    // Every change of the ledger memory is logged (creations and removals included), and the ledger file only holds
+    // checkpointed state, so replaying the committed records over it rebuilds the committed state exactly. Balances
+    // and supplies are logged as after-images.
+    using cma_ledger_wal_record_t = struct cma_ledger_wal_record {
+        uint64_t generation;
+        cma_wal_op_t op;
+        cma_ledger_asset_id_t asset_id;
+        cma_ledger_account_id_t from_account_id;
+        cma_ledger_account_id_t to_account_id;
+        cma_amount_t from_balance;
+        cma_amount_t to_balance;
+        cma_amount_t supply;
+        uint64_t key_type;                 ///< Asset or account type of a creation
+        cma_account_id_t account_key;      ///< Key of a created account
+        cma_token_address_t token_address; ///< Keys of a created asset
+        cma_token_id_t token_id;
+        uint8_t padding[4];
+        uint64_t checksum;
+    };
+
+    typedef enum {
+        CMA_LEDGER_UNDO_BALANCE,
+        CMA_LEDGER_UNDO_SUPPLY,
+        CMA_LEDGER_UNDO_ASSET_CREATED,
+        CMA_LEDGER_UNDO_ASSET_REMOVED,
+        CMA_LEDGER_UNDO_ACCOUNT_CREATED,
+        CMA_LEDGER_UNDO_ACCOUNT_REMOVED,
+    } cma_undo_type_t;
+
+    // Before-image of an entry touched inside a transaction
+    using cma_ledger_undo_entry_t = struct cma_ledger_undo_entry {
+        cma_undo_type_t type;
+        cma_ledger_asset_id_t asset_id;
+        cma_ledger_account_id_t account_id;
+        cma_amount_t amount;                  ///< Balance or supply
+        cma_ledger_asset_struct_t asset;      ///< Removed asset
+        cma_ledger_account_struct_t account;  ///< Removed account
+    };
+
+    // Ids are sequential, so assets and accounts live in dense tables indexed by id. The tables are sized to the
+    // maximums on creation and never reallocate, slots of removed or not yet created ids are tombstones.
+    // Records are split in a hot table, with what every balance change reads or updates, and a cold table with the
+    // keys, only read when creating withdrawable balances or when looking records up.
+    using cma_ledger_asset_hot_t = struct cma_ledger_asset_hot {
+        cma_amount_t supply;
+        cma_ledger_asset_type_t type;
+        uint32_t owner_account_id; ///< Holder of a single supply (token address and id) asset, or OWNER_NONE
+        uint32_t n_holders;
+        uint32_t first_account_id; ///< Head of the holder list of the asset (BALANCE_LINK_NONE when empty)
+        bool live;
+    };
+    static constexpr uint32_t OWNER_NONE = std::numeric_limits<uint32_t>::max();
+    using cma_ledger_asset_cold_t = struct cma_ledger_asset_cold {
+        cma_token_address_t token_address;
+        cma_token_id_t token_id;
+    };
+    using cma_ledger_account_hot_t = struct cma_ledger_account_hot {
+        size_t n_balances;
+        cma_ledger_account_type_t type;
+        uint32_t first_asset_id; ///< Head of the balance list of the account (BALANCE_LINK_NONE when empty)
+        bool live;
+    };
+
     using cma_ledger_account_key_bytes_t = std::array<uint8_t, CMA_ABI_ID_LENGTH>;
-    using lassid_to_asset_t = interprocess::unordered_node_map<cma_ledger_asset_id_t, cma_ledger_asset_struct_t>;
-    using asset_to_lassid_t = interprocess::unordered_node_map<cma_ledger_asset_key_bytes_t, cma_ledger_asset_id_t>;
-    using laccid_to_account_t = interprocess::unordered_node_map<cma_ledger_account_id_t, cma_ledger_account_struct_t>;
+    using asset_hot_table_t = interprocess::vector<cma_ledger_asset_hot_t>;
+    using asset_cold_table_t = interprocess::vector<cma_ledger_asset_cold_t>;
+    // Keyed tables are flat (entries stored inline in the slot array), they relocate entries when growing
+    using asset_key_hash_t = hash_key_bytes<CMA_LEDGER_ASSET_MAP_KEY_SIZE>;
+    using asset_to_lassid_t =
+        interprocess::swar_flat_map<cma_ledger_asset_key_bytes_t, cma_ledger_asset_id_t, asset_key_hash_t>;
+    using account_hot_table_t = interprocess::vector<cma_ledger_account_hot_t>;
+    using account_cold_table_t = interprocess::vector<cma_ledger_account_t>;
+    using account_key_hash_t = hash_key_bytes<CMA_ABI_ID_LENGTH>;
     using account_to_laccid_t =
-        interprocess::unordered_node_map<cma_ledger_account_key_bytes_t, cma_ledger_account_id_t>;
-    using account_asset_map_t = interprocess::unordered_node_map<cma_map_key_t, cma_balance_t, hash_pair>;
+        interprocess::swar_flat_map<cma_ledger_account_key_bytes_t, cma_ledger_account_id_t, account_key_hash_t>;
+    using account_asset_map_t = interprocess::swar_flat_map<cma_map_key_t, cma_balance_t, hash_balance_key>;
 
     // using balance_list_t = cma_ledger_account_balance_t*;
-    using virtual_balance_list_t = interprocess::vector<cma_ledger_account_virtual_balance_t>;
+    // Virtual balances live in a pool sized to max balances on creation, so it never reallocates and the map can
+    // keep pointers to its slots. Free slots are chained through the slots themselves.
+    using cma_ledger_virtual_balance_slot_t = union cma_ledger_virtual_balance_slot {
+        cma_ledger_account_virtual_balance_t balance;
+        size_t next_free; ///< Index of the next free slot while the slot is free
+    };
+    using virtual_balance_pool_t = interprocess::vector<cma_ledger_virtual_balance_slot_t>;
+    static constexpr size_t VIRTUAL_BALANCE_NONE = std::numeric_limits<size_t>::max();
     using balance_key_list_t = interprocess::vector<cma_map_key_t>;
 
     size_t max_accounts;
@@ -194,33 +469,156 @@ private:
     size_t mem_offset;
 
     interprocess::file_mapping m_file;     ///< Mapped file containing the whole ledger state.
+    cma_ledger_wal_file wal_file;          ///< Opened before the mapping, which is private when there is a log.
     interprocess::mapped_region m_region;  ///< Region of the mapped file containing the ledger state.
     cma_ledger_account_balance_t* balances;
     interprocess::managed_memory m_memory; ///< Mapped memory containing the whole ledger state.
+    uint64_t &layout_version; ///< Checked on open before anything else is looked up
     interprocess::void_allocator &m_allocator;
 
     // balance_list_t &balances;
-    virtual_balance_list_t &virtual_balances;
-    lassid_to_asset_t &lassid_to_asset;
+    cma_hash_seed_t &hash_seed; ///< Key of the account and asset key hashes, fixed before the first key is hashed
+    virtual_balance_pool_t &virtual_balances;
+    asset_hot_table_t &asset_hot;
+    asset_cold_table_t &asset_cold;
     asset_to_lassid_t &asset_to_lassid;
-    laccid_to_account_t &laccid_to_account;
+    account_hot_table_t &account_hot;
+    account_cold_table_t &account_cold;
     account_to_laccid_t &account_to_laccid;
     account_asset_map_t &account_asset_balance;
     balance_key_list_t &last_balances;
-    balance_key_list_t &last_virtual_balances;
     cma_ledger_asset_id_t &next_asset_id;
     cma_ledger_account_id_t &next_account_id;
+    size_t &asset_count;   ///< Live entries of asset_hot
+    size_t &account_count; ///< Live entries of account_hot
+    size_t &virtual_free_head; ///< First free slot of virtual_balances (VIRTUAL_BALANCE_NONE when there is none)
+    size_t &virtual_pool_top;  ///< Slots of virtual_balances from this index on were never used
     cma_ledger_asset_id_t &base_asset_id;
     bool &base_asset_id_defined;
+    size_t &wal_length; ///< Length of the write-ahead log (0 when disabled), checkpoints are staged past it
+
+    static constexpr size_t MAX_DIRTY_RANGES = 16;
+    using dirty_range_t = std::pair<size_t, size_t>; ///< [begin, end) page aligned offsets in the mapped region
+    std::array<dirty_range_t, MAX_DIRTY_RANGES> dirty_ranges{};
+    size_t n_dirty_ranges = 0;
+
+    // Dirty pages of a checkpoint, staged in the log file past the records before the ledger file is written, so an
+    // interrupted checkpoint is finished from them when the ledger is opened again
+    using cma_ledger_wal_checkpoint_t = struct cma_ledger_wal_checkpoint {
+        uint64_t generation; ///< Generation the checkpoint ends
+        uint64_t n_ranges;
+        std::array<uint64_t, MAX_DIRTY_RANGES> offsets; ///< Ledger file offsets of the staged bytes
+        std::array<uint64_t, MAX_DIRTY_RANGES> lengths;
+        uint64_t checksum; ///< Of the fields above and the staged bytes
+    };
+
+    uint64_t wal_generation = 0;
+    size_t wal_tail = 0;         ///< Number of records in the current generation
+    bool wal_unsynced = false;
+    bool wal_pending = false;    ///< Records appended after the last commit record
+    bool replaying_wal = false;
+    cma_ledger_savepoint_t begin_savepoint{};
+
+    std::vector<cma_ledger_undo_entry_t> undo_journal; ///< Before-images of the open transaction (process memory)
+    bool rolling_back = false;
+
+    void add_dirty_range(size_t begin, size_t end);
+    void mark_dirty(const void *ptr, size_t length);
+    void mark_counters_dirty();
+    void mark_segment_dirty();
+    void sync_dirty_ranges();
+    void flush();
+
+    static auto open_wal_file(const char *memory_file_name, int memory_fd, bool create, size_t length) -> int;
+    static void finish_checkpoint(int wal_fd, int memory_fd);
+    void open_wal(bool create, size_t length);
+    void write_wal_header(uint64_t generation);
+    void replay_wal();
+    void replay_record(const cma_ledger_wal_record_t &record);
+    void restore_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
+        const cma_amount_t &balance);
+    void reserve_wal(size_t n_records);
+    void append_wal(cma_ledger_wal_record_t &record);
+    void end_wal_group(bool sync);
+    void stage_checkpoint();
+    void write_dirty_ranges();
+    [[nodiscard]] auto get_dirty_range_bytes(const dirty_range_t &range) const -> std::pair<size_t, size_t>;
+    void write_checkpoint();
+    void log_operation(cma_ledger_wal_record_t *records, size_t n_records);
+    void log_asset_change(cma_wal_op_t op, cma_ledger_asset_id_t asset_id);
+    void log_account_change(cma_wal_op_t op, cma_ledger_account_id_t account_id);
+    void checkpoint_unlogged();
+    [[nodiscard]] auto get_wal_capacity() const -> size_t;
+
+    auto lookup_asset(cma_ledger_asset_id_t asset_id) -> cma_ledger_asset_hot_t *;
+    auto lookup_account(cma_ledger_account_id_t account_id) -> cma_ledger_account_hot_t *;
+    // Whole records (hot and cold parts) of live ids, for creation, removal and their undo
+    // Assets and accounts are only written without supply or balances, so their holder and balance lists start empty
+    [[nodiscard]] auto read_asset_record(cma_ledger_asset_id_t asset_id) const -> cma_ledger_asset_struct_t;
+    void write_asset_record(cma_ledger_asset_id_t asset_id, const cma_ledger_asset_struct_t &asset);
+    [[nodiscard]] auto read_account_record(cma_ledger_account_id_t account_id) const -> cma_ledger_account_struct_t;
+    void write_account_record(cma_ledger_account_id_t account_id, const cma_ledger_account_struct_t &account);
+    // The entry is valid until the next balance is created (erasing doesn't move other entries)
+    auto lookup_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id) -> cma_balance_t *;
+    auto find_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id)
+        -> account_asset_map_t::iterator;
+    // Finds the entry, or reserves an empty one in the same probe (second is true) while there is room for another
+    // balance; a missing entry at the max balances is end()
+    auto reserve_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id)
+        -> std::pair<account_asset_map_t::iterator, bool>;
+    auto allocate_virtual_balance() -> uint32_t;
+    void free_virtual_balance(uint32_t index);
+    [[nodiscard]] auto get_balance_amount(const cma_balance_t &balance_entry) const -> const cma_amount_t &;
+    // A balance is in the list of its account and in the holder list of its asset, the counts and owner slot follow
+    void link_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
+        cma_ledger_asset_hot_t &asset, cma_ledger_account_hot_t &account, cma_balance_t &balance_entry);
+    void unlink_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
+        cma_ledger_asset_hot_t &asset, cma_ledger_account_hot_t &account, const cma_balance_t &balance_entry);
+    void store_supply(cma_ledger_asset_id_t asset_id, cma_ledger_asset_hot_t &asset, const cma_amount_t &supply);
+    // Entries not yet looked up are passed as nullptr. balance_slot is the entry of the balance, a reserved one is
+    // filled in (or released on failure) and a missing one (end()) is inserted, both create the balance
+    void store_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
+        account_asset_map_t::iterator balance_slot, bool reserved, cma_ledger_asset_hot_t *asset,
+        cma_ledger_account_hot_t *account, const cma_amount_t &balance);
+
+    // Create with the next id, key_slot is the reserved reverse key entry (end() when there is none)
+    auto insert_asset(const cma_ledger_asset_struct_t &asset, asset_to_lassid_t::iterator key_slot)
+        -> cma_ledger_asset_id_t;
+    auto insert_account(const cma_ledger_account_struct_t &account, account_to_laccid_t::iterator key_slot)
+        -> cma_ledger_account_id_t;
+
+    // Keyed table updates mark the memory they write, or the whole segment when the table rehashes
+    template <typename Table, typename... Args>
+    auto emplace_entry(Table &table, const typename Table::key_type &key, Args &&...args)
+        -> std::pair<typename Table::iterator, bool>;
+    template <typename Table>
+    void erase_entry(Table &table, typename Table::iterator position);
+    template <typename Table>
+    auto erase_entry(Table &table, const typename Table::key_type &key) -> bool;
+    void push_last_balance(cma_map_key_t balance_key);
+
+    [[nodiscard]] auto journaling() const -> bool;
+    void restore_asset(cma_ledger_asset_id_t asset_id, const cma_ledger_asset_struct_t &asset);
+    void restore_account(cma_ledger_account_id_t account_id, const cma_ledger_account_struct_t &account);
 
 public:
     cma_ledger_memory(interprocess::open_only_t mode, const char *memory_file_name, size_t offset, size_t mem_length,
-        size_t n_accounts, size_t n_assets, size_t n_balances);
+        size_t n_accounts, size_t n_assets, size_t n_balances, size_t wal_len = 0);
     cma_ledger_memory(interprocess::create_only_t mode, const char *memory_file_name, size_t offset, size_t mem_length,
-        size_t n_accounts, size_t n_assets, size_t n_balances);
+        size_t n_accounts, size_t n_assets, size_t n_balances, size_t wal_len = 0);
     cma_ledger_memory(void *mem_ptr, size_t mem_length, size_t n_accounts, size_t n_assets, size_t n_balances);
 
     static auto estimate_required_size(size_t n_accounts, size_t n_assets, size_t n_balances) -> size_t;
+    void begin() override;
+    void commit() override;
+    void abort() override;
+    void rollback() override;
+    auto savepoint() -> cma_ledger_savepoint_t override;
+    void rollback_to(const cma_ledger_savepoint_t &savepoint) override;
+    void set_flush_policy(cma_ledger_flush_policy_t policy) override;
+    void checkpoint() override;
+    void presize() override;
+    void set_hash_seed(const cma_hash_seed_t &seed) override;
     void clear() override;
     auto get_asset_count() -> size_t override;
     void retrieve_asset(cma_ledger_asset_id_t *asset_id, cma_token_address_t *token_address, cma_token_id_t *token_id,
@@ -243,6 +641,12 @@ public:
         cma_amount_t *balance, cma_ledger_account_balance_info_t *account_balance_info) override;
     void set_account_asset_balance(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t account_id,
         const cma_amount_t &balance) override;
+    void set_account_asset_balances(const std::vector<cma_ledger_balance_update_t> &updates) override;
+    auto list_account_balances(cma_ledger_account_id_t account_id, cma_ledger_asset_balance_t *out, size_t cap)
+        -> size_t override;
+    auto get_owner(cma_ledger_asset_id_t asset_id) -> cma_ledger_account_id_t override;
+    auto list_asset_holders(cma_ledger_asset_id_t asset_id, const cma_ledger_account_id_t *after_account_id,
+        cma_ledger_holder_balance_t *out, size_t cap) -> size_t override;
 
     void deposit(cma_ledger_asset_id_t asset_id, cma_ledger_account_id_t to_account_id,
         const cma_amount_t &deposit) override;
@@ -254,6 +658,7 @@ public:
     auto get_balances() -> cma_ledger_account_balance_t *;
     auto get_balances_size() -> size_t;
     auto get_mem_offset() -> size_t;
+    auto get_dirty_ranges_count() -> size_t;
 };
 
 #endif // CMA_LEDGER_IMPL_H
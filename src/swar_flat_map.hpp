@@ -0,0 +1,456 @@
+#ifndef SWAR_FLAT_MAP_HPP
+#define SWAR_FLAT_MAP_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace libcma {
+
+/// @brief Entry of a swar_flat_map, a plain aggregate so its layout is the same on every architecture.
+template <typename Key, typename Value>
+struct swar_flat_map_entry {
+    Key first;
+    Value second;
+};
+
+/// @brief Open addressing hash map probing groups of control bytes with portable 64-bit SWAR operations.
+///
+/// Slots are split in groups of 8 with a 64-bit control word per group, holding one byte per slot: 0x80 when the
+/// slot is empty, 0xfe when its entry was erased and the 7 low bits of the hash when it is full. A lookup matches
+/// the hash bits against the 8 control bytes of a group with a few integer operations, so only candidate slots
+/// compare keys. Nothing depends on SIMD support, the table bytes only depend on the sequence of operations
+/// (given the 64-bit little-endian layout required for the mapped memory), so images are reproducible across
+/// riscv64, x86_64 and aarch64.
+///
+/// Entries are stored inline and are relocated when the table grows or purges its erased slots, which only happens
+/// when inserting a new key. Erasing doesn't move other entries.
+template <typename Key, typename Value, class Hash, class KeyEqual, class Allocator>
+class swar_flat_map {
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = swar_flat_map_entry<Key, Value>;
+    using size_type = std::size_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Allocator;
+
+    static_assert(std::is_trivially_destructible_v<Key> && std::is_trivially_destructible_v<Value>,
+        "entries are dropped without running destructors");
+
+private:
+    using ctrl_allocator_t = typename std::allocator_traits<Allocator>::template rebind_alloc<std::uint64_t>;
+    using slot_allocator_t = typename std::allocator_traits<Allocator>::template rebind_alloc<value_type>;
+    using ctrl_pointer = typename std::allocator_traits<ctrl_allocator_t>::pointer;
+    using slot_pointer = typename std::allocator_traits<slot_allocator_t>::pointer;
+
+    static constexpr size_type GROUP_SLOTS = 8;
+    static constexpr unsigned BYTE_BITS = 8;
+    static constexpr unsigned H2_BITS = 7;
+    static constexpr std::uint64_t H2_MASK = 0x7f;
+    static constexpr std::uint64_t CTRL_EMPTY = 0x80;
+    static constexpr std::uint64_t CTRL_DELETED = 0xfe;
+    static constexpr std::uint64_t LSBS = 0x0101010101010101;
+    static constexpr std::uint64_t MSBS = 0x8080808080808080;
+    static constexpr std::uint64_t GROUP_EMPTY = CTRL_EMPTY * LSBS;
+    static constexpr unsigned EMPTY_SHIFT = 6; ///< Moves bit 1 (set for deleted, clear for empty) to bit 7
+    static constexpr size_type MAX_LOAD_NUM = 7; ///< Full and erased slots are kept at most at 7/8 of the slots
+    static constexpr size_type MAX_LOAD_DEN = 8;
+    static constexpr size_type GROW_LOAD_NUM = 25; ///< Above 25/32 full slots grow, otherwise purge erased slots
+    static constexpr size_type GROW_LOAD_DEN = 32;
+    static constexpr std::uint64_t MIX_SHIFT1 = 30;
+    static constexpr std::uint64_t MIX_MUL1 = 0xbf58476d1ce4e5b9;
+    static constexpr std::uint64_t MIX_SHIFT2 = 27;
+    static constexpr std::uint64_t MIX_MUL2 = 0x94d049bb133111eb;
+    static constexpr std::uint64_t MIX_SHIFT3 = 31;
+    static constexpr size_type NOT_FOUND = ~size_type{0};
+
+    ctrl_pointer ctrl{};
+    slot_pointer slots{};
+    size_type n_groups = 0;
+    size_type n_size = 0;
+    size_type n_deleted = 0;
+    [[no_unique_address]] Hash hash_function{};
+    [[no_unique_address]] KeyEqual key_eq{};
+    ctrl_allocator_t ctrl_allocator;
+
+    template <bool Const>
+    class basic_iterator {
+        friend class swar_flat_map;
+        template <bool>
+        friend class basic_iterator;
+        using map_pointer = std::conditional_t<Const, const swar_flat_map *, swar_flat_map *>;
+
+        map_pointer map = nullptr;
+        size_type index = 0;
+
+        basic_iterator(map_pointer map_ptr, size_type slot_index) : map(map_ptr), index(slot_index) {}
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = swar_flat_map::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const value_type &, value_type &>;
+        using pointer = std::conditional_t<Const, const value_type *, value_type *>;
+
+        basic_iterator() = default;
+        template <bool OtherConst>
+            requires(Const && !OtherConst)
+        // NOLINTNEXTLINE(google-explicit-constructor,hicpp-explicit-conversions)
+        basic_iterator(const basic_iterator<OtherConst> &other) : map(other.map), index(other.index) {}
+
+        auto operator*() const -> reference {
+            return map->slots[index];
+        }
+        auto operator->() const -> pointer {
+            return &map->slots[index];
+        }
+        auto operator++() -> basic_iterator & {
+            index = map->next_full(index + 1);
+            return *this;
+        }
+        auto operator++(int) -> basic_iterator {
+            basic_iterator prev = *this;
+            ++*this;
+            return prev;
+        }
+        auto operator==(const basic_iterator &other) const -> bool {
+            return index == other.index;
+        }
+    };
+
+public:
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    explicit swar_flat_map(const Allocator &allocator) : ctrl_allocator(allocator) {}
+    swar_flat_map(size_type n_entries, const Allocator &allocator) : ctrl_allocator(allocator) {
+        reserve(n_entries);
+    }
+    swar_flat_map(size_type n_entries, const Hash &hash, const Allocator &allocator) :
+        hash_function(hash),
+        ctrl_allocator(allocator) {
+        reserve(n_entries);
+    }
+    swar_flat_map(const swar_flat_map &) = delete;
+    swar_flat_map(swar_flat_map &&) = delete;
+    auto operator=(const swar_flat_map &) -> swar_flat_map & = delete;
+    auto operator=(swar_flat_map &&) -> swar_flat_map & = delete;
+    ~swar_flat_map() {
+        release(ctrl, slots, n_groups);
+    }
+
+    /// @brief Memory taken by the slot arrays of a table holding up to n entries, including the previous arrays
+    /// still allocated while growing (purging erased slots allocates nothing).
+    static constexpr auto max_memory_size(size_type n_entries) -> size_type {
+        // the table grows before full slots reach 25/32, so it never has more groups than the smallest power of
+        // two holding the entries at that load
+        const size_type groups = std::max<size_type>(reserved_groups(n_entries), 1);
+        const size_type arrays = groups * (sizeof(std::uint64_t) + (GROUP_SLOTS * sizeof(value_type)));
+        return arrays + (arrays / 2);
+    }
+
+    [[nodiscard]] auto size() const -> size_type {
+        return n_size;
+    }
+    [[nodiscard]] auto empty() const -> bool {
+        return n_size == 0;
+    }
+    [[nodiscard]] auto capacity() const -> size_type {
+        return n_groups * GROUP_SLOTS;
+    }
+    /// @brief Entries that can still be inserted before the table rehashes (grows or purges erased slots), 0 when
+    /// the next insert of a new key rehashes.
+    [[nodiscard]] auto growth_left() const -> size_type {
+        return (capacity() * MAX_LOAD_NUM / MAX_LOAD_DEN) - (n_size + n_deleted);
+    }
+    /// @brief Control word of the group of the slot at position. Without a rehash, inserting or erasing an entry
+    /// only writes its slot, this word and the table object itself.
+    [[nodiscard]] auto ctrl_of(const_iterator position) const -> const std::uint64_t * {
+        return &ctrl[position.index / GROUP_SLOTS];
+    }
+
+    auto begin() -> iterator {
+        return {this, next_full(0)};
+    }
+    auto end() -> iterator {
+        return {this, capacity()};
+    }
+    auto begin() const -> const_iterator {
+        return {this, next_full(0)};
+    }
+    auto end() const -> const_iterator {
+        return {this, capacity()};
+    }
+
+    auto find(const Key &key) -> iterator {
+        const size_type index = find_index(key, hash_of(key));
+        return {this, index == NOT_FOUND ? capacity() : index};
+    }
+    auto find(const Key &key) const -> const_iterator {
+        const size_type index = find_index(key, hash_of(key));
+        return {this, index == NOT_FOUND ? capacity() : index};
+    }
+    [[nodiscard]] auto contains(const Key &key) const -> bool {
+        return find_index(key, hash_of(key)) != NOT_FOUND;
+    }
+    [[nodiscard]] auto count(const Key &key) const -> size_type {
+        return contains(key) ? 1 : 0;
+    }
+
+    template <typename... Args>
+    auto try_emplace(const Key &key, Args &&...args) -> std::pair<iterator, bool> {
+        const std::uint64_t hash = hash_of(key);
+        const size_type index = find_index(key, hash);
+        if (index != NOT_FOUND) {
+            return {iterator{this, index}, false};
+        }
+        if ((n_size + n_deleted + 1) * MAX_LOAD_DEN > capacity() * MAX_LOAD_NUM) {
+            // purge erased slots in place unless the entries alone are getting close to the maximum load
+            if ((n_size + 1) * GROW_LOAD_DEN > capacity() * GROW_LOAD_NUM) {
+                rehash(std::max(2 * n_groups, groups_for(n_size + 1)));
+            } else {
+                drop_deleted();
+            }
+        }
+        const size_type free_index = find_free(hash);
+        ::new (static_cast<void *>(&slots[free_index])) value_type{key, Value{std::forward<Args>(args)...}};
+        if (ctrl_byte(free_index) == CTRL_DELETED) {
+            --n_deleted;
+        }
+        set_ctrl(free_index, hash & H2_MASK);
+        ++n_size;
+        return {iterator{this, free_index}, true};
+    }
+    auto emplace(const Key &key, const Value &value) -> std::pair<iterator, bool> {
+        return try_emplace(key, value);
+    }
+    auto insert(const value_type &entry) -> std::pair<iterator, bool> {
+        return try_emplace(entry.first, entry.second);
+    }
+
+    auto erase(iterator position) -> void {
+        const size_type group = position.index / GROUP_SLOTS;
+        // a group with an empty slot stops every probe, so no entry past it depends on this slot being taken
+        if (match_empty(ctrl[group]) != 0) {
+            set_ctrl(position.index, CTRL_EMPTY);
+        } else {
+            set_ctrl(position.index, CTRL_DELETED);
+            ++n_deleted;
+        }
+        --n_size;
+    }
+    auto erase(const Key &key) -> size_type {
+        const size_type index = find_index(key, hash_of(key));
+        if (index == NOT_FOUND) {
+            return 0;
+        }
+        erase(iterator{this, index});
+        return 1;
+    }
+
+    auto clear() -> void {
+        if (n_groups == 0) {
+            return;
+        }
+        std::fill_n(&ctrl[0], n_groups, GROUP_EMPTY);
+        n_size = 0;
+        n_deleted = 0;
+    }
+
+    /// @brief Hash the keys with another hasher. Only for an empty table, the slots of erased entries are dropped.
+    auto reset_hash_function(const Hash &hash) -> void {
+        clear();
+        hash_function = hash;
+    }
+
+    /// @brief Make room for n entries, inserting up to n entries never reallocates the table (erased slots may
+    /// still be purged in place).
+    auto reserve(size_type n_entries) -> void {
+        const size_type groups = reserved_groups(n_entries);
+        if (groups > n_groups) {
+            rehash(groups);
+        }
+    }
+
+private:
+    static constexpr auto mix(std::uint64_t hash) -> std::uint64_t {
+        hash = (hash ^ (hash >> MIX_SHIFT1)) * MIX_MUL1;
+        hash = (hash ^ (hash >> MIX_SHIFT2)) * MIX_MUL2;
+        return hash ^ (hash >> MIX_SHIFT3);
+    }
+
+    // Control bytes equal to h2 (may report false positives after a true match, keys are always compared)
+    static constexpr auto match(std::uint64_t group, std::uint64_t h2) -> std::uint64_t {
+        const std::uint64_t diff = group ^ (LSBS * h2);
+        return (diff - LSBS) & ~diff & MSBS;
+    }
+    static constexpr auto match_empty(std::uint64_t group) -> std::uint64_t {
+        return group & ~(group << EMPTY_SHIFT) & MSBS;
+    }
+    static constexpr auto match_free(std::uint64_t group) -> std::uint64_t {
+        return group & MSBS;
+    }
+    static constexpr auto first_slot(std::uint64_t mask) -> size_type {
+        return static_cast<size_type>(std::countr_zero(mask)) / BYTE_BITS;
+    }
+
+    // Smallest power of two number of groups holding n entries under the maximum load
+    static constexpr auto groups_for(size_type n_entries) -> size_type {
+        if (n_entries == 0) {
+            return 0;
+        }
+        const size_type min_slots = ((n_entries * MAX_LOAD_DEN) + MAX_LOAD_NUM - 1) / MAX_LOAD_NUM;
+        return std::bit_ceil((min_slots + GROUP_SLOTS - 1) / GROUP_SLOTS);
+    }
+
+    // Smallest power of two number of groups holding n entries without reaching the growth load
+    static constexpr auto reserved_groups(size_type n_entries) -> size_type {
+        if (n_entries == 0) {
+            return 0;
+        }
+        const size_type min_slots = ((n_entries * GROW_LOAD_DEN) + GROW_LOAD_NUM - 1) / GROW_LOAD_NUM;
+        return std::bit_ceil((min_slots + GROUP_SLOTS - 1) / GROUP_SLOTS);
+    }
+
+    auto hash_of(const Key &key) const -> std::uint64_t {
+        const std::uint64_t hash = hash_function(key);
+        if constexpr (requires { typename Hash::is_avalanching; }) {
+            return hash;
+        } else {
+            return mix(hash);
+        }
+    }
+
+    [[nodiscard]] auto ctrl_byte(size_type index) const -> std::uint64_t {
+        return (ctrl[index / GROUP_SLOTS] >> ((index % GROUP_SLOTS) * BYTE_BITS)) & 0xff;
+    }
+    auto set_ctrl(size_type index, std::uint64_t value) -> void {
+        const unsigned shift = (index % GROUP_SLOTS) * BYTE_BITS;
+        std::uint64_t &group = ctrl[index / GROUP_SLOTS];
+        group = (group & ~(std::uint64_t{0xff} << shift)) | (value << shift);
+    }
+
+    [[nodiscard]] auto next_full(size_type index) const -> size_type {
+        while (index < capacity() && ctrl_byte(index) >= CTRL_EMPTY) {
+            ++index;
+        }
+        return index;
+    }
+
+    // Groups are probed in triangular steps, visiting every group of a power of two table
+    [[nodiscard]] auto find_index(const Key &key, std::uint64_t hash) const -> size_type {
+        if (n_groups == 0) {
+            return NOT_FOUND;
+        }
+        const size_type group_mask = n_groups - 1;
+        size_type group = (hash >> H2_BITS) & group_mask;
+        for (size_type step = 1;; ++step) {
+            const std::uint64_t group_ctrl = ctrl[group];
+            for (std::uint64_t mask = match(group_ctrl, hash & H2_MASK); mask != 0; mask &= mask - 1) {
+                const size_type index = (group * GROUP_SLOTS) + first_slot(mask);
+                if (key_eq(slots[index].first, key)) {
+                    return index;
+                }
+            }
+            if (match_empty(group_ctrl) != 0) {
+                return NOT_FOUND;
+            }
+            group = (group + step) & group_mask;
+        }
+    }
+
+    [[nodiscard]] auto find_free(std::uint64_t hash) const -> size_type {
+        const size_type group_mask = n_groups - 1;
+        size_type group = (hash >> H2_BITS) & group_mask;
+        for (size_type step = 1;; ++step) {
+            const std::uint64_t mask = match_free(ctrl[group]);
+            if (mask != 0) {
+                return (group * GROUP_SLOTS) + first_slot(mask);
+            }
+            group = (group + step) & group_mask;
+        }
+    }
+
+    // Turns erased slots back into empty ones without allocating: full slots are first marked as deleted, then each
+    // entry is put in the first free slot of its probe sequence, swapping with an entry not placed yet when that slot
+    // holds one. An entry already in the group its probe picks stays where it is.
+    auto drop_deleted() -> void {
+        for (size_type group = 0; group < n_groups; ++group) {
+            // empty and deleted bytes become empty, full ones deleted
+            const std::uint64_t not_full = ctrl[group] & MSBS;
+            ctrl[group] = (~not_full + (not_full >> (BYTE_BITS - 1))) & ~LSBS;
+        }
+        for (size_type i = 0; i < capacity(); ++i) {
+            // a swap brings in another entry not placed yet, placed in turn
+            while (ctrl_byte(i) == CTRL_DELETED) {
+                const std::uint64_t hash = hash_of(slots[i].first);
+                const size_type free_index = find_free(hash);
+                if (free_index / GROUP_SLOTS == i / GROUP_SLOTS) {
+                    set_ctrl(i, hash & H2_MASK);
+                } else if (ctrl_byte(free_index) == CTRL_EMPTY) {
+                    ::new (static_cast<void *>(&slots[free_index])) value_type(slots[i]);
+                    set_ctrl(free_index, hash & H2_MASK);
+                    set_ctrl(i, CTRL_EMPTY);
+                } else {
+                    std::swap(slots[i], slots[free_index]);
+                    set_ctrl(free_index, hash & H2_MASK);
+                }
+            }
+        }
+        n_deleted = 0;
+    }
+
+    auto rehash(size_type new_n_groups) -> void {
+        slot_allocator_t slot_allocator(ctrl_allocator);
+        ctrl_pointer new_ctrl = ctrl_allocator.allocate(new_n_groups);
+        slot_pointer new_slots;
+        try {
+            new_slots = slot_allocator.allocate(new_n_groups * GROUP_SLOTS);
+        } catch (...) {
+            ctrl_allocator.deallocate(new_ctrl, new_n_groups);
+            throw;
+        }
+        std::fill_n(&new_ctrl[0], new_n_groups, GROUP_EMPTY);
+
+        ctrl_pointer old_ctrl = ctrl;
+        slot_pointer old_slots = slots;
+        const size_type old_capacity = capacity();
+        const size_type old_n_groups = n_groups;
+        ctrl = new_ctrl;
+        slots = new_slots;
+        n_groups = new_n_groups;
+        n_deleted = 0;
+        for (size_type i = 0; i < old_capacity; ++i) {
+            const std::uint64_t old_byte = (old_ctrl[i / GROUP_SLOTS] >> ((i % GROUP_SLOTS) * BYTE_BITS)) & 0xff;
+            if (old_byte >= CTRL_EMPTY) {
+                continue;
+            }
+            const std::uint64_t hash = hash_of(old_slots[i].first);
+            const size_type index = find_free(hash);
+            ::new (static_cast<void *>(&slots[index])) value_type(old_slots[i]);
+            set_ctrl(index, hash & H2_MASK);
+        }
+        release(old_ctrl, old_slots, old_n_groups);
+    }
+
+    auto release(ctrl_pointer old_ctrl, slot_pointer old_slots, size_type old_n_groups) -> void {
+        if (old_n_groups == 0) {
+            return;
+        }
+        slot_allocator_t slot_allocator(ctrl_allocator);
+        slot_allocator.deallocate(old_slots, old_n_groups * GROUP_SLOTS);
+        ctrl_allocator.deallocate(old_ctrl, old_n_groups);
+    }
+};
+
+} // namespace libcma
+
+#endif // SWAR_FLAT_MAP_HPP
@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "libcma/u256.h"
+}
+
+#include "u256_impl.h"
+
+/*
+ * Aux
+ */
+
+namespace {
+
+constexpr uint64_t dec_chunk = 10000000000000000000ULL; // 10^19, the largest power of ten in a limb
+constexpr size_t dec_chunk_digits = 19;
+constexpr size_t hex_digit_bits = 4;
+
+// limbs = limbs * mul + add, returns the limb carried out
+auto mul_add_small(u256_limbs_t &limbs, uint64_t mul, uint64_t add) -> uint64_t {
+    uint64_t carry = add;
+    for (auto &limb : limbs) {
+        const u128_t cur = (static_cast<u128_t>(limb) * mul) + carry;
+        limb = static_cast<uint64_t>(cur);
+        carry = static_cast<uint64_t>(cur >> CMA_U256_LIMB_BITS);
+    }
+    return carry;
+}
+
+// limbs = limbs / div, returns the remainder
+auto div_small(u256_limbs_t &limbs, uint64_t div) -> uint64_t {
+    u256_limbs_t quot{};
+    uint64_t rem = 0;
+    u256_divmod_limbs(limbs.data(), CMA_U256_LIMBS, &div, 1, quot.data(), &rem);
+    limbs = quot;
+    return rem;
+}
+
+auto shift_left(const u256_limbs_t &a, unsigned int shift) -> u256_limbs_t {
+    u256_limbs_t res{};
+    if (shift >= CMA_U256_LIMBS * CMA_U256_LIMB_BITS) {
+        return res;
+    }
+    const size_t limb_shift = shift / CMA_U256_LIMB_BITS;
+    const unsigned int bit_shift = shift % CMA_U256_LIMB_BITS;
+    for (size_t i = CMA_U256_LIMBS; i-- > limb_shift;) {
+        res[i] = a[i - limb_shift] << bit_shift;
+        if (bit_shift != 0 && i > limb_shift) {
+            res[i] |= a[i - limb_shift - 1] >> (CMA_U256_LIMB_BITS - bit_shift);
+        }
+    }
+    return res;
+}
+
+auto shift_right(const u256_limbs_t &a, unsigned int shift) -> u256_limbs_t {
+    u256_limbs_t res{};
+    if (shift >= CMA_U256_LIMBS * CMA_U256_LIMB_BITS) {
+        return res;
+    }
+    const size_t limb_shift = shift / CMA_U256_LIMB_BITS;
+    const unsigned int bit_shift = shift % CMA_U256_LIMB_BITS;
+    for (size_t i = 0; i + limb_shift < CMA_U256_LIMBS; ++i) {
+        res[i] = a[i + limb_shift] >> bit_shift;
+        if (bit_shift != 0 && i + limb_shift + 1 < CMA_U256_LIMBS) {
+            res[i] |= a[i + limb_shift + 1] << (CMA_U256_LIMB_BITS - bit_shift);
+        }
+    }
+    return res;
+}
+
+auto hex_digit_value(char c) -> int {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+} // namespace
+
+/*
+ * U256 Api
+ */
+
+auto cma_u256_add(cma_amount_t *res, const cma_amount_t *a, const cma_amount_t *b) -> int {
+    if (res == nullptr || a == nullptr || b == nullptr) {
+        return -EINVAL;
+    }
+    u256_limbs_t res_limbs{};
+    if (u256_add(res_limbs, u256_load(*a), u256_load(*b))) {
+        return CMA_U256_ERROR_OVERFLOW;
+    }
+    u256_store(*res, res_limbs);
+    return CMA_U256_SUCCESS;
+}
+
+auto cma_u256_sub(cma_amount_t *res, const cma_amount_t *a, const cma_amount_t *b) -> int {
+    if (res == nullptr || a == nullptr || b == nullptr) {
+        return -EINVAL;
+    }
+    u256_limbs_t res_limbs{};
+    if (u256_sub(res_limbs, u256_load(*a), u256_load(*b))) {
+        return CMA_U256_ERROR_OVERFLOW;
+    }
+    u256_store(*res, res_limbs);
+    return CMA_U256_SUCCESS;
+}
+
+auto cma_u256_mul(cma_amount_t *res, const cma_amount_t *a, const cma_amount_t *b) -> int {
+    if (res == nullptr || a == nullptr || b == nullptr) {
+        return -EINVAL;
+    }
+    const u512_limbs_t prod = u256_mul_wide(u256_load(*a), u256_load(*b));
+    if (u256_significant_limbs(prod.data(), prod.size()) > CMA_U256_LIMBS) {
+        return CMA_U256_ERROR_OVERFLOW;
+    }
+    u256_limbs_t res_limbs{};
+    std::copy_n(prod.begin(), CMA_U256_LIMBS, res_limbs.begin());
+    u256_store(*res, res_limbs);
+    return CMA_U256_SUCCESS;
+}
+
+auto cma_u256_divmod(cma_amount_t *quot, cma_amount_t *rem, const cma_amount_t *a, const cma_amount_t *b) -> int {
+    if (a == nullptr || b == nullptr) {
+        return -EINVAL;
+    }
+    const u256_limbs_t a_limbs = u256_load(*a);
+    const u256_limbs_t b_limbs = u256_load(*b);
+    const size_t n = u256_significant_limbs(b_limbs.data(), CMA_U256_LIMBS);
+    if (n == 0) {
+        return CMA_U256_ERROR_DIVISION_BY_ZERO;
+    }
+    u256_limbs_t quot_limbs{};
+    u256_limbs_t rem_limbs = a_limbs;
+    const size_t m = u256_significant_limbs(a_limbs.data(), CMA_U256_LIMBS);
+    if (m >= n) {
+        rem_limbs = {};
+        u256_divmod_limbs(a_limbs.data(), m, b_limbs.data(), n, quot_limbs.data(), rem_limbs.data());
+    }
+    if (quot != nullptr) {
+        u256_store(*quot, quot_limbs);
+    }
+    if (rem != nullptr) {
+        u256_store(*rem, rem_limbs);
+    }
+    return CMA_U256_SUCCESS;
+}
+
+auto cma_u256_mul_div(cma_amount_t *res, cma_amount_t *rem, const cma_amount_t *a, const cma_amount_t *b,
+    const cma_amount_t *c) -> int {
+    if (res == nullptr || a == nullptr || b == nullptr || c == nullptr) {
+        return -EINVAL;
+    }
+    const u256_limbs_t c_limbs = u256_load(*c);
+    const size_t n = u256_significant_limbs(c_limbs.data(), CMA_U256_LIMBS);
+    if (n == 0) {
+        return CMA_U256_ERROR_DIVISION_BY_ZERO;
+    }
+    const u512_limbs_t prod = u256_mul_wide(u256_load(*a), u256_load(*b));
+    u512_limbs_t quot_limbs{};
+    u256_limbs_t rem_limbs{};
+    const size_t m = u256_significant_limbs(prod.data(), prod.size());
+    if (m >= n) {
+        u256_divmod_limbs(prod.data(), m, c_limbs.data(), n, quot_limbs.data(), rem_limbs.data());
+    } else {
+        std::copy_n(prod.begin(), CMA_U256_LIMBS, rem_limbs.begin());
+    }
+    if (u256_significant_limbs(quot_limbs.data(), quot_limbs.size()) > CMA_U256_LIMBS) {
+        return CMA_U256_ERROR_OVERFLOW;
+    }
+    u256_limbs_t res_limbs{};
+    std::copy_n(quot_limbs.begin(), CMA_U256_LIMBS, res_limbs.begin());
+    u256_store(*res, res_limbs);
+    if (rem != nullptr) {
+        u256_store(*rem, rem_limbs);
+    }
+    return CMA_U256_SUCCESS;
+}
+
+auto cma_u256_shl(cma_amount_t *res, const cma_amount_t *a, unsigned int shift) -> int {
+    if (res == nullptr || a == nullptr) {
+        return -EINVAL;
+    }
+    u256_store(*res, shift_left(u256_load(*a), shift));
+    return CMA_U256_SUCCESS;
+}
+
+auto cma_u256_shr(cma_amount_t *res, const cma_amount_t *a, unsigned int shift) -> int {
+    if (res == nullptr || a == nullptr) {
+        return -EINVAL;
+    }
+    u256_store(*res, shift_right(u256_load(*a), shift));
+    return CMA_U256_SUCCESS;
+}
+
+auto cma_u256_compare(const cma_amount_t *a, const cma_amount_t *b) -> int {
+    return u256_compare(u256_load(*a), u256_load(*b));
+}
+
+auto cma_u256_is_zero(const cma_amount_t *a) -> int {
+    return u256_is_zero(*a) ? 1 : 0;
+}
+
+auto cma_u256_from_u64(cma_amount_t *res, uint64_t value) -> int {
+    if (res == nullptr) {
+        return -EINVAL;
+    }
+    u256_store(*res, u256_limbs_t{value});
+    return CMA_U256_SUCCESS;
+}
+
+auto cma_u256_to_u64(const cma_amount_t *a, uint64_t *out_value) -> int {
+    if (a == nullptr || out_value == nullptr) {
+        return -EINVAL;
+    }
+    const u256_limbs_t limbs = u256_load(*a);
+    if ((limbs[1] | limbs[2] | limbs[3]) != 0) {
+        return CMA_U256_ERROR_OVERFLOW;
+    }
+    *out_value = limbs[0];
+    return CMA_U256_SUCCESS;
+}
+
+auto cma_u256_from_dec(cma_amount_t *res, const char *str, size_t len) -> int {
+    if (res == nullptr || str == nullptr) {
+        return -EINVAL;
+    }
+    if (len == 0) {
+        return CMA_U256_ERROR_INVALID_STRING;
+    }
+    // consume the digits in chunks of 19, so most of them cost a single limb multiplication
+    u256_limbs_t limbs{};
+    size_t pos = 0;
+    while (pos < len) {
+        const size_t n_digits = std::min(dec_chunk_digits, len - pos);
+        uint64_t chunk = 0;
+        uint64_t chunk_scale = 1;
+        for (size_t i = 0; i < n_digits; ++i) {
+            const char c = str[pos + i];
+            if (c < '0' || c > '9') {
+                return CMA_U256_ERROR_INVALID_STRING;
+            }
+            chunk = (chunk * 10) + static_cast<uint64_t>(c - '0');
+            chunk_scale *= 10;
+        }
+        if (mul_add_small(limbs, chunk_scale, chunk) != 0) {
+            return CMA_U256_ERROR_OVERFLOW;
+        }
+        pos += n_digits;
+    }
+    u256_store(*res, limbs);
+    return CMA_U256_SUCCESS;
+}
+
+auto cma_u256_from_hex(cma_amount_t *res, const char *str, size_t len) -> int {
+    if (res == nullptr || str == nullptr) {
+        return -EINVAL;
+    }
+    if (len >= 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+        str += 2;
+        len -= 2;
+    }
+    if (len == 0) {
+        return CMA_U256_ERROR_INVALID_STRING;
+    }
+    u256_limbs_t limbs{};
+    for (size_t i = 0; i < len; ++i) {
+        const int digit = hex_digit_value(str[i]);
+        if (digit < 0) {
+            return CMA_U256_ERROR_INVALID_STRING;
+        }
+        if ((limbs[CMA_U256_LIMBS - 1] >> (CMA_U256_LIMB_BITS - hex_digit_bits)) != 0) {
+            return CMA_U256_ERROR_OVERFLOW;
+        }
+        limbs = shift_left(limbs, hex_digit_bits);
+        limbs[0] |= static_cast<uint64_t>(digit);
+    }
+    u256_store(*res, limbs);
+    return CMA_U256_SUCCESS;
+}
+
+auto cma_u256_to_dec(const cma_amount_t *a, char *out, size_t out_len) -> int {
+    if (a == nullptr || out == nullptr) {
+        return -EINVAL;
+    }
+    // peel 19 digit chunks off the low end, then write them most significant first
+    std::array<char, CMA_U256_DEC_STRING_LENGTH> digits{};
+    size_t n_digits = 0;
+    u256_limbs_t limbs = u256_load(*a);
+    do {
+        uint64_t chunk = div_small(limbs, dec_chunk);
+        const bool last = u256_is_zero(limbs);
+        for (size_t i = 0; i < dec_chunk_digits && (!last || chunk != 0 || i == 0); ++i) {
+            digits[n_digits++] = static_cast<char>('0' + (chunk % 10));
+            chunk /= 10;
+        }
+    } while (!u256_is_zero(limbs));
+    if (out_len < n_digits + 1) {
+        return CMA_U256_ERROR_BUFFER_TOO_SMALL;
+    }
+    for (size_t i = 0; i < n_digits; ++i) {
+        out[i] = digits[n_digits - 1 - i];
+    }
+    out[n_digits] = '\0';
+    return CMA_U256_SUCCESS;
+}
+
+auto cma_u256_to_hex(const cma_amount_t *a, char *out, size_t out_len) -> int {
+    if (a == nullptr || out == nullptr) {
+        return -EINVAL;
+    }
+    static const char hex_digits[] = "0123456789abcdef";
+    const u256_limbs_t limbs = u256_load(*a);
+    const size_t n_limbs = u256_significant_limbs(limbs.data(), CMA_U256_LIMBS);
+    size_t n_digits = 1;
+    if (n_limbs > 0) {
+        const auto top_bits = static_cast<size_t>(CMA_U256_LIMB_BITS - std::countl_zero(limbs[n_limbs - 1]));
+        n_digits = ((n_limbs - 1) * (CMA_U256_LIMB_BITS / hex_digit_bits)) +
+            ((top_bits + hex_digit_bits - 1) / hex_digit_bits);
+    }
+    if (out_len < n_digits + 3) {
+        return CMA_U256_ERROR_BUFFER_TOO_SMALL;
+    }
+    out[0] = '0';
+    out[1] = 'x';
+    for (size_t i = 0; i < n_digits; ++i) {
+        const size_t bit = i * hex_digit_bits;
+        const uint64_t digit = (limbs[bit / CMA_U256_LIMB_BITS] >> (bit % CMA_U256_LIMB_BITS)) & 0xf;
+        out[2 + n_digits - 1 - i] = hex_digits[digit];
+    }
+    out[2 + n_digits] = '\0';
+    return CMA_U256_SUCCESS;
+}
@@ -0,0 +1,210 @@
+#ifndef CMA_U256_IMPL_H
+#define CMA_U256_IMPL_H
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+extern "C" {
+#include "libcma/types.h"
+}
+
+/*
+ * U256 kernel: amounts are handled as four 64-bit limbs, least significant first, so carries and borrows propagate a
+ * word at a time. Loading and storing converts from and to the big-endian ABI bytes.
+ */
+
+enum : size_t {
+    CMA_U256_LIMBS = CMA_ABI_U256_LENGTH / sizeof(uint64_t),
+    CMA_U256_LIMB_BITS = 64,
+};
+
+using u256_limbs_t = std::array<uint64_t, CMA_U256_LIMBS>;
+using u512_limbs_t = std::array<uint64_t, 2 * CMA_U256_LIMBS>;
+__extension__ typedef unsigned __int128 u128_t; // limb products, gcc and clang provide it on 64-bit targets
+
+inline auto u256_load_limb(const uint8_t *data) -> uint64_t {
+    uint64_t limb = 0;
+    std::memcpy(&limb, data, sizeof(limb));
+    if constexpr (std::endian::native == std::endian::little) {
+        limb = __builtin_bswap64(limb);
+    }
+    return limb;
+}
+
+inline void u256_store_limb(uint8_t *data, uint64_t limb) {
+    if constexpr (std::endian::native == std::endian::little) {
+        limb = __builtin_bswap64(limb);
+    }
+    std::memcpy(data, &limb, sizeof(limb));
+}
+
+inline auto u256_load(const cma_amount_t &amount) -> u256_limbs_t {
+    u256_limbs_t limbs{};
+    for (size_t i = 0; i < CMA_U256_LIMBS; ++i) {
+        limbs[i] = u256_load_limb(amount.data + ((CMA_U256_LIMBS - 1 - i) * sizeof(uint64_t)));
+    }
+    return limbs;
+}
+
+inline void u256_store(cma_amount_t &amount, const u256_limbs_t &limbs) {
+    for (size_t i = 0; i < CMA_U256_LIMBS; ++i) {
+        u256_store_limb(amount.data + ((CMA_U256_LIMBS - 1 - i) * sizeof(uint64_t)), limbs[i]);
+    }
+}
+
+// Returns the carry out of the top limb
+inline auto u256_add(u256_limbs_t &res, const u256_limbs_t &a, const u256_limbs_t &b) -> bool {
+    bool carry = false;
+    for (size_t i = 0; i < CMA_U256_LIMBS; ++i) {
+        uint64_t sum = 0;
+        const bool carry_ab = __builtin_add_overflow(a[i], b[i], &sum);
+        const bool carry_in = __builtin_add_overflow(sum, static_cast<uint64_t>(carry), &res[i]);
+        carry = carry_ab || carry_in;
+    }
+    return carry;
+}
+
+// Returns the borrow out of the top limb
+inline auto u256_sub(u256_limbs_t &res, const u256_limbs_t &a, const u256_limbs_t &b) -> bool {
+    bool borrow = false;
+    for (size_t i = 0; i < CMA_U256_LIMBS; ++i) {
+        uint64_t diff = 0;
+        const bool borrow_ab = __builtin_sub_overflow(a[i], b[i], &diff);
+        const bool borrow_in = __builtin_sub_overflow(diff, static_cast<uint64_t>(borrow), &res[i]);
+        borrow = borrow_ab || borrow_in;
+    }
+    return borrow;
+}
+
+inline auto u256_compare(const u256_limbs_t &a, const u256_limbs_t &b) -> int {
+    for (size_t i = CMA_U256_LIMBS; i-- > 0;) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+inline auto u256_is_zero(const u256_limbs_t &a) -> bool {
+    return (a[0] | a[1] | a[2] | a[3]) == 0;
+}
+
+// Byte order does not matter when testing for zero, so the words are not swapped
+inline auto u256_is_zero(const cma_amount_t &amount) -> bool {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < CMA_U256_LIMBS; ++i) {
+        uint64_t limb = 0;
+        std::memcpy(&limb, amount.data + (i * sizeof(uint64_t)), sizeof(limb));
+        bits |= limb;
+    }
+    return bits == 0;
+}
+
+// Full 512-bit product
+inline auto u256_mul_wide(const u256_limbs_t &a, const u256_limbs_t &b) -> u512_limbs_t {
+    u512_limbs_t res{};
+    for (size_t i = 0; i < CMA_U256_LIMBS; ++i) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < CMA_U256_LIMBS; ++j) {
+            const u128_t cur = (static_cast<u128_t>(a[i]) * b[j]) + res[i + j] + carry;
+            res[i + j] = static_cast<uint64_t>(cur);
+            carry = static_cast<uint64_t>(cur >> CMA_U256_LIMB_BITS);
+        }
+        res[i + CMA_U256_LIMBS] = carry;
+    }
+    return res;
+}
+
+// Number of limbs without the leading zero ones
+inline auto u256_significant_limbs(const uint64_t *limbs, size_t n_limbs) -> size_t {
+    while (n_limbs > 0 && limbs[n_limbs - 1] == 0) {
+        --n_limbs;
+    }
+    return n_limbs;
+}
+
+// Long division of u (m limbs) by v (n limbs, v[n - 1] != 0, m >= n), Knuth's algorithm D
+// quot receives m - n + 1 limbs and rem n limbs
+inline void u256_divmod_limbs(const uint64_t *u, size_t m, const uint64_t *v, size_t n, uint64_t *quot,
+    uint64_t *rem) {
+    if (n == 1) {
+        uint64_t k = 0;
+        for (size_t j = m; j-- > 0;) {
+            const u128_t cur = (static_cast<u128_t>(k) << CMA_U256_LIMB_BITS) | u[j];
+            quot[j] = static_cast<uint64_t>(cur / v[0]);
+            k = static_cast<uint64_t>(cur % v[0]);
+        }
+        rem[0] = k;
+        return;
+    }
+
+    // normalize so the top divisor limb has its high bit set, the quotient estimates are then off by at most two
+    const auto shift = static_cast<unsigned>(std::countl_zero(v[n - 1]));
+    const auto shift_right = [shift](uint64_t limb) -> uint64_t {
+        return shift == 0 ? 0 : limb >> (CMA_U256_LIMB_BITS - shift);
+    };
+    std::array<uint64_t, 2 * CMA_U256_LIMBS> vn{};
+    std::array<uint64_t, (2 * CMA_U256_LIMBS) + 1> un{};
+    for (size_t i = n - 1; i > 0; --i) {
+        vn[i] = (v[i] << shift) | shift_right(v[i - 1]);
+    }
+    vn[0] = v[0] << shift;
+    un[m] = shift_right(u[m - 1]);
+    for (size_t i = m - 1; i > 0; --i) {
+        un[i] = (u[i] << shift) | shift_right(u[i - 1]);
+    }
+    un[0] = u[0] << shift;
+
+    constexpr u128_t limb_base = static_cast<u128_t>(1) << CMA_U256_LIMB_BITS;
+    for (size_t j = m - n + 1; j-- > 0;) {
+        const u128_t num = (static_cast<u128_t>(un[j + n]) << CMA_U256_LIMB_BITS) | un[j + n - 1];
+        u128_t qhat = num / vn[n - 1];
+        u128_t rhat = num % vn[n - 1];
+        while (qhat >= limb_base || qhat * vn[n - 2] > ((rhat << CMA_U256_LIMB_BITS) | un[j + n - 2])) {
+            --qhat;
+            rhat += vn[n - 1];
+            if (rhat >= limb_base) {
+                break;
+            }
+        }
+
+        // multiply and subtract
+        uint64_t carry = 0;
+        bool borrow = false;
+        for (size_t i = 0; i < n; ++i) {
+            const u128_t prod = (qhat * vn[i]) + carry;
+            carry = static_cast<uint64_t>(prod >> CMA_U256_LIMB_BITS);
+            uint64_t diff = 0;
+            const bool borrow_prod = __builtin_sub_overflow(un[i + j], static_cast<uint64_t>(prod), &diff);
+            const bool borrow_in = __builtin_sub_overflow(diff, static_cast<uint64_t>(borrow), &un[i + j]);
+            borrow = borrow_prod || borrow_in;
+        }
+        const u128_t top_sub = static_cast<u128_t>(carry) + static_cast<uint64_t>(borrow);
+        const bool negative = un[j + n] < top_sub;
+        un[j + n] = static_cast<uint64_t>(un[j + n] - top_sub);
+        quot[j] = static_cast<uint64_t>(qhat);
+
+        // the estimate was one too large, add the divisor back
+        if (negative) {
+            --quot[j];
+            uint64_t add_carry = 0;
+            for (size_t i = 0; i < n; ++i) {
+                const u128_t sum = static_cast<u128_t>(un[i + j]) + vn[i] + add_carry;
+                un[i + j] = static_cast<uint64_t>(sum);
+                add_carry = static_cast<uint64_t>(sum >> CMA_U256_LIMB_BITS);
+            }
+            un[j + n] += add_carry;
+        }
+    }
+
+    // denormalize the remainder
+    for (size_t i = 0; i < n - 1; ++i) {
+        rem[i] = (un[i] >> shift) | (shift == 0 ? 0 : un[i + 1] << (CMA_U256_LIMB_BITS - shift));
+    }
+    rem[n - 1] = un[n - 1] >> shift;
+}
+
+#endif // CMA_U256_IMPL_H
@@ -6,44 +6,32 @@ extern "C" {
 #include "libcma/types.h"
 }
 
+#include "u256_impl.h"
 #include "utils.h"
 
-constexpr uint16_t carry_shift = 8U;
-
 auto amount_checked_add(cma_amount_t &res, const cma_amount_t &amount_a, const cma_amount_t &amount_b) -> bool {
-    uint16_t carry = 0;
-    for (size_t i = 0; i < sizeof(res.data); ++i) {
-        const size_t j_ind = sizeof(res.data) - i - 1;
-        const uint16_t a_j = amount_a.data[j_ind];
-        const uint16_t b_j = amount_b.data[j_ind];
-        const uint16_t tmp = carry + a_j + b_j;
-        res.data[j_ind] = static_cast<uint8_t>(tmp);
-        carry = tmp >> carry_shift;
-    }
-    return carry == 0;
+    u256_limbs_t res_limbs{};
+    const bool carry = u256_add(res_limbs, u256_load(amount_a), u256_load(amount_b));
+    u256_store(res, res_limbs);
+    return !carry;
 }
 
 auto amount_checked_sub(cma_amount_t &res, const cma_amount_t &amount_a, const cma_amount_t &amount_b) -> bool {
-    uint16_t borrow = 0;
-    const uint16_t fix_borrow = 1 << carry_shift;
-    for (size_t i = 0; i < sizeof(res.data); ++i) {
-        const size_t j_ind = sizeof(res.data) - i - 1;
-        const uint16_t a_j = amount_a.data[j_ind];
-        const uint16_t b_j = amount_b.data[j_ind];
-        uint16_t tmp = 0;
-        if (borrow + b_j > a_j) {
-            tmp = a_j + fix_borrow - borrow - b_j;
-            borrow = 1;
-        } else {
-            tmp = a_j - borrow - b_j;
-            borrow = 0;
-        }
-        res.data[j_ind] = static_cast<uint8_t>(tmp);
-    }
-    return borrow == 0;
+    u256_limbs_t res_limbs{};
+    const bool borrow = u256_sub(res_limbs, u256_load(amount_a), u256_load(amount_b));
+    u256_store(res, res_limbs);
+    return !borrow;
+}
+
+auto amount_compare(const cma_amount_t &amount_a, const cma_amount_t &amount_b) -> int {
+    return u256_compare(u256_load(amount_a), u256_load(amount_b));
 }
 
 auto is_zero(const cma_amount_t &amount) -> bool {
-    static const cma_amount_t zero = {.data = {0}};
-    return std::memcmp(amount.data, zero.data, sizeof(amount.data)) == 0;
+    return u256_is_zero(amount);
+}
+
+auto is_one(const cma_amount_t &amount) -> bool {
+    const u256_limbs_t limbs = u256_load(amount);
+    return (limbs[1] | limbs[2] | limbs[3]) == 0 && limbs[0] == 1;
 }
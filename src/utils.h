@@ -11,7 +11,9 @@ extern "C" {
 
 auto amount_checked_add(cma_amount_t &res, const cma_amount_t &amount_a, const cma_amount_t &amount_b) -> bool;
 auto amount_checked_sub(cma_amount_t &res, const cma_amount_t &amount_a, const cma_amount_t &amount_b) -> bool;
+auto amount_compare(const cma_amount_t &amount_a, const cma_amount_t &amount_b) -> int;
 auto is_zero(const cma_amount_t &amount) -> bool;
+auto is_one(const cma_amount_t &amount) -> bool;
 
 // Custom exception class
 class CmaException : public std::exception {
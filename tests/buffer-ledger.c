@@ -11,6 +11,8 @@
 #define MAX_BALANCES 8 * MAX_ACCOUNTS //< Max balances
 #define MAX_ASSETS 8UL                //< Maximum number of assets.
 #define MEM_LENGTH 64UL * 1024 * 1024 // 34998174UL //< State length
+#define N_HOLDERS 64UL                //< Accounts holding the asset in the holder tests
+#define HOLDER_PAGE 10UL              //< Holders listed per call
 
 void test_init_and_fini(void) {
     uint8_t *buffer = malloc(MEM_LENGTH);
@@ -20,7 +22,7 @@ void test_init_and_fini(void) {
 
     assert(cma_ledger_fini(&ledger) == -EINVAL);
 
-    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, 2 * MAX_ACCOUNTS, 2 * MAX_ASSETS, 2 * MAX_BALANCES) ==
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, 4 * MAX_ACCOUNTS, 4 * MAX_ASSETS, 4 * MAX_BALANCES) ==
         -ENOBUFS);
 
     assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
@@ -839,7 +841,7 @@ void test_remove(void) {
 }
 
 void test_balance_mem(void) {
-    const size_t buf_size = CMA_LEDGER_MIN_MEM_LENGTH + 4340;
+    const size_t buf_size = CMA_LEDGER_MIN_MEM_LENGTH + 7000;
     uint8_t *buffer = malloc(buf_size);
     assert(buffer != NULL);
     cma_ledger_t ledger;
@@ -1345,6 +1347,838 @@ void test_transfer(void) {
     printf("%s passed\n", __FUNCTION__);
 }
 
+void test_rollback(void) {
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+
+    assert(cma_ledger_rollback(NULL) == -EINVAL);
+    assert(cma_ledger_rollback(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+
+    // clang-format off
+    cma_ledger_account_t account1 = {.address = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    }}};
+    cma_ledger_account_t account2 = {.address = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+    }}};
+    cma_amount_t amount = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10,
+        0x00, 0x04,
+    }};
+    // clang-format on;
+    cma_ledger_account_id_t account_id1;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id1, &account1, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id1, &amount) == CMA_LEDGER_SUCCESS);
+
+    // transfer to a new account, deposit a new asset, then fail half-way
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    cma_ledger_account_id_t account_id2;
+    account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id2, &account2, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_transfer(&ledger, asset_id, account_id1, account_id2, &amount) == CMA_LEDGER_SUCCESS);
+    cma_ledger_asset_id_t asset_id2;
+    asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id2, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_id2, account_id1, &amount) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_withdraw(&ledger, asset_id, account_id1, &amount) == CMA_LEDGER_ERROR_INSUFFICIENT_FUNDS);
+    assert(cma_ledger_rollback(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_rollback(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+
+    // abort discards the changes as well
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id1, &amount) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_abort(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_abort(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+
+    asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id2, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_FIND) ==
+        CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+    account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+    assert(cma_ledger_retrieve_account(&ledger, NULL, &account2, NULL, NULL, &account_type, CMA_LEDGER_OP_FIND) ==
+        CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+
+    cma_amount_t balance = {};
+    size_t n_balances = 0;
+    assert(cma_ledger_get_balance(&ledger, asset_id, account_id1, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, amount.data, CMA_ABI_U256_LENGTH) == 0);
+    account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id1, NULL, NULL, &n_balances, &account_type,
+               CMA_LEDGER_OP_FIND) == CMA_LEDGER_SUCCESS);
+    assert(n_balances == 1);
+    cma_amount_t supply = {};
+    asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, &supply, &asset_type, CMA_LEDGER_OP_FIND) ==
+        CMA_LEDGER_SUCCESS);
+    assert(memcmp(supply.data, amount.data, CMA_ABI_U256_LENGTH) == 0);
+
+    // ids are reused after rollback
+    account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id2, &account2, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(account_id2 == account_id1 + 1);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(buffer);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_apply_batch(void) {
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+    cma_ledger_account_id_t account_id1;
+    cma_ledger_account_id_t account_id2;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id1, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id2, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    // clang-format off
+    cma_amount_t amount = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10,
+        0x00, 0x04,
+    }};
+    // clang-format on;
+    cma_ledger_op_t ops[] = {
+        {.type = CMA_LEDGER_OP_TYPE_DEPOSIT, .asset_id = asset_id, .to_account_id = account_id1, .amount = amount},
+        {.type = CMA_LEDGER_OP_TYPE_TRANSFER, .asset_id = asset_id, .from_account_id = account_id1,
+            .to_account_id = account_id2, .amount = amount},
+        {.type = CMA_LEDGER_OP_TYPE_WITHDRAW, .asset_id = asset_id, .from_account_id = account_id1, .amount = amount},
+        {.type = CMA_LEDGER_OP_TYPE_DEPOSIT, .asset_id = asset_id, .to_account_id = account_id1, .amount = amount},
+    };
+    cma_ledger_op_result_t results[4] = {};
+
+    assert(cma_ledger_apply_batch(NULL, ops, 4, results, CMA_LEDGER_BATCH_BEST_EFFORT) == -EINVAL);
+    assert(cma_ledger_apply_batch(&ledger, NULL, 4, results, CMA_LEDGER_BATCH_BEST_EFFORT) == -EINVAL);
+    assert(cma_ledger_apply_batch(&ledger, ops, 4, results, (cma_ledger_batch_mode_t) 42) == -EINVAL);
+
+    // all or nothing: the withdrawal fails and the whole batch is undone
+    assert(cma_ledger_apply_batch(&ledger, ops, 4, results, CMA_LEDGER_BATCH_ALL_OR_NOTHING) ==
+        CMA_LEDGER_ERROR_INSUFFICIENT_FUNDS);
+    assert(results[0].status == -ECANCELED);
+    assert(results[1].status == -ECANCELED);
+    assert(results[2].status == CMA_LEDGER_ERROR_INSUFFICIENT_FUNDS);
+    assert(results[3].status == -ECANCELED);
+    cma_amount_t balance = {};
+    cma_amount_t zero = {};
+    assert(cma_ledger_get_balance(&ledger, asset_id, account_id2, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, zero.data, CMA_ABI_U256_LENGTH) == 0);
+
+    // best effort: only the withdrawal fails
+    assert(cma_ledger_apply_batch(&ledger, ops, 4, results, CMA_LEDGER_BATCH_BEST_EFFORT) ==
+        CMA_LEDGER_ERROR_INSUFFICIENT_FUNDS);
+    assert(results[0].status == CMA_LEDGER_SUCCESS);
+    assert(results[1].status == CMA_LEDGER_SUCCESS);
+    assert(results[2].status == CMA_LEDGER_ERROR_INSUFFICIENT_FUNDS);
+    assert(results[3].status == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_balance(&ledger, asset_id, account_id1, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, amount.data, CMA_ABI_U256_LENGTH) == 0);
+    assert(cma_ledger_get_balance(&ledger, asset_id, account_id2, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, amount.data, CMA_ABI_U256_LENGTH) == 0);
+
+    assert(cma_ledger_apply_batch(&ledger, ops, 2, NULL, CMA_LEDGER_BATCH_ALL_OR_NOTHING) == CMA_LEDGER_SUCCESS);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(buffer);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_transfer_multi(void) {
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_id_t asset_id1;
+    cma_ledger_asset_id_t asset_id2;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id1, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id2, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+    cma_ledger_account_id_t account_id1;
+    cma_ledger_account_id_t account_id2;
+    cma_ledger_account_id_t account_id3;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id1, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id2, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id3, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    // clang-format off
+    cma_amount_t amount = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10,
+        0x00, 0x04,
+    }};
+    // clang-format on;
+    cma_amount_t balance = {};
+    cma_amount_t zero = {};
+    assert(cma_ledger_deposit(&ledger, asset_id1, account_id1, &amount) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_id2, account_id3, &amount) == CMA_LEDGER_SUCCESS);
+
+    // account 2 forwards what it receives, account 3 pays in another asset
+    cma_ledger_transfer_leg_t legs[] = {
+        {.asset_id = asset_id1, .from_account_id = account_id2, .to_account_id = account_id3, .amount = amount},
+        {.asset_id = asset_id1, .from_account_id = account_id1, .to_account_id = account_id2, .amount = amount},
+        {.asset_id = asset_id2, .from_account_id = account_id3, .to_account_id = account_id1, .amount = amount},
+    };
+    assert(cma_ledger_transfer_multi(NULL, legs, 3) == -EINVAL);
+    assert(cma_ledger_transfer_multi(&ledger, NULL, 3) == -EINVAL);
+    assert(cma_ledger_transfer_multi(&ledger, NULL, 0) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_transfer_multi(&ledger, legs, 3) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_balance(&ledger, asset_id1, account_id1, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, zero.data, CMA_ABI_U256_LENGTH) == 0);
+    assert(cma_ledger_get_balance(&ledger, asset_id1, account_id2, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, zero.data, CMA_ABI_U256_LENGTH) == 0);
+    assert(cma_ledger_get_balance(&ledger, asset_id1, account_id3, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, amount.data, CMA_ABI_U256_LENGTH) == 0);
+    assert(cma_ledger_get_balance(&ledger, asset_id2, account_id1, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, amount.data, CMA_ABI_U256_LENGTH) == 0);
+    assert(cma_ledger_get_balance(&ledger, asset_id2, account_id3, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, zero.data, CMA_ABI_U256_LENGTH) == 0);
+
+    // the second leg overdraws account 3, so the first one is not applied either
+    cma_ledger_transfer_leg_t overdraw_legs[] = {
+        {.asset_id = asset_id1, .from_account_id = account_id3, .to_account_id = account_id1, .amount = amount},
+        {.asset_id = asset_id1, .from_account_id = account_id3, .to_account_id = account_id2, .amount = amount},
+    };
+    assert(cma_ledger_transfer_multi(&ledger, overdraw_legs, 2) == CMA_LEDGER_ERROR_INSUFFICIENT_FUNDS);
+    assert(cma_ledger_get_balance(&ledger, asset_id1, account_id1, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, zero.data, CMA_ABI_U256_LENGTH) == 0);
+    assert(cma_ledger_get_balance(&ledger, asset_id1, account_id3, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, amount.data, CMA_ABI_U256_LENGTH) == 0);
+
+    cma_ledger_transfer_leg_t invalid_legs[] = {
+        {.asset_id = asset_id1, .from_account_id = account_id3, .to_account_id = account_id1, .amount = amount},
+        {.asset_id = asset_id1, .from_account_id = account_id2, .to_account_id = account_id2, .amount = amount},
+    };
+    assert(cma_ledger_transfer_multi(&ledger, invalid_legs, 2) == -EINVAL);
+    invalid_legs[1].to_account_id = 42;
+    assert(cma_ledger_transfer_multi(&ledger, invalid_legs, 2) == CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+    invalid_legs[1].asset_id = 42;
+    assert(cma_ledger_transfer_multi(&ledger, invalid_legs, 2) == CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+    assert(cma_ledger_get_balance(&ledger, asset_id1, account_id3, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, amount.data, CMA_ABI_U256_LENGTH) == 0);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(buffer);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_find_or_create(void) {
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, 2, 1, MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+
+    // clang-format off
+    cma_ledger_account_t account1 = {.address = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    }}};
+    cma_ledger_account_t account2 = {.address = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+    }}};
+    cma_ledger_account_t account3 = {.address = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+    }}};
+    cma_token_address_t token_address1 = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    }};
+    cma_token_address_t token_address2 = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+    }};
+    // clang-format on
+
+    cma_ledger_account_id_t account_id1;
+    cma_ledger_account_id_t account_id2;
+    cma_ledger_account_id_t account_id;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id1, &account1, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_FIND_OR_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id2, &account2, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_FIND_OR_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, &account1, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_FIND_OR_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(account_id == account_id1);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, &account2, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_ERROR_INSERTION_ERROR);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, &account2, NULL, NULL, &account_type,
+               (cma_ledger_retrieve_operation_t) 42) == -EINVAL);
+
+    // a failed creation leaves no reverse key behind
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, &account3, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_FIND_OR_CREATE) == CMA_LEDGER_ERROR_MAX_ACCOUNTS_REACHED);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, &account3, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_FIND) == CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+
+    cma_ledger_asset_id_t asset_id1;
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id1, &token_address1, NULL, NULL, &asset_type,
+               CMA_LEDGER_OP_FIND_OR_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address1, NULL, NULL, &asset_type,
+               CMA_LEDGER_OP_FIND_OR_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(asset_id == asset_id1);
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address2, NULL, NULL, &asset_type,
+               CMA_LEDGER_OP_FIND_OR_CREATE) == CMA_LEDGER_ERROR_MAX_ASSETS_REACHED);
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address2, NULL, NULL, &asset_type,
+               CMA_LEDGER_OP_FIND) == CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(buffer);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_id_tables(void) {
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, 3, 2, MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_account_id_t account_id1;
+    cma_ledger_account_id_t account_id2;
+    cma_ledger_account_id_t account_id;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id1, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id2, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(account_id2 == account_id1 + 1);
+
+    // ids not yet created and ids past the table are not found
+    account_id = account_id2 + 1;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type, CMA_LEDGER_OP_FIND) ==
+        CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+    account_id = 1000;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type, CMA_LEDGER_OP_FIND) ==
+        CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+
+    // a removed id is a tombstone, it is not found nor reused
+    account_id = account_id1;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_FIND_AND_REMOVE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type, CMA_LEDGER_OP_FIND) ==
+        CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+    account_id = account_id2;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type, CMA_LEDGER_OP_FIND) ==
+        CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(account_id == account_id2 + 1);
+
+    cma_ledger_asset_id_t asset_id1;
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id1, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+    asset_id = asset_id1 + 1;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_FIND) ==
+        CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+    asset_id = asset_id1;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, NULL, &asset_type,
+               CMA_LEDGER_OP_FIND_AND_REMOVE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_FIND) ==
+        CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(buffer);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+static cma_amount_t small_amount(size_t value) {
+    cma_amount_t amount = {0};
+    amount.data[sizeof(amount.data) - 2] = (uint8_t) (value >> 8);
+    amount.data[sizeof(amount.data) - 1] = (uint8_t) value;
+    return amount;
+}
+
+void test_virtual_balance_pool(void) {
+    // more virtual balances than the initial reservation, filling the pool to max balances
+    const size_t n_accounts = 3000;
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, n_accounts, 1, n_accounts) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    for (size_t i = 0; i < n_accounts; i++) {
+        cma_ledger_account_id_t account_id;
+        assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+        assert(account_id == i);
+        cma_amount_t amount = small_amount(i + 1);
+        assert(cma_ledger_deposit(&ledger, asset_id, account_id, &amount) == CMA_LEDGER_SUCCESS);
+    }
+
+    // draining balances frees their slots without moving the others
+    for (size_t i = 0; i < n_accounts; i += 2) {
+        cma_amount_t amount = small_amount(i + 1);
+        assert(cma_ledger_withdraw(&ledger, asset_id, i, &amount) == CMA_LEDGER_SUCCESS);
+    }
+    cma_amount_t balance;
+    for (size_t i = 0; i < n_accounts; i++) {
+        assert(cma_ledger_get_balance(&ledger, asset_id, i, &balance, NULL) == CMA_LEDGER_SUCCESS);
+        cma_amount_t expected = small_amount(i % 2 == 0 ? 0 : i + 1);
+        assert(memcmp(balance.data, expected.data, sizeof(balance.data)) == 0);
+    }
+
+    // freed slots are reused
+    for (size_t i = 0; i < n_accounts; i += 2) {
+        cma_amount_t amount = small_amount(n_accounts - i);
+        assert(cma_ledger_deposit(&ledger, asset_id, i, &amount) == CMA_LEDGER_SUCCESS);
+    }
+    for (size_t i = 0; i < n_accounts; i++) {
+        assert(cma_ledger_get_balance(&ledger, asset_id, i, &balance, NULL) == CMA_LEDGER_SUCCESS);
+        cma_amount_t expected = small_amount(i % 2 == 0 ? n_accounts - i : i + 1);
+        assert(memcmp(balance.data, expected.data, sizeof(balance.data)) == 0);
+    }
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(buffer);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_presize(void) {
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_presize(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+    // presized tables fit in the memory required for the maximums
+    assert(cma_ledger_presize(&ledger) == CMA_LEDGER_SUCCESS);
+
+    // fill the ledger up to the maximums
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    for (size_t i = 0; i < MAX_ASSETS; i++) {
+        cma_ledger_asset_id_t asset_id;
+        assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+            CMA_LEDGER_SUCCESS);
+    }
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    for (size_t i = 0; i < MAX_ACCOUNTS; i++) {
+        cma_ledger_account_id_t account_id;
+        assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+        for (size_t j = 0; j < MAX_ASSETS; j++) {
+            cma_amount_t amount = small_amount(i + j + 1);
+            assert(cma_ledger_deposit(&ledger, j, account_id, &amount) == CMA_LEDGER_SUCCESS);
+        }
+    }
+    cma_amount_t balance;
+    for (size_t i = 0; i < MAX_ACCOUNTS; i++) {
+        for (size_t j = 0; j < MAX_ASSETS; j++) {
+            assert(cma_ledger_get_balance(&ledger, j, i, &balance, NULL) == CMA_LEDGER_SUCCESS);
+            cma_amount_t expected = small_amount(i + j + 1);
+            assert(memcmp(balance.data, expected.data, sizeof(balance.data)) == 0);
+        }
+    }
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(buffer);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+static void fill_seeded_ledger(uint8_t *buffer, const uint8_t *seed) {
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_set_hash_seed(&ledger, seed) == CMA_LEDGER_SUCCESS);
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+    cma_token_address_t token = {.data = {0xaa}};
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+    for (size_t i = 0; i < N_HOLDERS; i++) {
+        cma_ledger_account_t account = {.address = {.data = {0x01, (uint8_t) i}}};
+        cma_ledger_account_id_t account_id;
+        assert(cma_ledger_retrieve_account(&ledger, &account_id, &account, NULL, NULL, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+        cma_amount_t amount = small_amount(i + 1);
+        assert(cma_ledger_deposit(&ledger, asset_id, account_id, &amount) == CMA_LEDGER_SUCCESS);
+    }
+    // the seed can't change once keys were hashed with it
+    assert(cma_ledger_set_hash_seed(&ledger, seed) == -EBUSY);
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+}
+
+void test_hash_seed(void) {
+    uint8_t seed[CMA_LEDGER_HASH_SEED_LENGTH];
+    for (size_t i = 0; i < sizeof(seed); i++) {
+        seed[i] = (uint8_t) (0xc0 + i);
+    }
+    cma_ledger_t ledger;
+    assert(cma_ledger_init(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_set_hash_seed(&ledger, seed) == -ENOTSUP);
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+
+    // the same seed and operations build the same image
+    uint8_t *lhs = calloc(1, MEM_LENGTH);
+    uint8_t *rhs = calloc(1, MEM_LENGTH);
+    assert(lhs != NULL && rhs != NULL);
+    fill_seeded_ledger(lhs, seed);
+    fill_seeded_ledger(rhs, seed);
+    assert(memcmp(lhs, rhs, MEM_LENGTH) == 0);
+
+    memset(lhs, 0, MEM_LENGTH);
+    assert(cma_ledger_init_buffer(&ledger, lhs, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_set_hash_seed(&ledger, seed) == CMA_LEDGER_ERROR_TRANSACTION);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(lhs);
+    free(rhs);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_rollback_remove(void) {
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_token_address_t token_address = {.data = {0xaa, [CMA_ABI_ADDRESS_LENGTH - 1] = 0x01}};
+    cma_token_id_t token_id = {.data = {0xbb, [CMA_ABI_ID_LENGTH - 1] = 0x02}};
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address, &token_id, NULL, &asset_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    cma_ledger_account_t account = {.address = {.data = {0xcc, [CMA_ABI_ADDRESS_LENGTH - 1] = 0x03}}};
+    cma_ledger_account_id_t account_id;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, &account, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    // removed records come back whole, with their keys
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address, &token_id, NULL, &asset_type,
+               CMA_LEDGER_OP_FIND_AND_REMOVE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, &account, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_FIND_AND_REMOVE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_rollback(&ledger) == CMA_LEDGER_SUCCESS);
+
+    cma_token_address_t token_address_found = {0};
+    cma_token_id_t token_id_found = {0};
+    cma_ledger_asset_type_t asset_type_found = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address_found, &token_id_found, NULL,
+               &asset_type_found, CMA_LEDGER_OP_FIND) == CMA_LEDGER_SUCCESS);
+    assert(asset_type_found == CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID);
+    assert(memcmp(token_address_found.data, token_address.data, sizeof(token_address.data)) == 0);
+    assert(memcmp(token_id_found.data, token_id.data, sizeof(token_id.data)) == 0);
+    cma_ledger_asset_id_t asset_id_found;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id_found, &token_address, &token_id, NULL, &asset_type,
+               CMA_LEDGER_OP_FIND) == CMA_LEDGER_SUCCESS);
+    assert(asset_id_found == asset_id);
+
+    cma_ledger_account_t account_found = {0};
+    cma_ledger_account_type_t account_type_found = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, &account_found, NULL, NULL, &account_type_found,
+               CMA_LEDGER_OP_FIND) == CMA_LEDGER_SUCCESS);
+    assert(account_type_found == CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS);
+    assert(memcmp(account_found.address.data, account.address.data, sizeof(account.address.data)) == 0);
+    cma_ledger_account_id_t account_id_found;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id_found, &account, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_FIND) == CMA_LEDGER_SUCCESS);
+    assert(account_id_found == account_id);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(buffer);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+// Checks the listing holds exactly the assets of the mask, each with small_amount(asset_id + 1)
+static void assert_account_balances(cma_ledger_t *ledger, cma_ledger_account_id_t account_id, unsigned asset_mask) {
+    cma_ledger_asset_balance_t listed[MAX_ASSETS];
+    size_t n_balances = 0;
+    assert(cma_ledger_list_account_balances(ledger, account_id, listed, MAX_ASSETS, &n_balances) ==
+        CMA_LEDGER_SUCCESS);
+    assert(n_balances == (size_t) __builtin_popcount(asset_mask));
+    unsigned seen = 0;
+    for (size_t i = 0; i < n_balances; i++) {
+        assert(listed[i].asset_id < MAX_ASSETS);
+        const unsigned bit = 1U << listed[i].asset_id;
+        assert((asset_mask & bit) != 0 && (seen & bit) == 0);
+        seen |= bit;
+        cma_amount_t expected = small_amount(listed[i].asset_id + 1);
+        assert(memcmp(listed[i].amount.data, expected.data, sizeof(expected.data)) == 0);
+    }
+}
+
+void test_list_account_balances(void) {
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+    for (size_t i = 0; i < MAX_ASSETS; i++) {
+        cma_token_address_t token_address = {.data = {0xaa, [CMA_ABI_ADDRESS_LENGTH - 1] = (uint8_t) i}};
+        cma_ledger_asset_id_t asset_id;
+        assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address, NULL, NULL, &asset_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+        assert(asset_id == i);
+    }
+    // a wallet holds withdrawable balances and an id account virtual ones
+    cma_ledger_account_t wallet = {.address = {.data = {0xcc, [CMA_ABI_ADDRESS_LENGTH - 1] = 0x01}}};
+    cma_ledger_account_id_t account_ids[2];
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+    assert(cma_ledger_retrieve_account(&ledger, &account_ids[0], &wallet, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    assert(cma_ledger_retrieve_account(&ledger, &account_ids[1], NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    size_t n_balances = 1;
+    assert(cma_ledger_list_account_balances(&ledger, account_ids[0], NULL, 0, &n_balances) == CMA_LEDGER_SUCCESS);
+    assert(n_balances == 0);
+    assert(cma_ledger_list_account_balances(&ledger, account_ids[0], NULL, 0, NULL) == -EINVAL);
+    assert(cma_ledger_list_account_balances(&ledger, 1000, NULL, 0, &n_balances) ==
+        CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+
+    for (size_t a = 0; a < 2; a++) {
+        for (size_t i = 0; i < MAX_ASSETS; i++) {
+            cma_amount_t amount = small_amount(i + 1);
+            assert(cma_ledger_deposit(&ledger, i, account_ids[a], &amount) == CMA_LEDGER_SUCCESS);
+        }
+        assert_account_balances(&ledger, account_ids[a], 0xff);
+
+        // drained balances leave the list wherever they are in it
+        const cma_ledger_asset_id_t drained[] = {0, 3, 7};
+        for (size_t i = 0; i < sizeof(drained) / sizeof(drained[0]); i++) {
+            cma_amount_t amount = small_amount(drained[i] + 1);
+            assert(cma_ledger_withdraw(&ledger, drained[i], account_ids[a], &amount) == CMA_LEDGER_SUCCESS);
+        }
+        assert_account_balances(&ledger, account_ids[a], 0x76);
+    }
+
+    // the count is the whole list even when the output is shorter
+    cma_ledger_asset_balance_t listed[3] = {0};
+    listed[2].asset_id = 1000;
+    assert(cma_ledger_list_account_balances(&ledger, account_ids[0], listed, 2, &n_balances) == CMA_LEDGER_SUCCESS);
+    assert(n_balances == 5);
+    assert(listed[2].asset_id == 1000);
+
+    // rolled back balances are listed again
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    cma_amount_t amount = small_amount(2);
+    assert(cma_ledger_transfer(&ledger, 1, account_ids[0], account_ids[1], &amount) == CMA_LEDGER_SUCCESS);
+    amount = small_amount(1);
+    assert(cma_ledger_deposit(&ledger, 0, account_ids[0], &amount) == CMA_LEDGER_SUCCESS);
+    assert_account_balances(&ledger, account_ids[0], 0x75);
+    assert(cma_ledger_rollback(&ledger) == CMA_LEDGER_SUCCESS);
+    assert_account_balances(&ledger, account_ids[0], 0x76);
+    assert_account_balances(&ledger, account_ids[1], 0x76);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(buffer);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_get_owner(void) {
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID;
+    cma_token_address_t token_address = {.data = {[CMA_ABI_ADDRESS_LENGTH - 1] = 0x01}};
+    cma_token_id_t token_id = {.data = {[CMA_ABI_U256_LENGTH - 1] = 0x01}};
+    cma_ledger_asset_id_t nft_id;
+    assert(cma_ledger_retrieve_asset(&ledger, &nft_id, &token_address, &token_id, NULL, &asset_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    cma_ledger_asset_id_t fungible_id;
+    assert(cma_ledger_retrieve_asset(&ledger, &fungible_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+    cma_ledger_account_id_t account_ids[2];
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    for (size_t i = 0; i < 2; i++) {
+        assert(cma_ledger_retrieve_account(&ledger, &account_ids[i], NULL, NULL, NULL, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    }
+
+    cma_ledger_account_id_t owner = 1000;
+    assert(cma_ledger_get_owner(&ledger, nft_id, NULL) == -EINVAL);
+    assert(cma_ledger_get_owner(&ledger, 1000, &owner) == CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+    assert(cma_ledger_get_owner(&ledger, fungible_id, &owner) == -EINVAL);
+    assert(cma_ledger_get_owner(&ledger, nft_id, &owner) == CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+    assert(owner == 1000);
+
+    // the owner follows the token on deposit, transfer and withdraw
+    cma_amount_t one = {.data = {[CMA_ABI_U256_LENGTH - 1] = 0x01}};
+    assert(cma_ledger_deposit(&ledger, nft_id, account_ids[0], &one) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_owner(&ledger, nft_id, &owner) == CMA_LEDGER_SUCCESS);
+    assert(owner == account_ids[0]);
+    assert(cma_ledger_transfer(&ledger, nft_id, account_ids[0], account_ids[1], &one) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_owner(&ledger, nft_id, &owner) == CMA_LEDGER_SUCCESS);
+    assert(owner == account_ids[1]);
+
+    // a rolled back transfer restores the previous owner
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_transfer(&ledger, nft_id, account_ids[1], account_ids[0], &one) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_owner(&ledger, nft_id, &owner) == CMA_LEDGER_SUCCESS);
+    assert(owner == account_ids[0]);
+    assert(cma_ledger_rollback(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_owner(&ledger, nft_id, &owner) == CMA_LEDGER_SUCCESS);
+    assert(owner == account_ids[1]);
+
+    assert(cma_ledger_withdraw(&ledger, nft_id, account_ids[1], &one) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_owner(&ledger, nft_id, &owner) == CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(buffer);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+// Walks the holders page by page, each account i of the mask holding i + 1
+static void assert_asset_holders(cma_ledger_t *ledger, cma_ledger_asset_id_t asset_id, uint64_t holder_mask) {
+    cma_ledger_holder_balance_t page[HOLDER_PAGE];
+    size_t n_holders = 0;
+    uint64_t seen = 0;
+    size_t n_listed = 0;
+    cma_ledger_account_id_t cursor = 0;
+    do {
+        assert(cma_ledger_list_asset_holders(ledger, asset_id, n_listed == 0 ? NULL : &cursor, page, HOLDER_PAGE,
+                   &n_holders) == CMA_LEDGER_SUCCESS);
+        assert(n_holders == (size_t) __builtin_popcountll(holder_mask));
+        for (size_t i = 0; i < HOLDER_PAGE && n_listed < n_holders; i++, n_listed++) {
+            assert(page[i].account_id < N_HOLDERS);
+            const uint64_t bit = 1ULL << page[i].account_id;
+            assert((holder_mask & bit) != 0 && (seen & bit) == 0);
+            seen |= bit;
+            cma_amount_t expected = small_amount(page[i].account_id + 1);
+            assert(memcmp(page[i].amount.data, expected.data, sizeof(expected.data)) == 0);
+            cursor = page[i].account_id;
+        }
+    } while (n_listed < n_holders);
+    assert(seen == holder_mask);
+}
+
+void test_list_asset_holders(void) {
+    uint8_t *buffer = malloc(MEM_LENGTH);
+    assert(buffer != NULL);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+    cma_token_address_t token_address = {.data = {0xaa, [CMA_ABI_ADDRESS_LENGTH - 1] = 0x01}};
+    cma_ledger_asset_id_t asset_id;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address, NULL, NULL, &asset_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    size_t n_holders = 1;
+    assert(cma_ledger_list_asset_holders(&ledger, asset_id, NULL, NULL, 0, &n_holders) == CMA_LEDGER_SUCCESS);
+    assert(n_holders == 0);
+    assert(cma_ledger_list_asset_holders(&ledger, asset_id, NULL, NULL, 1, &n_holders) == -EINVAL);
+    assert(cma_ledger_list_asset_holders(&ledger, 1000, NULL, NULL, 0, &n_holders) ==
+        CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+
+    // wallets hold withdrawable balances and id accounts virtual ones, both are listed
+    for (size_t i = 0; i < N_HOLDERS; i++) {
+        cma_ledger_account_id_t account_id;
+        cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+        if (i % 2 == 0) {
+            cma_ledger_account_t wallet = {.address = {.data = {0xcc, [CMA_ABI_ADDRESS_LENGTH - 1] = (uint8_t) i}}};
+            account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+            assert(cma_ledger_retrieve_account(&ledger, &account_id, &wallet, NULL, NULL, &account_type,
+                       CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+        } else {
+            assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type,
+                       CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+        }
+        assert(account_id == i);
+        cma_amount_t amount = small_amount(i + 1);
+        assert(cma_ledger_deposit(&ledger, asset_id, account_id, &amount) == CMA_LEDGER_SUCCESS);
+    }
+    assert_asset_holders(&ledger, asset_id, UINT64_MAX);
+
+    // drained balances leave the list wherever they are in it
+    uint64_t holder_mask = UINT64_MAX;
+    for (size_t i = 0; i < N_HOLDERS; i += 3) {
+        cma_amount_t amount = small_amount(i + 1);
+        assert(cma_ledger_withdraw(&ledger, asset_id, i, &amount) == CMA_LEDGER_SUCCESS);
+        holder_mask &= ~(1ULL << i);
+    }
+    assert_asset_holders(&ledger, asset_id, holder_mask);
+
+    // a page after the last holder only reports the count
+    cma_ledger_holder_balance_t all[N_HOLDERS];
+    assert(cma_ledger_list_asset_holders(&ledger, asset_id, NULL, all, N_HOLDERS, &n_holders) == CMA_LEDGER_SUCCESS);
+    assert(n_holders == (size_t) __builtin_popcountll(holder_mask));
+    cma_ledger_holder_balance_t page[HOLDER_PAGE];
+    page[0].account_id = 1000;
+    assert(cma_ledger_list_asset_holders(&ledger, asset_id, &all[n_holders - 1].account_id, page, HOLDER_PAGE,
+               &n_holders) == CMA_LEDGER_SUCCESS);
+    assert(n_holders == (size_t) __builtin_popcountll(holder_mask));
+    assert(page[0].account_id == 1000);
+
+    // an account that no longer holds the asset can't resume a listing
+    const cma_ledger_account_id_t drained = 0;
+    assert(cma_ledger_list_asset_holders(&ledger, asset_id, &drained, page, HOLDER_PAGE, &n_holders) ==
+        CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+
+    // a holder emptied by a transfer is listed again after the rollback
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    cma_amount_t amount = small_amount(2);
+    assert(cma_ledger_transfer(&ledger, asset_id, 1, 0, &amount) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_list_asset_holders(&ledger, asset_id, NULL, NULL, 0, &n_holders) == CMA_LEDGER_SUCCESS);
+    assert(n_holders == (size_t) __builtin_popcountll(holder_mask));
+    assert(cma_ledger_rollback(&ledger) == CMA_LEDGER_SUCCESS);
+    assert_asset_holders(&ledger, asset_id, holder_mask);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    free(buffer);
+    printf("%s passed\n", __FUNCTION__);
+}
+
 int main(void) {
     test_init_and_fini();
     test_init_and_reset();
@@ -1362,6 +2196,18 @@ int main(void) {
     test_transfer();
     test_remove();
     test_balance_mem();
+    test_rollback();
+    test_rollback_remove();
+    test_apply_batch();
+    test_transfer_multi();
+    test_find_or_create();
+    test_id_tables();
+    test_virtual_balance_pool();
+    test_presize();
+    test_hash_seed();
+    test_list_account_balances();
+    test_get_owner();
+    test_list_asset_holders();
     printf("All buffer-ledger tests passed!\n");
     return 0;
 }
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "libcma/ledger.h"
@@ -12,7 +13,10 @@
 #define MAX_ASSETS 8UL                //< Maximum number of assets.
 #define MEM_LENGTH 64UL * 1024 * 1024 //< State length
 #define FILE_SIZE 1 * MEM_LENGTH      //< State file size
+#define WAL_LENGTH 64UL * 1024      //< Write-ahead log length
+#define UNALIGNED_OFFSET 100UL        //< File offset of a ledger not starting on a page boundary
 #define TMPFILE_PATH_SIZE 15
+#define WAL_FILE_SUFFIX "-wal"        //< Appended to the ledger file name for its write-ahead log
 
 int create_temp_file(char *filepath_template, size_t size) {
     int fd = mkstemp(filepath_template);
@@ -36,8 +40,8 @@ void test_init_and_fini(void) {
 
     assert(cma_ledger_fini(&ledger) == -EINVAL);
 
-    assert(cma_ledger_init_file(&ledger, temp_filepath, CMA_LEDGER_CREATE_ONLY, 0, MEM_LENGTH, 2 * MAX_ACCOUNTS,
-               2 * MAX_ASSETS, 2 * MAX_BALANCES) == -ENOBUFS);
+    assert(cma_ledger_init_file(&ledger, temp_filepath, CMA_LEDGER_CREATE_ONLY, 0, MEM_LENGTH, 4 * MAX_ACCOUNTS,
+               4 * MAX_ASSETS, 4 * MAX_BALANCES) == -ENOBUFS);
 
     assert(cma_ledger_init_file(&ledger, temp_filepath, CMA_LEDGER_CREATE_ONLY, 0, MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS,
                MAX_BALANCES) == CMA_LEDGER_SUCCESS);
@@ -879,12 +883,12 @@ void test_remove(void) {
 }
 
 void test_balance_mem(void) {
-    const size_t file_size = CMA_LEDGER_MIN_MEM_LENGTH + 4340;
+    const size_t file_size = CMA_LEDGER_MIN_MEM_LENGTH + 7000;
     char temp_filepath[TMPFILE_PATH_SIZE] = "/tmp/tmpXXXXXX";
     assert(create_temp_file(temp_filepath,file_size) == 0);
     cma_ledger_t ledger;
 
-    assert(cma_ledger_init_file(&ledger,temp_filepath,CMA_LEDGER_CREATE_ONLY,0,CMA_LEDGER_MIN_MEM_LENGTH+4340,10,1,10) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_init_file(&ledger,temp_filepath,CMA_LEDGER_CREATE_ONLY,0,CMA_LEDGER_MIN_MEM_LENGTH+7000,10,1,10) == CMA_LEDGER_SUCCESS);
 
     uint8_t *buffer = malloc(file_size);
     assert(buffer != NULL);
@@ -1406,6 +1410,344 @@ void test_transfer(void) {
     printf("%s passed\n", __FUNCTION__);
 }
 
+void test_transaction(void) {
+    char temp_filepath[TMPFILE_PATH_SIZE] = "/tmp/tmpXXXXXX";
+    assert(create_temp_file(temp_filepath,FILE_SIZE) == 0);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_file(&ledger,temp_filepath,CMA_LEDGER_CREATE_ONLY,0,FILE_SIZE,MAX_ACCOUNTS,MAX_ASSETS,MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+
+    assert(cma_ledger_begin(NULL) == -EINVAL);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+    assert(cma_ledger_abort(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_BASE;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_ledger_account_id_t account_id;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    // clang-format off
+    cma_amount_t amount = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10,
+        0x00, 0x04,
+    }};
+    // clang-format on;
+
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &amount) ==
+        CMA_LEDGER_SUCCESS);
+
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_t ledger2;
+    assert(cma_ledger_init_file(&ledger2,temp_filepath,CMA_LEDGER_OPEN_ONLY,0,FILE_SIZE,MAX_ACCOUNTS,MAX_ASSETS,MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+
+    cma_amount_t balance = {};
+    assert(cma_ledger_get_balance(&ledger2, asset_id, account_id, &balance, NULL) ==
+        CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, amount.data, CMA_ABI_U256_LENGTH) == 0);
+
+    assert(cma_ledger_fini(&ledger2) == CMA_LEDGER_SUCCESS);
+    assert(unlink(temp_filepath) == 0);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_flush_policy(void) {
+    char temp_filepath[TMPFILE_PATH_SIZE] = "/tmp/tmpXXXXXX";
+    assert(create_temp_file(temp_filepath,FILE_SIZE) == 0);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_file(&ledger,temp_filepath,CMA_LEDGER_CREATE_ONLY,0,FILE_SIZE,MAX_ACCOUNTS,MAX_ASSETS,MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+
+    assert(cma_ledger_set_flush_policy(NULL, CMA_LEDGER_FLUSH_NONE) == -EINVAL);
+    assert(cma_ledger_set_flush_policy(&ledger, (cma_ledger_flush_policy_t) 42) == -EINVAL);
+    assert(cma_ledger_set_flush_policy(&ledger, CMA_LEDGER_FLUSH_PER_COMMIT) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_BASE;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_ledger_account_id_t account_id;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    // clang-format off
+    cma_amount_t amount = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10,
+        0x00, 0x04,
+    }};
+    // clang-format on;
+
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &amount) ==
+        CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+
+    assert(cma_ledger_set_flush_policy(&ledger, CMA_LEDGER_FLUSH_NONE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &amount) ==
+        CMA_LEDGER_SUCCESS);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+
+    // whatever the policy the shared mapping is written back on unmap, tests/flush-policy.cpp checks what each one
+    // tracks
+    cma_ledger_t ledger2;
+    assert(cma_ledger_init_file(&ledger2,temp_filepath,CMA_LEDGER_OPEN_ONLY,0,FILE_SIZE,MAX_ACCOUNTS,MAX_ASSETS,MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+
+    cma_amount_t expected = amount;
+    expected.data[CMA_ABI_U256_LENGTH - 3] = 0x20;
+    expected.data[CMA_ABI_U256_LENGTH - 1] = 0x08;
+    cma_amount_t balance = {};
+    assert(cma_ledger_get_balance(&ledger2, asset_id, account_id, &balance, NULL) ==
+        CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, expected.data, CMA_ABI_U256_LENGTH) == 0);
+
+    assert(cma_ledger_fini(&ledger2) == CMA_LEDGER_SUCCESS);
+    assert(unlink(temp_filepath) == 0);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_unaligned_offset(void) {
+    char temp_filepath[TMPFILE_PATH_SIZE] = "/tmp/tmpXXXXXX";
+    assert(create_temp_file(temp_filepath, UNALIGNED_OFFSET + MEM_LENGTH) == 0);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_file(&ledger, temp_filepath, CMA_LEDGER_CREATE_ONLY, UNALIGNED_OFFSET, MEM_LENGTH,
+               MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+
+    // a reset flushes the whole mapping, up to its last page
+    assert(cma_ledger_reset(&ledger) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+    cma_ledger_account_id_t account_id;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    cma_amount_t amount = {};
+    amount.data[CMA_ABI_U256_LENGTH - 1] = 0x2a;
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &amount) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+
+    assert(cma_ledger_init_file(&ledger, temp_filepath, CMA_LEDGER_OPEN_ONLY, UNALIGNED_OFFSET, MEM_LENGTH,
+               MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+    cma_amount_t balance = {};
+    assert(cma_ledger_get_balance(&ledger, asset_id, account_id, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, amount.data, CMA_ABI_U256_LENGTH) == 0);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(unlink(temp_filepath) == 0);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_wal(void) {
+    char temp_filepath[TMPFILE_PATH_SIZE] = "/tmp/tmpXXXXXX";
+    assert(create_temp_file(temp_filepath,MEM_LENGTH) == 0);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_file_wal(&ledger,temp_filepath,CMA_LEDGER_CREATE_ONLY,0,MEM_LENGTH,WAL_LENGTH,MAX_ACCOUNTS,MAX_ASSETS,MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+    char wal_filepath[TMPFILE_PATH_SIZE + sizeof(WAL_FILE_SUFFIX)];
+    snprintf(wal_filepath, sizeof(wal_filepath), "%s" WAL_FILE_SUFFIX, temp_filepath);
+    assert(access(wal_filepath, F_OK) == 0);
+
+    // clang-format off
+    cma_token_address_t token_address1 = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    }};
+    // clang-format on
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address1, NULL, NULL, &asset_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    // clang-format off
+    cma_ledger_account_t account1 = {.address = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    }}};
+    // clang-format on;
+    cma_ledger_account_id_t account_id;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, &account1, NULL, NULL, &account_type,
+                CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    // clang-format off
+    cma_amount_t amount = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10,
+        0x00, 0x04,
+    }};
+    cma_amount_t expected = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20,
+        0x00, 0x08,
+    }};
+    // clang-format on;
+
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &amount) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_checkpoint(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &amount) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+
+    // simulate the balance page not being written back before a crash
+    cma_ledger_account_balance_info_t account_balance_info = {};
+    assert(cma_ledger_get_balance(&ledger, asset_id, account_id, NULL, &account_balance_info) ==
+        CMA_LEDGER_SUCCESS);
+    assert(memcmp(account_balance_info.balance->amount.data, expected.data, CMA_ABI_U256_LENGTH) == 0);
+    memcpy(account_balance_info.balance->amount.data, amount.data, CMA_ABI_U256_LENGTH);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+
+    // reopening replays the log
+    cma_ledger_t ledger2;
+    assert(cma_ledger_init_file(&ledger2,temp_filepath,CMA_LEDGER_OPEN_ONLY,0,MEM_LENGTH,MAX_ACCOUNTS,MAX_ASSETS,MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+
+    cma_amount_t balance = {};
+    assert(cma_ledger_get_balance(&ledger2, asset_id, account_id, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, expected.data, CMA_ABI_U256_LENGTH) == 0);
+    cma_amount_t supply = {};
+    assert(cma_ledger_retrieve_asset(&ledger2, &asset_id, &token_address1, NULL, &supply, &asset_type, CMA_LEDGER_OP_FIND) ==
+        CMA_LEDGER_SUCCESS);
+    assert(memcmp(supply.data, expected.data, CMA_ABI_U256_LENGTH) == 0);
+
+    // the balance list of the account is kept in the file
+    cma_ledger_asset_balance_t listed[MAX_ASSETS];
+    size_t n_balances = 0;
+    assert(cma_ledger_list_account_balances(&ledger2, account_id, listed, MAX_ASSETS, &n_balances) ==
+        CMA_LEDGER_SUCCESS);
+    assert(n_balances == 1 && listed[0].asset_id == asset_id);
+    assert(memcmp(listed[0].amount.data, expected.data, CMA_ABI_U256_LENGTH) == 0);
+    cma_ledger_holder_balance_t holders[1];
+    size_t n_holders = 0;
+    assert(cma_ledger_list_asset_holders(&ledger2, asset_id, NULL, holders, 1, &n_holders) == CMA_LEDGER_SUCCESS);
+    assert(n_holders == 1 && holders[0].account_id == account_id);
+
+    assert(cma_ledger_withdraw(&ledger2, asset_id, account_id, &expected) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_checkpoint(&ledger2) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_fini(&ledger2) == CMA_LEDGER_SUCCESS);
+
+    // checkpointed records are not replayed
+    cma_ledger_t ledger3;
+    assert(cma_ledger_init_file_wal(&ledger3,temp_filepath,CMA_LEDGER_OPEN_ONLY,0,MEM_LENGTH,WAL_LENGTH/2,MAX_ACCOUNTS,MAX_ASSETS,MAX_BALANCES) == -EINVAL);
+    assert(cma_ledger_init_file_wal(&ledger3,temp_filepath,CMA_LEDGER_OPEN_ONLY,0,MEM_LENGTH,WAL_LENGTH,MAX_ACCOUNTS,MAX_ASSETS,MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_balance(&ledger3, asset_id, account_id, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    cma_amount_t zero = {};
+    assert(memcmp(balance.data, zero.data, CMA_ABI_U256_LENGTH) == 0);
+
+    // rolled back records are not replayed
+    assert(cma_ledger_begin(&ledger3) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger3, asset_id, account_id, &amount) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_rollback(&ledger3) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_fini(&ledger3) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_t ledger4;
+    assert(cma_ledger_init_file(&ledger4,temp_filepath,CMA_LEDGER_OPEN_ONLY,0,MEM_LENGTH,MAX_ACCOUNTS,MAX_ASSETS,MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_balance(&ledger4, asset_id, account_id, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, zero.data, CMA_ABI_U256_LENGTH) == 0);
+    assert(cma_ledger_list_account_balances(&ledger4, account_id, listed, MAX_ASSETS, &n_balances) ==
+        CMA_LEDGER_SUCCESS);
+    assert(n_balances == 0);
+    assert(cma_ledger_list_asset_holders(&ledger4, asset_id, NULL, holders, 1, &n_holders) == CMA_LEDGER_SUCCESS);
+    assert(n_holders == 0);
+
+    assert(cma_ledger_fini(&ledger4) == CMA_LEDGER_SUCCESS);
+    assert(unlink(wal_filepath) == 0);
+    assert(unlink(temp_filepath) == 0);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+// A process dying in the middle of a transaction (without fini) leaves the committed transactions only, whether they
+// were checkpointed or are still in the log
+void test_wal_crash(void) {
+    char temp_filepath[TMPFILE_PATH_SIZE] = "/tmp/tmpXXXXXX";
+    assert(create_temp_file(temp_filepath,MEM_LENGTH) == 0);
+    cma_token_address_t token_address = {.data = {0x01}};
+    cma_ledger_account_t account1 = {.address = {.data = {0x01}}};
+    cma_ledger_account_t account2 = {.address = {.data = {0x02}}};
+    cma_amount_t amount = {.data = {[CMA_ABI_U256_LENGTH - 1] = 0x10}};
+    cma_amount_t expected = {.data = {[CMA_ABI_U256_LENGTH - 1] = 0x20}};
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS;
+    cma_ledger_account_id_t account_id;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+
+    const pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+        cma_ledger_t ledger;
+        assert(cma_ledger_init_file_wal(&ledger,temp_filepath,CMA_LEDGER_CREATE_ONLY,0,MEM_LENGTH,WAL_LENGTH,MAX_ACCOUNTS,MAX_ASSETS,MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+        assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address, NULL, NULL, &asset_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+        assert(cma_ledger_retrieve_account(&ledger, &account_id, &account1, NULL, NULL, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+        assert(cma_ledger_deposit(&ledger, asset_id, account_id, &amount) == CMA_LEDGER_SUCCESS);
+        assert(cma_ledger_checkpoint(&ledger) == CMA_LEDGER_SUCCESS);
+        assert(cma_ledger_deposit(&ledger, asset_id, account_id, &amount) == CMA_LEDGER_SUCCESS);
+
+        // the open transaction creates an account, moves funds to it and adds a deposit, then the process dies
+        assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+        cma_ledger_account_id_t account_id2;
+        assert(cma_ledger_retrieve_account(&ledger, &account_id2, &account2, NULL, NULL, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+        assert(cma_ledger_transfer(&ledger, asset_id, account_id, account_id2, &amount) == CMA_LEDGER_SUCCESS);
+        assert(cma_ledger_deposit(&ledger, asset_id, account_id, &expected) == CMA_LEDGER_SUCCESS);
+        _exit(0);
+    }
+    int status = 0;
+    assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_file(&ledger,temp_filepath,CMA_LEDGER_OPEN_ONLY,0,MEM_LENGTH,MAX_ACCOUNTS,MAX_ASSETS,MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address, NULL, NULL, &asset_type,
+               CMA_LEDGER_OP_FIND) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, &account1, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_FIND) == CMA_LEDGER_SUCCESS);
+    cma_amount_t balance = {};
+    assert(cma_ledger_get_balance(&ledger, asset_id, account_id, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, expected.data, CMA_ABI_U256_LENGTH) == 0);
+    cma_amount_t supply = {};
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, &token_address, NULL, &supply, &asset_type,
+               CMA_LEDGER_OP_FIND) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(supply.data, expected.data, CMA_ABI_U256_LENGTH) == 0);
+    cma_ledger_account_id_t account_id2;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id2, &account2, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_FIND) == CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+    cma_ledger_holder_balance_t holders[2];
+    size_t n_holders = 0;
+    assert(cma_ledger_list_asset_holders(&ledger, asset_id, NULL, holders, 2, &n_holders) == CMA_LEDGER_SUCCESS);
+    assert(n_holders == 1 && holders[0].account_id == account_id);
+
+    // the account the transaction created can be created again, with the id it had
+    assert(cma_ledger_retrieve_account(&ledger, &account_id2, &account2, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    assert(account_id2 == account_id + 1);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    char wal_filepath[TMPFILE_PATH_SIZE + sizeof(WAL_FILE_SUFFIX)];
+    snprintf(wal_filepath, sizeof(wal_filepath), "%s" WAL_FILE_SUFFIX, temp_filepath);
+    assert(unlink(wal_filepath) == 0);
+    assert(unlink(temp_filepath) == 0);
+    printf("%s passed\n", __FUNCTION__);
+}
+
 int main(void) {
     test_init_and_fini();
     test_init_and_reset();
@@ -1424,6 +1766,11 @@ int main(void) {
     test_transfer();
     test_remove();
     test_balance_mem();
+    test_transaction();
+    test_flush_policy();
+    test_unaligned_offset();
+    test_wal();
+    test_wal_crash();
     printf("All file-ledger tests passed!\n");
     return 0;
 }
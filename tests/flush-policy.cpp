@@ -0,0 +1,106 @@
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+extern "C" {
+#include "libcma/ledger.h"
+}
+
+#include "ledger_impl.h"
+
+#define MAX_ACCOUNTS 1024UL           //< Maximum number of accounts.
+#define MAX_BALANCES 8 * MAX_ACCOUNTS //< Max balances
+#define MAX_ASSETS 8UL                //< Maximum number of assets.
+#define MEM_LENGTH 16UL * 1024 * 1024 //< State length
+#define TMPFILE_PATH_SIZE 15
+
+// Checks which changes each flush policy keeps track of, through the dirty ranges of a file ledger waiting for a
+// flush. The file contents can't tell the policies apart, the shared mapping is written back on unmap anyway.
+
+namespace {
+
+auto make_amount(uint64_t value) -> cma_amount_t {
+    cma_amount_t amount = {};
+    for (size_t i = 0; i < sizeof(value); ++i) {
+        amount.data[CMA_ABI_U256_LENGTH - 1 - i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+    return amount;
+}
+
+auto get_memory_ledger(cma_ledger_t *ledger) -> cma_ledger_memory * {
+    auto *memory_ledger = dynamic_cast<cma_ledger_memory *>(reinterpret_cast<cma_ledger_base *>(ledger));
+    assert(memory_ledger != nullptr);
+    return memory_ledger;
+}
+
+} // namespace
+
+void test_flush_policy_dirty_ranges() {
+    char temp_filepath[TMPFILE_PATH_SIZE] = "/tmp/tmpXXXXXX";
+    const int fd = mkstemp(temp_filepath);
+    assert(fd != -1 && ftruncate(fd, MEM_LENGTH) == 0 && close(fd) == 0);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_file(&ledger, temp_filepath, CMA_LEDGER_CREATE_ONLY, 0, MEM_LENGTH, MAX_ACCOUNTS,
+               MAX_ASSETS, MAX_BALANCES) == CMA_LEDGER_SUCCESS);
+    cma_ledger_memory *memory_ledger = get_memory_ledger(&ledger);
+
+    // a withdrawable balance, its amount is written to the balances at the start of the ledger memory
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_BASE;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, nullptr, nullptr, nullptr, &asset_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    cma_ledger_account_t account = {.address = {.data = {0x01}}};
+    cma_ledger_account_id_t account_id;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_WALLET_ADDRESS;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, &account, nullptr, nullptr, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    const cma_amount_t one = make_amount(1);
+
+    // per operation: every operation is flushed right away
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &one) == CMA_LEDGER_SUCCESS);
+    assert(memory_ledger->get_dirty_ranges_count() == 0);
+
+    // per commit: operations are tracked until the commit
+    assert(cma_ledger_set_flush_policy(&ledger, CMA_LEDGER_FLUSH_PER_COMMIT) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &one) == CMA_LEDGER_SUCCESS);
+    assert(memory_ledger->get_dirty_ranges_count() > 0);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(memory_ledger->get_dirty_ranges_count() == 0);
+
+    // no flush: nothing is tracked, switching to it drops what was pending
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &one) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_set_flush_policy(&ledger, CMA_LEDGER_FLUSH_NONE) == CMA_LEDGER_SUCCESS);
+    assert(memory_ledger->get_dirty_ranges_count() == 0);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &one) == CMA_LEDGER_SUCCESS);
+    assert(memory_ledger->get_dirty_ranges_count() == 0);
+
+    // leaving no flush marks the whole ledger memory, so the untracked changes are flushed with the next commit
+    assert(cma_ledger_set_flush_policy(&ledger, CMA_LEDGER_FLUSH_PER_COMMIT) == CMA_LEDGER_SUCCESS);
+    assert(memory_ledger->get_dirty_ranges_count() == 1);
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(memory_ledger->get_dirty_ranges_count() == 0);
+
+    // and with the next operation under per operation
+    assert(cma_ledger_set_flush_policy(&ledger, CMA_LEDGER_FLUSH_NONE) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_set_flush_policy(&ledger, CMA_LEDGER_FLUSH_PER_OP) == CMA_LEDGER_SUCCESS);
+    assert(memory_ledger->get_dirty_ranges_count() == 1);
+    assert(cma_ledger_withdraw(&ledger, asset_id, account_id, &one) == CMA_LEDGER_SUCCESS);
+    assert(memory_ledger->get_dirty_ranges_count() == 0);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(unlink(temp_filepath) == 0);
+    std::printf("%s passed\n", __FUNCTION__);
+}
+
+int main() {
+    test_flush_policy_dirty_ranges();
+    std::printf("All flush-policy tests passed!\n");
+    return 0;
+}
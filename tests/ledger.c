@@ -947,6 +947,220 @@ void test_transfer(void) {
     printf("%s passed\n", __FUNCTION__);
 }
 
+void test_transaction(void) {
+    cma_ledger_t ledger;
+    assert(cma_ledger_init(&ledger) == CMA_LEDGER_SUCCESS);
+
+    assert(cma_ledger_begin(NULL) == -EINVAL);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+    assert(cma_ledger_abort(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+
+    // abort and rollback are only supported by the memory ledger, the transaction stays open
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_abort(&ledger) == -ENOTSUP);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_abort(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+
+    assert(cma_ledger_rollback(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+    assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_rollback(&ledger) == -ENOTSUP);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_apply_batch(&ledger, NULL, 0, NULL, CMA_LEDGER_BATCH_BEST_EFFORT) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_apply_batch(&ledger, NULL, 0, NULL, CMA_LEDGER_BATCH_ALL_OR_NOTHING) == -ENOTSUP);
+    assert(cma_ledger_commit(&ledger) == CMA_LEDGER_ERROR_TRANSACTION);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_amount_limb_carry(void) {
+    cma_ledger_t ledger;
+    assert(cma_ledger_init(&ledger) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_ledger_account_id_t account_id;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    // clang-format off
+    cma_amount_t low_limb_max = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff,
+    }};
+    cma_amount_t one = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x01,
+    }};
+    cma_amount_t second_limb_one = {.data = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00,
+    }};
+    // clang-format on;
+
+    // the carry out of the low limb lands in the next one, and the borrow takes it back
+    cma_amount_t balance = {};
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &low_limb_max) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &one) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_balance(&ledger, asset_id, account_id, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, second_limb_one.data, CMA_ABI_U256_LENGTH) == 0);
+
+    assert(cma_ledger_withdraw(&ledger, asset_id, account_id, &one) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_balance(&ledger, asset_id, account_id, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, low_limb_max.data, CMA_ABI_U256_LENGTH) == 0);
+
+    assert(cma_ledger_withdraw(&ledger, asset_id, account_id, &second_limb_one) ==
+        CMA_LEDGER_ERROR_SUPPLY_OVERFLOW);
+
+    // a carry out of the top limb is an overflow
+    cma_amount_t max_amount = {};
+    memset(max_amount.data, 0xff, CMA_ABI_U256_LENGTH);
+    assert(cma_ledger_withdraw(&ledger, asset_id, account_id, &low_limb_max) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &max_amount) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_id, &one) == CMA_LEDGER_ERROR_SUPPLY_OVERFLOW);
+    assert(cma_ledger_get_balance(&ledger, asset_id, account_id, &balance, NULL) == CMA_LEDGER_SUCCESS);
+    assert(memcmp(balance.data, max_amount.data, CMA_ABI_U256_LENGTH) == 0);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_list_account_balances(void) {
+    cma_ledger_t ledger;
+    assert(cma_ledger_init(&ledger) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_id_t asset_ids[2];
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    for (size_t i = 0; i < 2; i++) {
+        assert(cma_ledger_retrieve_asset(&ledger, &asset_ids[i], NULL, NULL, NULL, &asset_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    }
+    cma_ledger_account_id_t account_id;
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    assert(cma_ledger_retrieve_account(&ledger, &account_id, NULL, NULL, NULL, &account_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_balance_t listed[2];
+    size_t n_balances = 0;
+    assert(cma_ledger_list_account_balances(&ledger, 1000, listed, 2, &n_balances) ==
+        CMA_LEDGER_ERROR_ACCOUNT_NOT_FOUND);
+
+    cma_amount_t amount = {.data = {[CMA_ABI_U256_LENGTH - 1] = 0x05}};
+    assert(cma_ledger_deposit(&ledger, asset_ids[0], account_id, &amount) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_deposit(&ledger, asset_ids[1], account_id, &amount) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_list_account_balances(&ledger, account_id, listed, 2, &n_balances) == CMA_LEDGER_SUCCESS);
+    assert(n_balances == 2);
+
+    // emptied balances are not listed
+    assert(cma_ledger_withdraw(&ledger, asset_ids[0], account_id, &amount) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_list_account_balances(&ledger, account_id, listed, 2, &n_balances) == CMA_LEDGER_SUCCESS);
+    assert(n_balances == 1);
+    assert(listed[0].asset_id == asset_ids[1]);
+    assert(memcmp(listed[0].amount.data, amount.data, CMA_ABI_U256_LENGTH) == 0);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_get_owner(void) {
+    cma_ledger_t ledger;
+    assert(cma_ledger_init(&ledger) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_TOKEN_ADDRESS_ID;
+    cma_token_address_t token_address = {.data = {[CMA_ABI_ADDRESS_LENGTH - 1] = 0x01}};
+    cma_token_id_t token_id = {.data = {[CMA_ABI_U256_LENGTH - 1] = 0x01}};
+    cma_ledger_asset_id_t nft_id;
+    assert(cma_ledger_retrieve_asset(&ledger, &nft_id, &token_address, &token_id, NULL, &asset_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    cma_ledger_asset_id_t fungible_id;
+    assert(cma_ledger_retrieve_asset(&ledger, &fungible_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+    cma_ledger_account_id_t account_ids[2];
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    for (size_t i = 0; i < 2; i++) {
+        assert(cma_ledger_retrieve_account(&ledger, &account_ids[i], NULL, NULL, NULL, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    }
+
+    cma_ledger_account_id_t owner = 1000;
+    assert(cma_ledger_get_owner(&ledger, nft_id, NULL) == -EINVAL);
+    assert(cma_ledger_get_owner(&ledger, 1000, &owner) == CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+    assert(cma_ledger_get_owner(&ledger, fungible_id, &owner) == -EINVAL);
+    assert(cma_ledger_get_owner(&ledger, nft_id, &owner) == CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+    assert(owner == 1000);
+
+    // the owner follows the token on deposit, transfer and withdraw
+    cma_amount_t one = {.data = {[CMA_ABI_U256_LENGTH - 1] = 0x01}};
+    assert(cma_ledger_deposit(&ledger, nft_id, account_ids[0], &one) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_owner(&ledger, nft_id, &owner) == CMA_LEDGER_SUCCESS);
+    assert(owner == account_ids[0]);
+    assert(cma_ledger_transfer(&ledger, nft_id, account_ids[0], account_ids[1], &one) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_owner(&ledger, nft_id, &owner) == CMA_LEDGER_SUCCESS);
+    assert(owner == account_ids[1]);
+
+    assert(cma_ledger_withdraw(&ledger, nft_id, account_ids[1], &one) == CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_get_owner(&ledger, nft_id, &owner) == CMA_LEDGER_ERROR_BALANCE_NOT_FOUND);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_list_asset_holders(void) {
+    cma_ledger_t ledger;
+    assert(cma_ledger_init(&ledger) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, NULL, NULL, NULL, &asset_type, CMA_LEDGER_OP_CREATE) ==
+        CMA_LEDGER_SUCCESS);
+    cma_ledger_account_id_t account_ids[3];
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    for (size_t i = 0; i < 3; i++) {
+        assert(cma_ledger_retrieve_account(&ledger, &account_ids[i], NULL, NULL, NULL, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    }
+
+    cma_ledger_holder_balance_t listed[2];
+    size_t n_holders = 0;
+    assert(cma_ledger_list_asset_holders(&ledger, 1000, NULL, listed, 2, &n_holders) ==
+        CMA_LEDGER_ERROR_ASSET_NOT_FOUND);
+
+    cma_amount_t amount = {.data = {[CMA_ABI_U256_LENGTH - 1] = 0x05}};
+    for (size_t i = 0; i < 3; i++) {
+        assert(cma_ledger_deposit(&ledger, asset_id, account_ids[i], &amount) == CMA_LEDGER_SUCCESS);
+    }
+    assert(cma_ledger_withdraw(&ledger, asset_id, account_ids[1], &amount) == CMA_LEDGER_SUCCESS);
+
+    // emptied balances are not listed, the second page resumes after the last holder of the first one
+    assert(cma_ledger_list_asset_holders(&ledger, asset_id, NULL, listed, 1, &n_holders) == CMA_LEDGER_SUCCESS);
+    assert(n_holders == 2);
+    const cma_ledger_account_id_t first = listed[0].account_id;
+    assert(cma_ledger_list_asset_holders(&ledger, asset_id, &first, listed, 2, &n_holders) == CMA_LEDGER_SUCCESS);
+    assert(n_holders == 2);
+    assert(first != listed[0].account_id);
+    assert(first == account_ids[0] || first == account_ids[2]);
+    assert(listed[0].account_id == account_ids[0] || listed[0].account_id == account_ids[2]);
+    assert(memcmp(listed[0].amount.data, amount.data, CMA_ABI_U256_LENGTH) == 0);
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    printf("%s passed\n", __FUNCTION__);
+}
+
 int main(void) {
     test_init_and_fini();
     test_init_and_reset();
@@ -961,6 +1175,11 @@ int main(void) {
     test_deposit();
     test_withdraw();
     test_transfer();
+    test_transaction();
+    test_amount_limb_carry();
+    test_list_account_balances();
+    test_get_owner();
+    test_list_asset_holders();
     printf("All ledger tests passed!\n");
     return 0;
 }
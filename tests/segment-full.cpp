@@ -0,0 +1,292 @@
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <random>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "libcma/ledger.h"
+}
+
+#include "interprocess.hpp"
+
+#define MAX_ACCOUNTS 8UL * 1024       //< Maximum number of accounts.
+#define MAX_BALANCES 8 * MAX_ACCOUNTS //< Max balances
+#define MAX_ASSETS 8UL                //< Maximum number of assets.
+#define MEM_LENGTH 64UL * 1024 * 1024 //< State length
+#define N_NEW_BALANCES 4096UL         //< Balances created by a batch, past the initial room of the balance table
+#define MIN_CHUNK 16UL                //< Smallest allocation taken when filling the segment
+#define CHURN_ACCOUNTS 1024UL         //< Accounts of the presized ledger
+#define CHURN_BALANCES 1024UL         //< Max balances of the presized ledger
+#define CHURN_LIVE 1000UL             //< Balances held while churning, close to the max so erased slots pile up
+#define N_CHURN_OPS 65536UL           //< Balances removed and created while the segment is full
+#define CHURN_SEED 0xc4a2UL           //< Seed of the churn
+
+// Runs ledger operations while the ledger memory has no room left, so growing a table fails as when the segment is
+// full. The free memory is taken through a second handle on the segment, the maximums given at init are never hit.
+
+namespace {
+
+// Holds the free memory of a segment, allocating chunks of decreasing size until not even the smallest one fits
+class segment_filler {
+    libcma::interprocess::managed_memory segment;
+    std::vector<void *> chunks;
+
+public:
+    segment_filler(void *buffer, size_t mem_length) : segment(libcma::interprocess::open_only, buffer, mem_length) {
+        for (size_t chunk = mem_length; chunk >= MIN_CHUNK; chunk /= 2) {
+            while (void *ptr = segment.allocate(chunk, std::nothrow)) {
+                chunks.push_back(ptr);
+            }
+        }
+    }
+    segment_filler(const segment_filler &) = delete;
+    segment_filler(segment_filler &&) = delete;
+    auto operator=(const segment_filler &) -> segment_filler & = delete;
+    auto operator=(segment_filler &&) -> segment_filler & = delete;
+    ~segment_filler() {
+        for (void *ptr : chunks) {
+            segment.deallocate(ptr);
+        }
+    }
+};
+
+auto make_amount(uint64_t value) -> cma_amount_t {
+    cma_amount_t amount = {};
+    for (size_t i = 0; i < sizeof(value); ++i) {
+        amount.data[CMA_ABI_U256_LENGTH - 1 - i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+    return amount;
+}
+
+auto get_holders(cma_ledger_t *ledger, cma_ledger_asset_id_t asset_id) -> size_t {
+    size_t n_holders = 0;
+    assert(cma_ledger_list_asset_holders(ledger, asset_id, nullptr, nullptr, 0, &n_holders) == CMA_LEDGER_SUCCESS);
+    return n_holders;
+}
+
+auto get_supply(cma_ledger_t *ledger, cma_ledger_asset_id_t asset_id) -> cma_amount_t {
+    cma_amount_t supply = {};
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(ledger, &asset_id, nullptr, nullptr, &supply, &asset_type,
+               CMA_LEDGER_OP_FIND) == CMA_LEDGER_SUCCESS);
+    return supply;
+}
+
+auto same_amount(const cma_amount_t &lhs, const cma_amount_t &rhs) -> bool {
+    return std::memcmp(lhs.data, rhs.data, CMA_ABI_U256_LENGTH) == 0;
+}
+
+} // namespace
+
+void test_batch_segment_full() {
+    std::vector<uint8_t> buffer(MEM_LENGTH);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer.data(), MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, nullptr, nullptr, nullptr, &asset_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    std::vector<cma_ledger_account_id_t> account_ids(N_NEW_BALANCES + 1);
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    for (auto &account_id : account_ids) {
+        assert(cma_ledger_retrieve_account(&ledger, &account_id, nullptr, nullptr, nullptr, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    }
+    const cma_amount_t one = make_amount(1);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_ids[0], &one) == CMA_LEDGER_SUCCESS);
+
+    // an update of an existing balance, then balances the table has no room for
+    std::vector<cma_ledger_op_t> ops(account_ids.size());
+    for (size_t i = 0; i < ops.size(); ++i) {
+        ops[i] = {
+            .type = CMA_LEDGER_OP_TYPE_DEPOSIT, .asset_id = asset_id, .to_account_id = account_ids[i], .amount = one};
+    }
+    std::vector<cma_ledger_op_result_t> results(ops.size());
+
+    size_t failed = 0;
+    {
+        const segment_filler filler(buffer.data(), MEM_LENGTH);
+
+        // all or nothing: the operation that grows the table fails and the operations before it are undone
+        assert(cma_ledger_apply_batch(&ledger, ops.data(), ops.size(), results.data(),
+                   CMA_LEDGER_BATCH_ALL_OR_NOTHING) == CMA_LEDGER_ERROR_EXCEPTION);
+        while (failed < results.size() && results[failed].status == -ECANCELED) {
+            ++failed;
+        }
+        assert(failed > 1 && failed < results.size());
+        assert(results[failed].status == CMA_LEDGER_ERROR_EXCEPTION);
+        for (size_t i = failed + 1; i < results.size(); ++i) {
+            assert(results[i].status == -ECANCELED);
+        }
+        assert(get_holders(&ledger, asset_id) == 1);
+        assert(same_amount(get_supply(&ledger, asset_id), one));
+        cma_amount_t balance = {};
+        assert(cma_ledger_get_balance(&ledger, asset_id, account_ids[0], &balance, nullptr) == CMA_LEDGER_SUCCESS);
+        assert(same_amount(balance, one));
+
+        // best effort: every operation gets its status, the ones needing more room fail
+        assert(cma_ledger_apply_batch(&ledger, ops.data(), ops.size(), results.data(),
+                   CMA_LEDGER_BATCH_BEST_EFFORT) == CMA_LEDGER_ERROR_EXCEPTION);
+        for (size_t i = 0; i < results.size(); ++i) {
+            assert(results[i].status == (i < failed ? CMA_LEDGER_SUCCESS : CMA_LEDGER_ERROR_EXCEPTION));
+        }
+        assert(get_holders(&ledger, asset_id) == failed);
+        assert(same_amount(get_supply(&ledger, asset_id), make_amount(failed + 1)));
+    }
+
+    // with room again the rest of the batch goes through
+    assert(cma_ledger_apply_batch(&ledger, &ops[failed], ops.size() - failed, nullptr,
+               CMA_LEDGER_BATCH_ALL_OR_NOTHING) == CMA_LEDGER_SUCCESS);
+    assert(get_holders(&ledger, asset_id) == account_ids.size());
+    assert(same_amount(get_supply(&ledger, asset_id), make_amount(account_ids.size() + 1)));
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    std::printf("%s passed\n", __FUNCTION__);
+}
+
+void test_transfer_multi_segment_full() {
+    std::vector<uint8_t> buffer(MEM_LENGTH);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer.data(), MEM_LENGTH, MAX_ACCOUNTS, MAX_ASSETS, MAX_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_id_t asset_id;
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    assert(cma_ledger_retrieve_asset(&ledger, &asset_id, nullptr, nullptr, nullptr, &asset_type,
+               CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    std::vector<cma_ledger_account_id_t> account_ids(N_NEW_BALANCES + 1);
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    for (auto &account_id : account_ids) {
+        assert(cma_ledger_retrieve_account(&ledger, &account_id, nullptr, nullptr, nullptr, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    }
+    const cma_amount_t funds = make_amount(N_NEW_BALANCES + 1);
+    assert(cma_ledger_deposit(&ledger, asset_id, account_ids[0], &funds) == CMA_LEDGER_SUCCESS);
+
+    // the source is updated first, the credited balances only fit while the table has room
+    const cma_amount_t one = make_amount(1);
+    std::vector<cma_ledger_transfer_leg_t> legs(N_NEW_BALANCES);
+    for (size_t i = 0; i < legs.size(); ++i) {
+        legs[i] = {.asset_id = asset_id,
+            .from_account_id = account_ids[0],
+            .to_account_id = account_ids[i + 1],
+            .amount = one};
+    }
+
+    {
+        const segment_filler filler(buffer.data(), MEM_LENGTH);
+
+        assert(cma_ledger_transfer_multi(&ledger, legs.data(), legs.size()) == CMA_LEDGER_ERROR_EXCEPTION);
+        assert(get_holders(&ledger, asset_id) == 1);
+        cma_amount_t balance = {};
+        assert(cma_ledger_get_balance(&ledger, asset_id, account_ids[0], &balance, nullptr) == CMA_LEDGER_SUCCESS);
+        assert(same_amount(balance, funds));
+
+        // inside a transaction only the transfer is undone
+        assert(cma_ledger_begin(&ledger) == CMA_LEDGER_SUCCESS);
+        assert(cma_ledger_transfer(&ledger, asset_id, account_ids[0], account_ids[1], &one) == CMA_LEDGER_SUCCESS);
+        assert(cma_ledger_transfer_multi(&ledger, &legs[1], legs.size() - 1) == CMA_LEDGER_ERROR_EXCEPTION);
+        assert(cma_ledger_commit(&ledger) == CMA_LEDGER_SUCCESS);
+        assert(get_holders(&ledger, asset_id) == 2);
+        assert(cma_ledger_get_balance(&ledger, asset_id, account_ids[1], &balance, nullptr) == CMA_LEDGER_SUCCESS);
+        assert(same_amount(balance, one));
+    }
+
+    // with room again every leg goes through
+    assert(cma_ledger_transfer_multi(&ledger, &legs[1], legs.size() - 1) == CMA_LEDGER_SUCCESS);
+    assert(get_holders(&ledger, asset_id) == account_ids.size());
+    cma_amount_t balance = {};
+    assert(cma_ledger_get_balance(&ledger, asset_id, account_ids[0], &balance, nullptr) == CMA_LEDGER_SUCCESS);
+    assert(same_amount(balance, one));
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    std::printf("%s passed\n", __FUNCTION__);
+}
+
+// A presized ledger removes and creates balances with no room left in the segment, the balance table purges its
+// erased slots many times on the way and never allocates
+void test_presize_churn_segment_full() {
+    std::vector<uint8_t> buffer(MEM_LENGTH);
+    cma_ledger_t ledger;
+    assert(cma_ledger_init_buffer(&ledger, buffer.data(), MEM_LENGTH, CHURN_ACCOUNTS, MAX_ASSETS, CHURN_BALANCES) ==
+        CMA_LEDGER_SUCCESS);
+    assert(cma_ledger_presize(&ledger) == CMA_LEDGER_SUCCESS);
+
+    cma_ledger_asset_type_t asset_type = CMA_LEDGER_ASSET_TYPE_ID;
+    for (size_t i = 0; i < MAX_ASSETS; ++i) {
+        cma_ledger_asset_id_t asset_id;
+        assert(cma_ledger_retrieve_asset(&ledger, &asset_id, nullptr, nullptr, nullptr, &asset_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    }
+    cma_ledger_account_type_t account_type = CMA_LEDGER_ACCOUNT_TYPE_ID;
+    for (size_t i = 0; i < CHURN_ACCOUNTS; ++i) {
+        cma_ledger_account_id_t account_id;
+        assert(cma_ledger_retrieve_account(&ledger, &account_id, nullptr, nullptr, nullptr, &account_type,
+                   CMA_LEDGER_OP_CREATE) == CMA_LEDGER_SUCCESS);
+    }
+
+    // balances are (asset, account) pairs holding one unit
+    const cma_amount_t one = make_amount(1);
+    std::mt19937_64 rng(CHURN_SEED);
+    std::vector<bool> held(MAX_ASSETS * CHURN_ACCOUNTS);
+    auto draw_free_balance = [&]() -> size_t {
+        size_t balance = rng() % held.size();
+        while (held[balance]) {
+            balance = rng() % held.size();
+        }
+        return balance;
+    };
+    std::vector<size_t> live(CHURN_LIVE);
+    for (auto &balance : live) {
+        balance = draw_free_balance();
+        held[balance] = true;
+        assert(cma_ledger_deposit(&ledger, balance / CHURN_ACCOUNTS, balance % CHURN_ACCOUNTS, &one) ==
+            CMA_LEDGER_SUCCESS);
+    }
+
+    {
+        const segment_filler filler(buffer.data(), MEM_LENGTH);
+
+        for (size_t op = 0; op < N_CHURN_OPS; ++op) {
+            size_t &balance = live[rng() % live.size()];
+            assert(cma_ledger_withdraw(&ledger, balance / CHURN_ACCOUNTS, balance % CHURN_ACCOUNTS, &one) ==
+                CMA_LEDGER_SUCCESS);
+            held[balance] = false;
+            balance = draw_free_balance();
+            held[balance] = true;
+            assert(cma_ledger_deposit(&ledger, balance / CHURN_ACCOUNTS, balance % CHURN_ACCOUNTS, &one) ==
+                CMA_LEDGER_SUCCESS);
+        }
+    }
+
+    size_t n_holders = 0;
+    for (size_t asset_id = 0; asset_id < MAX_ASSETS; ++asset_id) {
+        n_holders += get_holders(&ledger, asset_id);
+    }
+    assert(n_holders == CHURN_LIVE);
+    for (const size_t balance : live) {
+        cma_amount_t amount = {};
+        assert(cma_ledger_get_balance(&ledger, balance / CHURN_ACCOUNTS, balance % CHURN_ACCOUNTS, &amount, nullptr) ==
+            CMA_LEDGER_SUCCESS);
+        assert(same_amount(amount, one));
+    }
+
+    assert(cma_ledger_fini(&ledger) == CMA_LEDGER_SUCCESS);
+    std::printf("%s passed\n", __FUNCTION__);
+}
+
+int main() {
+    test_batch_segment_full();
+    test_transfer_multi_segment_full();
+    test_presize_churn_segment_full();
+    std::printf("All segment-full tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "swar_flat_map.hpp"
+
+#define N_OPS 100000UL      //< Operations of each churn run
+#define N_KEYS 65536UL      //< Keys drawn by the churn
+#define N_LIVE 700UL        //< Entries kept in the table once the churn has filled it
+#define N_RESERVED 800UL    //< Entries reserved up front, the capacity the churn grows to on its own
+#define FEW_HASHES 4UL      //< Hashes of the colliding hasher making long probe sequences
+#define SHARED_HASHES 256UL //< Hashes of the colliding hasher leaving room for the erased slots to pile up
+#define CHECK_EVERY 1024UL  //< Operations between two walks over the whole table
+#define SEED 0x5eedUL       //< Seed of the operation sequence
+
+// Drives a swar_flat_map and a std::unordered_map with the same random inserts, erases and lookups, and checks that
+// the table bytes only depend on the sequence of operations.
+
+namespace {
+
+// Live allocations of a table, in allocation order
+struct allocation_log {
+    std::vector<std::pair<void *, size_t>> live;
+    size_t n_allocations = 0;
+};
+
+// Zero fills what it allocates, so two tables fed the same operations hold the same bytes even in unused slots
+template <typename T>
+class recording_allocator {
+    template <typename>
+    friend class recording_allocator;
+
+    allocation_log *log;
+
+public:
+    using value_type = T;
+
+    explicit recording_allocator(allocation_log *allocations) : log(allocations) {}
+    template <typename U>
+    // NOLINTNEXTLINE(google-explicit-constructor,hicpp-explicit-conversions)
+    recording_allocator(const recording_allocator<U> &other) : log(other.log) {}
+
+    auto allocate(size_t n) -> T * {
+        void *ptr = ::operator new(n * sizeof(T));
+        std::memset(ptr, 0, n * sizeof(T));
+        log->live.emplace_back(ptr, n * sizeof(T));
+        ++log->n_allocations;
+        return static_cast<T *>(ptr);
+    }
+    void deallocate(T *ptr, size_t /*n*/) {
+        std::erase_if(log->live, [ptr](const auto &allocation) { return allocation.first == ptr; });
+        ::operator delete(ptr);
+    }
+    template <typename U>
+    auto operator==(const recording_allocator<U> &other) const -> bool {
+        return log == other.log;
+    }
+};
+
+// Gives every key one of n hashes, so the entries sharing a hash fill whole groups and probe past them
+template <uint64_t N>
+struct colliding_hash {
+    auto operator()(uint64_t key) const -> uint64_t {
+        return key % N;
+    }
+};
+
+template <class Hash>
+using map_t = libcma::swar_flat_map<uint64_t, uint64_t, Hash, std::equal_to<>,
+    recording_allocator<libcma::swar_flat_map_entry<uint64_t, uint64_t>>>;
+
+// A control word holding no empty byte, lookups of missing keys go on to the next group
+auto group_is_full(uint64_t ctrl) -> bool {
+    for (size_t i = 0; i < sizeof(ctrl); ++i) {
+        if (((ctrl >> (8 * i)) & 0xff) == 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Walks the whole table against the reference, returns whether some entry sits in a group with no empty slot
+template <class Hash>
+auto check_entries(const map_t<Hash> &map, const std::unordered_map<uint64_t, uint64_t> &reference) -> bool {
+    bool full_group = false;
+    size_t n_entries = 0;
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        auto ref = reference.find(it->first);
+        assert(ref != reference.end() && ref->second == it->second);
+        full_group = full_group || group_is_full(*map.ctrl_of(it));
+        ++n_entries;
+    }
+    assert(n_entries == reference.size() && map.size() == reference.size());
+    return full_group;
+}
+
+struct churn_stats {
+    bool full_group = false; ///< Groups with no empty slot were seen while checking the table
+    size_t n_purges = 0;     ///< Inserts that purged the erased slots in place
+};
+
+template <class Hash>
+auto churn(map_t<Hash> &map, uint64_t seed) -> churn_stats {
+    std::unordered_map<uint64_t, uint64_t> reference;
+    std::vector<uint64_t> live;
+    std::mt19937_64 rng(seed);
+    churn_stats stats;
+    for (size_t op = 0; op < N_OPS; ++op) {
+        const uint64_t draw = rng();
+        switch ((draw >> 32) % 3) {
+            case 0: {
+                // insert a drawn key, or erase a live one once the table holds enough
+                if (live.size() >= N_LIVE) {
+                    const size_t index = draw % live.size();
+                    const uint64_t key = live[index];
+                    live[index] = live.back();
+                    live.pop_back();
+                    assert(map.erase(key) == 1 && reference.erase(key) == 1);
+                    break;
+                }
+                const uint64_t key = draw % N_KEYS;
+                const size_t capacity = map.capacity();
+                const size_t growth_left = map.growth_left();
+                auto [it, inserted] = map.try_emplace(key, draw);
+                auto [ref, ref_inserted] = reference.try_emplace(key, draw);
+                assert(inserted == ref_inserted && it->first == key && it->second == ref->second);
+                if (inserted) {
+                    live.push_back(key);
+                }
+                // a new entry takes room, unless the table made some by dropping its erased slots
+                if (inserted && growth_left == 0 && map.capacity() == capacity) {
+                    ++stats.n_purges;
+                }
+                break;
+            }
+            case 1:
+                if (!live.empty()) {
+                    auto it = map.find(live[draw % live.size()]);
+                    assert(it != map.end() && it->second == reference.at(it->first));
+                }
+                break;
+            default: {
+                // mostly missing keys
+                const uint64_t key = draw % N_KEYS;
+                auto it = map.find(key);
+                auto ref = reference.find(key);
+                assert((it == map.end()) == (ref == reference.end()));
+                assert(it == map.end() || it->second == ref->second);
+                if (ref == reference.end()) {
+                    assert(map.erase(key) == 0);
+                }
+                break;
+            }
+        }
+        assert(map.size() == reference.size());
+        if (op % CHECK_EVERY == 0) {
+            stats.full_group = check_entries(map, reference) || stats.full_group;
+        }
+    }
+    stats.full_group = check_entries(map, reference) || stats.full_group;
+    for (const uint64_t key : live) {
+        assert(map.contains(key));
+    }
+    return stats;
+}
+
+template <class Hash>
+void check_same_bytes(uint64_t seed) {
+    allocation_log lhs_log;
+    allocation_log rhs_log;
+    {
+        map_t<Hash> lhs{recording_allocator<libcma::swar_flat_map_entry<uint64_t, uint64_t>>(&lhs_log)};
+        map_t<Hash> rhs{recording_allocator<libcma::swar_flat_map_entry<uint64_t, uint64_t>>(&rhs_log)};
+        churn(lhs, seed);
+        churn(rhs, seed);
+        assert(!lhs_log.live.empty() && lhs_log.live.size() == rhs_log.live.size());
+        for (size_t i = 0; i < lhs_log.live.size(); ++i) {
+            assert(lhs_log.live[i].second == rhs_log.live[i].second);
+            assert(std::memcmp(lhs_log.live[i].first, rhs_log.live[i].first, lhs_log.live[i].second) == 0);
+        }
+    }
+    assert(lhs_log.live.empty() && rhs_log.live.empty());
+}
+
+} // namespace
+
+void test_churn() {
+    allocation_log log;
+    map_t<std::hash<uint64_t>> map{recording_allocator<libcma::swar_flat_map_entry<uint64_t, uint64_t>>(&log)};
+    const churn_stats stats = churn(map, SEED);
+    assert(stats.full_group && stats.n_purges > 0);
+    std::printf("%s passed\n", __FUNCTION__);
+}
+
+void test_churn_colliding() {
+    // new entries of a long probe sequence take back its erased slots before enough pile up for a purge
+    allocation_log few_log;
+    map_t<colliding_hash<FEW_HASHES>> few{
+        recording_allocator<libcma::swar_flat_map_entry<uint64_t, uint64_t>>(&few_log)};
+    assert(churn(few, SEED).full_group);
+
+    allocation_log shared_log;
+    map_t<colliding_hash<SHARED_HASHES>> shared{
+        recording_allocator<libcma::swar_flat_map_entry<uint64_t, uint64_t>>(&shared_log)};
+    const churn_stats stats = churn(shared, SEED);
+    assert(stats.full_group && stats.n_purges > 0);
+    std::printf("%s passed\n", __FUNCTION__);
+}
+
+// A table reserved for every key never allocates again, erased slots are dropped in place
+void test_churn_reserved() {
+    allocation_log log;
+    map_t<std::hash<uint64_t>> map{
+        N_RESERVED, recording_allocator<libcma::swar_flat_map_entry<uint64_t, uint64_t>>(&log)};
+    const size_t n_allocations = log.n_allocations;
+    const size_t capacity = map.capacity();
+    const churn_stats stats = churn(map, SEED);
+    assert(stats.n_purges > 0);
+    assert(log.n_allocations == n_allocations && map.capacity() == capacity);
+    std::printf("%s passed\n", __FUNCTION__);
+}
+
+void test_same_bytes() {
+    check_same_bytes<std::hash<uint64_t>>(SEED);
+    check_same_bytes<colliding_hash<FEW_HASHES>>(SEED + 1);
+    check_same_bytes<colliding_hash<SHARED_HASHES>>(SEED + 2);
+    std::printf("%s passed\n", __FUNCTION__);
+}
+
+int main() {
+    test_churn();
+    test_churn_colliding();
+    test_churn_reserved();
+    test_same_bytes();
+    std::printf("All swar-flat-map tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,229 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libcma/u256.h"
+
+#define MAX_DEC "115792089237316195423570985008687907853269984665640564039457584007913129639935"
+#define MAX_HEX "0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"
+
+static cma_amount_t from_dec(const char *str) {
+    cma_amount_t res;
+    assert(cma_u256_from_dec(&res, str, strlen(str)) == CMA_U256_SUCCESS);
+    return res;
+}
+
+static cma_amount_t from_u64(uint64_t value) {
+    cma_amount_t res;
+    assert(cma_u256_from_u64(&res, value) == CMA_U256_SUCCESS);
+    return res;
+}
+
+static void assert_dec(const cma_amount_t *a, const char *expected) {
+    char out[CMA_U256_DEC_STRING_LENGTH];
+    assert(cma_u256_to_dec(a, out, sizeof(out)) == CMA_U256_SUCCESS);
+    assert(strcmp(out, expected) == 0);
+}
+
+// Deterministic pseudo random values of any width, so the carries and quotient corrections get exercised
+static cma_amount_t next_amount(uint64_t *state) {
+    cma_amount_t res = {};
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    const size_t skip = (*state >> 59) % CMA_ABI_U256_LENGTH;
+    for (size_t i = skip; i < CMA_ABI_U256_LENGTH; i++) {
+        *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+        res.data[i] = (*state >> 60) == 0 ? 0xff : (uint8_t) (*state >> 56);
+    }
+    return res;
+}
+
+void test_add_sub(void) {
+    cma_amount_t res;
+    const cma_amount_t one = from_u64(1);
+    const cma_amount_t max = from_dec(MAX_DEC);
+    assert(cma_u256_add(NULL, &one, &one) == -EINVAL);
+    assert(cma_u256_sub(&res, NULL, &one) == -EINVAL);
+
+    const cma_amount_t low_max = from_u64(UINT64_MAX);
+    assert(cma_u256_add(&res, &low_max, &one) == CMA_U256_SUCCESS);
+    assert_dec(&res, "18446744073709551616");
+    assert(cma_u256_sub(&res, &res, &one) == CMA_U256_SUCCESS);
+    assert(cma_u256_compare(&res, &low_max) == 0);
+
+    // on error the result is left untouched
+    assert(cma_u256_add(&res, &max, &one) == CMA_U256_ERROR_OVERFLOW);
+    assert(cma_u256_compare(&res, &low_max) == 0);
+    assert(cma_u256_sub(&res, &one, &max) == CMA_U256_ERROR_OVERFLOW);
+    assert(cma_u256_sub(&res, &max, &max) == CMA_U256_SUCCESS);
+    assert(cma_u256_is_zero(&res));
+
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_mul_divmod(void) {
+    cma_amount_t res;
+    cma_amount_t rem;
+    const cma_amount_t zero = from_u64(0);
+    const cma_amount_t max = from_dec(MAX_DEC);
+    const cma_amount_t two = from_u64(2);
+
+    const cma_amount_t a = from_dec("170141183460469231731687303715884105729"); // 2^127 + 1
+    assert(cma_u256_mul(&res, &a, &a) == CMA_U256_SUCCESS);
+    assert_dec(&res, "28948022309329048855892746252171976963657778533331079473327770609410050621441");
+    assert(cma_u256_mul(&res, &max, &two) == CMA_U256_ERROR_OVERFLOW);
+    assert(cma_u256_mul(&res, &max, &zero) == CMA_U256_SUCCESS);
+    assert(cma_u256_is_zero(&res));
+
+    assert(cma_u256_divmod(&res, &rem, &max, &zero) == CMA_U256_ERROR_DIVISION_BY_ZERO);
+    assert(cma_u256_divmod(&res, &rem, &max, &a) == CMA_U256_SUCCESS);
+    assert_dec(&res, "680564733841876926926749214863536422908");
+    assert_dec(&rem, "3");
+    assert(cma_u256_divmod(&res, NULL, &two, &max) == CMA_U256_SUCCESS);
+    assert(cma_u256_is_zero(&res));
+    assert(cma_u256_divmod(NULL, &rem, &two, &max) == CMA_U256_SUCCESS);
+    assert(cma_u256_compare(&rem, &two) == 0);
+
+    // a == q * b + r with r < b over operands of every width
+    uint64_t state = 42;
+    for (size_t i = 0; i < 20000; i++) {
+        const cma_amount_t x = next_amount(&state);
+        const cma_amount_t y = next_amount(&state);
+        if (cma_u256_is_zero(&y)) {
+            continue;
+        }
+        cma_amount_t quot;
+        assert(cma_u256_divmod(&quot, &rem, &x, &y) == CMA_U256_SUCCESS);
+        assert(cma_u256_compare(&rem, &y) < 0);
+        assert(cma_u256_mul(&res, &quot, &y) == CMA_U256_SUCCESS);
+        assert(cma_u256_add(&res, &res, &rem) == CMA_U256_SUCCESS);
+        assert(cma_u256_compare(&res, &x) == 0);
+    }
+
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_mul_div(void) {
+    cma_amount_t res;
+    cma_amount_t rem;
+    const cma_amount_t zero = from_u64(0);
+    const cma_amount_t max = from_dec(MAX_DEC);
+
+    // the product overflows 256 bits but the quotient doesn't
+    const cma_amount_t fee_bps = from_u64(30);
+    const cma_amount_t bps = from_u64(10000);
+    assert(cma_u256_mul_div(&res, &rem, &max, &fee_bps, &bps) == CMA_U256_SUCCESS);
+    assert_dec(&res, "347376267711948586270712955026063723559809953996921692118372752023739388919");
+    assert_dec(&rem, "8050");
+    assert(cma_u256_mul_div(&res, NULL, &max, &max, &max) == CMA_U256_SUCCESS);
+    assert(cma_u256_compare(&res, &max) == 0);
+
+    assert(cma_u256_mul_div(&res, &rem, &max, &bps, &fee_bps) == CMA_U256_ERROR_OVERFLOW);
+    assert(cma_u256_mul_div(&res, &rem, &max, &bps, &zero) == CMA_U256_ERROR_DIVISION_BY_ZERO);
+    assert(cma_u256_mul_div(&res, &rem, &zero, &bps, &fee_bps) == CMA_U256_SUCCESS);
+    assert(cma_u256_is_zero(&res));
+    assert(cma_u256_is_zero(&rem));
+
+    // matches mul followed by divmod whenever the product fits
+    uint64_t state = 7;
+    for (size_t i = 0; i < 20000; i++) {
+        const cma_amount_t x = next_amount(&state);
+        const cma_amount_t y = next_amount(&state);
+        const cma_amount_t z = next_amount(&state);
+        cma_amount_t prod;
+        if (cma_u256_is_zero(&z) || cma_u256_mul(&prod, &x, &y) != CMA_U256_SUCCESS) {
+            continue;
+        }
+        cma_amount_t quot;
+        cma_amount_t prod_rem;
+        assert(cma_u256_divmod(&quot, &prod_rem, &prod, &z) == CMA_U256_SUCCESS);
+        assert(cma_u256_mul_div(&res, &rem, &x, &y, &z) == CMA_U256_SUCCESS);
+        assert(cma_u256_compare(&res, &quot) == 0);
+        assert(cma_u256_compare(&rem, &prod_rem) == 0);
+    }
+
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_shift_compare(void) {
+    cma_amount_t res;
+    const cma_amount_t one = from_u64(1);
+    const cma_amount_t max = from_dec(MAX_DEC);
+
+    assert(cma_u256_shl(&res, &one, 255) == CMA_U256_SUCCESS);
+    assert_dec(&res, "57896044618658097711785492504343953926634992332820282019728792003956564819968");
+    assert(cma_u256_shr(&res, &res, 255) == CMA_U256_SUCCESS);
+    assert(cma_u256_compare(&res, &one) == 0);
+    assert(cma_u256_shl(&res, &one, 256) == CMA_U256_SUCCESS);
+    assert(cma_u256_is_zero(&res));
+    assert(cma_u256_shr(&res, &max, 193) == CMA_U256_SUCCESS);
+    assert_dec(&res, "9223372036854775807");
+    assert(cma_u256_shl(&res, &max, 0) == CMA_U256_SUCCESS);
+    assert(cma_u256_compare(&res, &max) == 0);
+
+    // the high limbs decide before the low ones
+    const cma_amount_t low_max = from_u64(UINT64_MAX);
+    assert(cma_u256_shl(&res, &one, 64) == CMA_U256_SUCCESS);
+    assert(cma_u256_compare(&low_max, &res) < 0);
+    assert(cma_u256_compare(&res, &low_max) > 0);
+    assert(!cma_u256_is_zero(&res));
+
+    printf("%s passed\n", __FUNCTION__);
+}
+
+void test_conversions(void) {
+    cma_amount_t res = {};
+    uint64_t value = 0;
+    char out[CMA_U256_HEX_STRING_LENGTH];
+
+    assert(cma_u256_to_u64(&res, NULL) == -EINVAL);
+    res = from_u64(UINT64_MAX);
+    assert(cma_u256_to_u64(&res, &value) == CMA_U256_SUCCESS);
+    assert(value == UINT64_MAX);
+    const cma_amount_t max = from_dec(MAX_DEC);
+    assert(cma_u256_to_u64(&max, &value) == CMA_U256_ERROR_OVERFLOW);
+
+    assert(cma_u256_to_hex(&max, out, sizeof(out)) == CMA_U256_SUCCESS);
+    assert(strcmp(out, MAX_HEX) == 0);
+    assert(cma_u256_to_hex(&max, out, sizeof(out) - 1) == CMA_U256_ERROR_BUFFER_TOO_SMALL);
+    assert(cma_u256_from_hex(&res, MAX_HEX, strlen(MAX_HEX)) == CMA_U256_SUCCESS);
+    assert(cma_u256_compare(&res, &max) == 0);
+    assert_dec(&max, MAX_DEC);
+
+    assert(cma_u256_from_hex(&res, "0x0001000000000000000a", 22) == CMA_U256_SUCCESS);
+    assert_dec(&res, "18446744073709551626");
+    assert(cma_u256_to_hex(&res, out, sizeof(out)) == CMA_U256_SUCCESS);
+    assert(strcmp(out, "0x1000000000000000a") == 0);
+    assert(cma_u256_from_dec(&res, "0000000000000000000000000010000000000000000000", 46) == CMA_U256_SUCCESS);
+    assert_dec(&res, "10000000000000000000");
+
+    res = from_u64(0);
+    assert_dec(&res, "0");
+    assert(cma_u256_to_hex(&res, out, sizeof(out)) == CMA_U256_SUCCESS);
+    assert(strcmp(out, "0x0") == 0);
+    assert(cma_u256_to_dec(&res, out, 1) == CMA_U256_ERROR_BUFFER_TOO_SMALL);
+
+    // one past the maximum in both bases
+    assert(cma_u256_from_dec(&res,
+               "115792089237316195423570985008687907853269984665640564039457584007913129639936", 78) ==
+        CMA_U256_ERROR_OVERFLOW);
+    assert(cma_u256_from_hex(&res, "0x10000000000000000000000000000000000000000000000000000000000000000", 67) ==
+        CMA_U256_ERROR_OVERFLOW);
+    assert(cma_u256_from_dec(&res, "", 0) == CMA_U256_ERROR_INVALID_STRING);
+    assert(cma_u256_from_dec(&res, "12a", 3) == CMA_U256_ERROR_INVALID_STRING);
+    assert(cma_u256_from_hex(&res, "0x", 2) == CMA_U256_ERROR_INVALID_STRING);
+    assert(cma_u256_from_hex(&res, "0xg", 3) == CMA_U256_ERROR_INVALID_STRING);
+
+    printf("%s passed\n", __FUNCTION__);
+}
+
+int main(void) {
+    test_add_sub();
+    test_mul_divmod();
+    test_mul_div();
+    test_shift_compare();
+    test_conversions();
+    printf("All u256 tests passed!\n");
+    return 0;
+}